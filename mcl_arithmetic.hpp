@@ -9,87 +9,2614 @@
 #include <numeric>
 #include <vector>
 #include <cmath>
+#include <limits>
+#include <iterator>
+#include <type_traits>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <utility>
+#include <tuple>
+#include <stdexcept>
+
+#include "mcl_basic.hpp"
+#include "mcl_tabular.hpp"
 
 namespace mc
 {
-    // Mathematical container functions
-    // ================================
+    // Streaming statistics
+    // ====================
     
-    // Average
-    template<class iterator_t, class number_t = typename std::iterator_traits<iterator_t>::value_type>
-    inline number_t average(const iterator_t begin, const iterator_t end)
+    // Single pass accumulator for count, mean, variance, min, max, skewness and kurtosis 
+    // (Welford's update, extended to higher moments by Pebay). Partial results, e.g. of 
+    // different threads or files, can be combined with merge() (Chan et al.).
+    template<typename T = double>
+    class running_stats
     {
-        static_assert( std::is_arithmetic<number_t>::value, "Container must store arithmetic type");
+        static_assert( std::is_floating_point<T>::value, "running_stats requires a floating point type");
+        
+    public:
+        using value_type = T;
+        
+        void push(T x)
+        {
+            const T n1 = static_cast<T>(m_count);
+            ++m_count;
+            const T n = static_cast<T>(m_count);
+            
+            const T delta = x - m_mean;
+            const T delta_n = delta / n;
+            const T delta_n2 = delta_n * delta_n;
+            const T term1 = delta * delta_n * n1;
+            
+            m_mean += delta_n;
+            m_m4 += term1 * delta_n2 * (n*n - 3*n + 3) + 6 * delta_n2 * m_m2 - 4 * delta_n * m_m3;
+            m_m3 += term1 * delta_n * (n - 2) - 3 * delta_n * m_m2;
+            m_m2 += term1;
+            
+            if( m_count == 1 )
+            {
+                m_min = x;
+                m_max = x;
+            }
+            else
+            {
+                m_min = std::min(m_min, x);
+                m_max = std::max(m_max, x);
+            }
+        }
+        
+        template<class iterator_t>
+        void push(iterator_t begin, const iterator_t end)
+        {
+            for(; begin != end; ++begin)
+                push(static_cast<T>(*begin));
+        }
         
-        auto sum = std::accumulate(begin, end, static_cast<number_t>(0));
-        return sum / (end - begin);
+        running_stats &merge(const running_stats &other)
+        {
+            if( other.m_count == 0 ) return *this;
+            if( m_count == 0 ) return *this = other;
+            
+            const T na = static_cast<T>(m_count);
+            const T nb = static_cast<T>(other.m_count);
+            const T n = na + nb;
+            
+            const T delta = other.m_mean - m_mean;
+            const T delta2 = delta * delta;
+            const T delta3 = delta2 * delta;
+            const T delta4 = delta2 * delta2;
+            
+            const T m2 = m_m2 + other.m_m2 + delta2 * na * nb / n;
+            
+            const T m3 = m_m3 + other.m_m3 + delta3 * na * nb * (na - nb) / (n*n) 
+                       + 3 * delta * (na * other.m_m2 - nb * m_m2) / n;
+            
+            const T m4 = m_m4 + other.m_m4 + delta4 * na * nb * (na*na - na*nb + nb*nb) / (n*n*n)
+                       + 6 * delta2 * (na*na * other.m_m2 + nb*nb * m_m2) / (n*n) 
+                       + 4 * delta * (na * other.m_m3 - nb * m_m3) / n;
+            
+            m_mean += delta * nb / n;
+            m_m2 = m2;
+            m_m3 = m3;
+            m_m4 = m4;
+            m_count += other.m_count;
+            m_min = std::min(m_min, other.m_min);
+            m_max = std::max(m_max, other.m_max);
+            
+            return *this;
+        }
+        
+        running_stats &operator+=(const running_stats &other) { return merge(other); }
+        
+        // accumulator for the given first two moments only (higher moments are not tracked), min 
+        // and max are +inf and -inf so that merge() keeps the ones of the other accumulator
+        static running_stats from_moments(std::size_t count, T mean, T m2)
+        {
+            running_stats stats;
+            stats.m_count = count;
+            stats.m_mean = mean;
+            stats.m_m2 = m2;
+            stats.m_min = std::numeric_limits<T>::infinity();
+            stats.m_max = -std::numeric_limits<T>::infinity();
+            return stats;
+        }
+        
+        std::size_t count() const { return m_count; }
+        T mean() const { return m_count > 0 ? m_mean : std::numeric_limits<T>::quiet_NaN(); }
+        T sum() const { return m_mean * m_count; }
+        T min() const { return m_count > 0 ? m_min : std::numeric_limits<T>::quiet_NaN(); }
+        T max() const { return m_count > 0 ? m_max : std::numeric_limits<T>::quiet_NaN(); }
+        
+        // population variance (divides by n), like mc::standard_deviation
+        T variance() const { return m_count > 0 ? m_m2 / m_count : std::numeric_limits<T>::quiet_NaN(); }
+        T sample_variance() const { return m_count > 1 ? m_m2 / (m_count - 1) : std::numeric_limits<T>::quiet_NaN(); }
+        T stddev() const { return std::sqrt(variance()); }
+        T sample_stddev() const { return std::sqrt(sample_variance()); }
+        
+        T skewness() const { return std::sqrt(static_cast<T>(m_count)) * m_m3 / std::pow(m_m2, static_cast<T>(1.5)); }
+        
+        // excess kurtosis (0 for a normal distribution)
+        T kurtosis() const { return static_cast<T>(m_count) * m_m4 / (m_m2 * m_m2) - 3; }
+        
+    private:
+        std::size_t m_count = 0;
+        T m_mean = 0;
+        T m_m2 = 0;
+        T m_m3 = 0;
+        T m_m4 = 0;
+        T m_min = 0;
+        T m_max = 0;
+    };
+    
+    template<class iterator_t, class stats_t = running_stats<>>
+    inline stats_t compute_stats(iterator_t begin, const iterator_t end)
+    {
+        stats_t stats;
+        stats.push(begin, end);
+        return stats;
     }
     
-    template<class container_t, class number_t = typename container_t::value_type>
-    inline number_t average(const container_t &data)
+    template<class container_t, class stats_t = running_stats<>>
+    inline stats_t compute_stats(const container_t &data)
     {
-        return average(data.begin(), data.end());
+        return compute_stats<typename container_t::const_iterator, stats_t>(data.begin(), data.end());
     }
     
-    // Standard deviation
-    template<class iterator_t, class number_t = typename std::iterator_traits<iterator_t>::value_type>
-    inline number_t standard_deviation(const iterator_t begin, const iterator_t end)
+    // Mean and variance of the last 'window' values in O(1) per value: the value leaving the 
+    // window is removed with the inverse Welford update. The sums are recomputed exactly every 
+    // 64 windows to bound the rounding error accumulated by the removals, and when the last 
+    // NaN or inf leaves the window (the inverse update cannot remove it).
+    template<typename T = double>
+    class moving_stats
     {
-        static_assert( std::is_arithmetic<number_t>::value, "Container must store arithmetic type");
+        static_assert( std::is_floating_point<T>::value, "moving_stats requires a floating point type");
         
-        auto data_average = average(begin, end);
-        number_t sum = 0;
+    public:
+        using value_type = T;
+        
+        explicit moving_stats(std::size_t window) : m_values(window)
+        {
+            if( window == 0 )
+                throw std::runtime_error("window size must be positive");
+        }
+        
+        void push(T x)
+        {
+            const std::size_t window = m_values.size();
+            bool non_finite_left = false;
+            
+            if( !std::isfinite(x) ) ++m_non_finite;
+            
+            if( m_count < window )
+            {
+                ++m_count;
+                const T delta = x - m_mean;
+                m_mean += delta / static_cast<T>(m_count);
+                m_m2 += delta * (x - m_mean);
+            }
+            else
+            {
+                const T y = m_values[m_next];
+                const T old_mean = m_mean;
+                
+                if( !std::isfinite(y) ) 
+                {
+                    --m_non_finite;
+                    non_finite_left = true;
+                }
+                
+                m_mean += (x - y) / static_cast<T>(window);
+                m_m2 += (x - y) * (x - m_mean + y - old_mean);
+            }
+            
+            m_values[m_next] = x;
+            m_next = m_next + 1 == window ? 0 : m_next + 1;
+            
+            if( ++m_pushes == 64 * window || (non_finite_left && m_non_finite == 0) )
+                recompute();
+        }
+        
+        template<class iterator_t>
+        void push(iterator_t begin, const iterator_t end)
+        {
+            for(; begin != end; ++begin)
+                push(static_cast<T>(*begin));
+        }
+        
+        void reset()
+        {
+            m_count = 0;
+            m_next = 0;
+            m_pushes = 0;
+            m_non_finite = 0;
+            m_mean = 0;
+            m_m2 = 0;
+        }
+        
+        std::size_t window() const { return m_values.size(); }
+        std::size_t count() const { return m_count; }
+        bool full() const { return m_count == m_values.size(); }
+        
+        T mean() const { return m_count > 0 ? m_mean : std::numeric_limits<T>::quiet_NaN(); }
+        T sum() const { return m_mean * m_count; }
+        
+        // population variance (divides by n), like running_stats
+        T variance() const { return m_count > 0 ? std::max<T>(m_m2, 0) / m_count : std::numeric_limits<T>::quiet_NaN(); }
+        T sample_variance() const { return m_count > 1 ? std::max<T>(m_m2, 0) / (m_count - 1) : std::numeric_limits<T>::quiet_NaN(); }
+        T stddev() const { return std::sqrt(variance()); }
+        T sample_stddev() const { return std::sqrt(sample_variance()); }
+        
+    private:
+        // two pass over the current window
+        void recompute()
+        {
+            m_pushes = 0;
+            
+            T mean = 0;
+            for(std::size_t i = 0; i < m_count; ++i) mean += m_values[i];
+            mean /= static_cast<T>(m_count);
+            
+            T m2 = 0;
+            for(std::size_t i = 0; i < m_count; ++i) m2 += (m_values[i] - mean) * (m_values[i] - mean);
+            
+            m_mean = mean;
+            m_m2 = m2;
+        }
         
-        for(auto it = begin; it != end; ++it) 
-            sum += std::pow(*it - data_average, 2);
+        std::vector<T> m_values;    // ring buffer, m_next is the oldest value once the window is full
+        std::size_t m_count = 0;
+        std::size_t m_next = 0;
+        std::size_t m_pushes = 0;
+        std::size_t m_non_finite = 0;    // NaN and inf in the window
+        T m_mean = 0;
+        T m_m2 = 0;
+    };
+    
+    // Writes the mean (or standard deviation) of every complete window, i.e. n - window + 1 values
+    template<class iterator_t, class out_iterator_t>
+    inline out_iterator_t moving_average(iterator_t begin, const iterator_t end, std::size_t window, out_iterator_t out)
+    {
+        moving_stats<> stats(window);
         
-        return std::sqrt( sum / (end - begin));
+        for(; begin != end; ++begin)
+        {
+            stats.push(static_cast<double>(*begin));
+            if( stats.full() ) *out++ = stats.mean();
+        }
+        
+        return out;
     }
     
-    template<class container_t, class number_t = typename container_t::value_type>
-    inline number_t standard_deviation(const container_t &data)
+    template<class iterator_t, class out_iterator_t>
+    inline out_iterator_t moving_stddev(iterator_t begin, const iterator_t end, std::size_t window, out_iterator_t out)
     {
-        return standard_deviation(data.begin(), data.end());
+        moving_stats<> stats(window);
+        
+        for(; begin != end; ++begin)
+        {
+            stats.push(static_cast<double>(*begin));
+            if( stats.full() ) *out++ = stats.stddev();
+        }
+        
+        return out;
     }
     
-    // Vector operations
+    template<class container_t>
+    inline std::vector<double> moving_average(const container_t &data, std::size_t window)
+    {
+        std::vector<double> result;
+        result.reserve(data.size() >= window ? data.size() - window + 1 : 0);
+        moving_average(data.begin(), data.end(), window, std::back_inserter(result));
+        return result;
+    }
     
-    template<class iterator_t, 
-             class container_t = std::vector<typename std::iterator_traits<iterator_t>::value_type>, 
-             class number_t = typename std::iterator_traits<iterator_t>::value_type>
-    inline container_t square_container(const iterator_t begin, const iterator_t end)
+    template<class container_t>
+    inline std::vector<double> moving_stddev(const container_t &data, std::size_t window)
     {
-        static_assert( std::is_arithmetic<number_t>::value, "Container must store arithmetic type");
-        container_t squared_container(end - begin);
+        std::vector<double> result;
+        result.reserve(data.size() >= window ? data.size() - window + 1 : 0);
+        moving_stddev(data.begin(), data.end(), window, std::back_inserter(result));
+        return result;
+    }
+    
+    // floating point type used for accumulation
+    template<typename number_t>
+    using _float_t = typename std::conditional<std::is_floating_point<number_t>::value, number_t, double>::type;
+    
+    // Vectorized kernels
+    // ==================
+    
+    // Kernels for contiguous float, double, 32 and 64 bit integer data. On x86 with GCC or 
+    // Clang each kernel is compiled for SSE2, AVX2 and AVX-512 and selected at runtime by 
+    // CPUID. They use several independent accumulators, so floating point reductions are 
+    // vectorized without -ffast-math (the summation order differs from a sequential loop). 
+    // Define MCL_NO_SIMD to always use the scalar fallback.
+    
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__)) && !defined(MCL_NO_SIMD)
+    #define MCL_HAS_SIMD_DISPATCH
+#endif
+    
+    enum class simd_level { scalar, sse2, avx2, avx512 };
+    
+    inline std::atomic<simd_level> &_simd_limit()
+    {
+        static std::atomic<simd_level> limit{simd_level::avx512};
+        return limit;
+    }
+    
+    // Restricts the used instruction set, e.g. for testing or benchmarking
+    inline void set_simd_limit(simd_level level) { _simd_limit() = level; }
+    
+    // Instruction set used by the kernels
+    inline simd_level simd_support()
+    {
+#if defined(MCL_HAS_SIMD_DISPATCH)
+        static const simd_level detected = []()
+        {
+            __builtin_cpu_init();
+            
+            if( __builtin_cpu_supports("avx512f") ) return simd_level::avx512;
+            if( __builtin_cpu_supports("avx2") ) return simd_level::avx2;
+            if( __builtin_cpu_supports("sse2") ) return simd_level::sse2;
+            return simd_level::scalar;
+        }();
+        
+        return std::min(detected, _simd_limit().load(std::memory_order_relaxed));
+#else
+        return simd_level::scalar;
+#endif
+    }
+    
+    template<typename T>
+    struct _is_simd_type : std::integral_constant<bool, 
+        std::is_same<T, float>::value || std::is_same<T, double>::value ||
+        std::is_same<T, std::int32_t>::value || std::is_same<T, std::int64_t>::value ||
+        std::is_same<T, std::uint32_t>::value || std::is_same<T, std::uint64_t>::value> { };
+    
+    // pointers and iterators of std::vector refer to contiguous memory
+    template<class iterator_t>
+    struct _is_contiguous_iterator : std::integral_constant<bool,
+        std::is_pointer<iterator_t>::value ||
+        std::is_same<iterator_t, typename std::vector<typename std::iterator_traits<iterator_t>::value_type>::iterator>::value ||
+        std::is_same<iterator_t, typename std::vector<typename std::iterator_traits<iterator_t>::value_type>::const_iterator>::value> { };
+    
+    template<class iterator_t>
+    struct _use_simd : std::integral_constant<bool,
+        _is_contiguous_iterator<iterator_t>::value && 
+        _is_simd_type<typename std::remove_cv<typename std::iterator_traits<iterator_t>::value_type>::type>::value> { };
+    
+    // Generic kernels, 'bytes' is the vector width. They are only instantiated inside the 
+    // target specific functions below, where they are always inlined.
+#if defined(MCL_HAS_SIMD_DISPATCH)
+    #define MCL_SIMD_INLINE __attribute__((always_inline)) inline
+#else
+    #define MCL_SIMD_INLINE inline
+#endif
+    
+    template<typename T, std::size_t bytes>
+    MCL_SIMD_INLINE T _kernel_sum(const T *data, std::size_t n)
+    {
+#if defined(MCL_HAS_SIMD_DISPATCH)
+        typedef T vec_t __attribute__((vector_size(bytes)));
+        constexpr std::size_t lanes = bytes / sizeof(T);
         
-        std::transform(begin, end, squared_container.begin(), [](const number_t &el){ return el*el; });
+        vec_t acc0 = {}, acc1 = {}, acc2 = {}, acc3 = {};
+        std::size_t i = 0;
         
-        return squared_container;
+        for(; i + 4*lanes <= n; i += 4*lanes)
+        {
+            vec_t v0, v1, v2, v3;
+            __builtin_memcpy(&v0, data + i, bytes);
+            __builtin_memcpy(&v1, data + i + lanes, bytes);
+            __builtin_memcpy(&v2, data + i + 2*lanes, bytes);
+            __builtin_memcpy(&v3, data + i + 3*lanes, bytes);
+            acc0 += v0; acc1 += v1; acc2 += v2; acc3 += v3;
+        }
+        
+        acc0 = (acc0 + acc1) + (acc2 + acc3);
+        
+        T sum = 0;
+        for(std::size_t l=0; l<lanes; ++l) sum += acc0[l];
+#else
+        T sum = 0;
+        std::size_t i = 0;
+#endif
+        for(; i<n; ++i) sum += data[i];
+        
+        return sum;
     }
     
-    template<class container_t , class number_t = typename container_t::value_type>
-    inline container_t square_container(const container_t &data)
+    // sum of (x - mean)^2
+    template<typename T, std::size_t bytes>
+    MCL_SIMD_INLINE T _kernel_squared_deviations(const T *data, std::size_t n, T mean)
     {
-        return square_container<typename container_t::const_iterator, container_t>(data.begin(), data.end());
+#if defined(MCL_HAS_SIMD_DISPATCH)
+        typedef T vec_t __attribute__((vector_size(bytes)));
+        constexpr std::size_t lanes = bytes / sizeof(T);
+        
+        vec_t acc0 = {}, acc1 = {};
+        vec_t m = vec_t{} + mean;
+        std::size_t i = 0;
+        
+        for(; i + 2*lanes <= n; i += 2*lanes)
+        {
+            vec_t v0, v1;
+            __builtin_memcpy(&v0, data + i, bytes);
+            __builtin_memcpy(&v1, data + i + lanes, bytes);
+            v0 -= m; v1 -= m;
+            acc0 += v0 * v0; acc1 += v1 * v1;
+        }
+        
+        acc0 += acc1;
+        
+        T sum = 0;
+        for(std::size_t l=0; l<lanes; ++l) sum += acc0[l];
+#else
+        T sum = 0;
+        std::size_t i = 0;
+#endif
+        for(; i<n; ++i) sum += (data[i] - mean) * (data[i] - mean);
+        
+        return sum;
     }
     
-    template<class iterator_t, 
-             class container_t = std::vector<typename std::iterator_traits<iterator_t>::value_type>, 
-             class number_t = typename std::iterator_traits<iterator_t>::value_type>
-    inline container_t abs_container(const iterator_t begin, const iterator_t end)
+    template<typename T, std::size_t bytes, bool absolute>
+    MCL_SIMD_INLINE void _kernel_transform(const T *in, T *out, std::size_t n)
     {
-        static_assert( std::is_arithmetic<number_t>::value, "Container must store arithmetic type");
-        container_t retcont(end - begin);
+        std::size_t i = 0;
+#if defined(MCL_HAS_SIMD_DISPATCH)
+        typedef T vec_t __attribute__((vector_size(bytes)));
+        constexpr std::size_t lanes = bytes / sizeof(T);
+        
+        for(; i + lanes <= n; i += lanes)
+        {
+            vec_t v;
+            __builtin_memcpy(&v, in + i, bytes);
+            
+            if( absolute ) v = v < 0 ? -v : v;
+            else           v = v * v;
+            
+            __builtin_memcpy(out + i, &v, bytes);
+        }
+#endif
+        for(; i<n; ++i) 
+            out[i] = absolute ? (in[i] < 0 ? -in[i] : in[i]) : in[i] * in[i];
+    }
+    
+#if defined(MCL_HAS_SIMD_DISPATCH)
+    template<typename T> __attribute__((target("avx512f"))) T _sum_avx512(const T *d, std::size_t n) { return _kernel_sum<T, 64>(d, n); }
+    template<typename T> __attribute__((target("avx2")))    T _sum_avx2(const T *d, std::size_t n)   { return _kernel_sum<T, 32>(d, n); }
+    template<typename T> __attribute__((target("sse2")))    T _sum_sse2(const T *d, std::size_t n)   { return _kernel_sum<T, 16>(d, n); }
+    
+    template<typename T> __attribute__((target("avx512f"))) T _sqdev_avx512(const T *d, std::size_t n, T m) { return _kernel_squared_deviations<T, 64>(d, n, m); }
+    template<typename T> __attribute__((target("avx2")))    T _sqdev_avx2(const T *d, std::size_t n, T m)   { return _kernel_squared_deviations<T, 32>(d, n, m); }
+    template<typename T> __attribute__((target("sse2")))    T _sqdev_sse2(const T *d, std::size_t n, T m)   { return _kernel_squared_deviations<T, 16>(d, n, m); }
+    
+    template<typename T, bool a> __attribute__((target("avx512f"))) void _transform_avx512(const T *i, T *o, std::size_t n) { _kernel_transform<T, 64, a>(i, o, n); }
+    template<typename T, bool a> __attribute__((target("avx2")))    void _transform_avx2(const T *i, T *o, std::size_t n)   { _kernel_transform<T, 32, a>(i, o, n); }
+    template<typename T, bool a> __attribute__((target("sse2")))    void _transform_sse2(const T *i, T *o, std::size_t n)   { _kernel_transform<T, 16, a>(i, o, n); }
+#endif
+    
+    template<typename T>
+    inline T simd_sum(const T *data, std::size_t n)
+    {
+#if defined(MCL_HAS_SIMD_DISPATCH)
+        switch( simd_support() )
+        {
+            case simd_level::avx512: return _sum_avx512(data, n);
+            case simd_level::avx2:   return _sum_avx2(data, n);
+            case simd_level::sse2:   return _sum_sse2(data, n);
+            default: break;
+        }
+#endif
+        T sum = 0;
+        for(std::size_t i=0; i<n; ++i) sum += data[i];
+        return sum;
+    }
+    
+    template<typename T>
+    inline T simd_squared_deviations(const T *data, std::size_t n, T mean)
+    {
+#if defined(MCL_HAS_SIMD_DISPATCH)
+        switch( simd_support() )
+        {
+            case simd_level::avx512: return _sqdev_avx512(data, n, mean);
+            case simd_level::avx2:   return _sqdev_avx2(data, n, mean);
+            case simd_level::sse2:   return _sqdev_sse2(data, n, mean);
+            default: break;
+        }
+#endif
+        T sum = 0;
+        for(std::size_t i=0; i<n; ++i) sum += (data[i] - mean) * (data[i] - mean);
+        return sum;
+    }
+    
+    // out[i] = in[i]^2 (absolute == false) or |in[i]| (absolute == true), in and out may be equal
+    template<bool absolute, typename T>
+    inline void simd_transform(const T *in, T *out, std::size_t n)
+    {
+#if defined(MCL_HAS_SIMD_DISPATCH)
+        switch( simd_support() )
+        {
+            case simd_level::avx512: _transform_avx512<T, absolute>(in, out, n); return;
+            case simd_level::avx2:   _transform_avx2<T, absolute>(in, out, n); return;
+            case simd_level::sse2:   _transform_sse2<T, absolute>(in, out, n); return;
+            default: break;
+        }
+#endif
+        for(std::size_t i=0; i<n; ++i) 
+            out[i] = absolute ? (in[i] < 0 ? -in[i] : in[i]) : in[i] * in[i];
+    }
+    
+    // Blocked single sweep for count, mean and M2: every block is summed and then its squared 
+    // deviations are computed while it is still in the L1 cache, the blocks are merged (Chan et al.)
+    template<typename T>
+    inline running_stats<T> _simd_variance_stats(const T *data, std::size_t n)
+    {
+        constexpr std::size_t block = 2048;
+        running_stats<T> stats;
         
-        std::transform(begin, end, retcont.begin(), [](const number_t &el){ return std::abs(el); });
+        for(std::size_t i=0; i<n; i += block)
+        {
+            auto size = std::min(block, n - i);
+            auto mean = simd_sum(data + i, size) / static_cast<T>(size);
+            auto m2 = simd_squared_deviations(data + i, size, mean);
+            
+            stats.merge(running_stats<T>::from_moments(size, mean, m2));
+        }
         
-        return retcont;
+        return stats;
     }
-
-    template<class container_t , class number_t = typename container_t::value_type>
-    inline container_t abs_container(const container_t &data)
+    
+    // Lazy expressions
+    // ================
+    
+    // mc::abs(x), mc::square(x), mc::lazy(x) and the operators +, -, *, / build expressions which 
+    // are evaluated element by element only when they are consumed. For example 
+    // mc::average(mc::square(mc::abs(x) - 1.0)) runs one loop without any temporary container.
+    // Operands are containers with random access (lvalues are referenced, rvalues are moved into 
+    // the expression), other expressions and scalars. Use mc::lazy(x) to start an expression from 
+    // a plain container: mc::lazy(x) * 2.0 + y.
+    
+    struct _expression_base { };
+    
+    template<class expression_t>
+    class expression_iterator
     {
-        return abs_container<typename container_t::const_iterator, container_t>(data.begin(), data.end());
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = typename expression_t::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type *;
+        using reference = value_type;
+        
+        expression_iterator() = default;
+        expression_iterator(const expression_t *expression, std::size_t index) : m_expression(expression), m_index(index) { }
+        
+        value_type operator*() const { return (*m_expression)[m_index]; }
+        value_type operator[](difference_type n) const { return (*m_expression)[m_index + n]; }
+        
+        expression_iterator &operator++() { ++m_index; return *this; }
+        expression_iterator &operator--() { --m_index; return *this; }
+        expression_iterator operator++(int) { auto it = *this; ++m_index; return it; }
+        expression_iterator operator--(int) { auto it = *this; --m_index; return it; }
+        
+        expression_iterator &operator+=(difference_type n) { m_index += n; return *this; }
+        expression_iterator &operator-=(difference_type n) { m_index -= n; return *this; }
+        expression_iterator operator+(difference_type n) const { return expression_iterator(m_expression, m_index + n); }
+        expression_iterator operator-(difference_type n) const { return expression_iterator(m_expression, m_index - n); }
+        difference_type operator-(const expression_iterator &other) const { return static_cast<difference_type>(m_index - other.m_index); }
+        
+        bool operator==(const expression_iterator &other) const { return m_index == other.m_index; }
+        bool operator!=(const expression_iterator &other) const { return m_index != other.m_index; }
+        bool operator<(const expression_iterator &other) const { return m_index < other.m_index; }
+        bool operator>(const expression_iterator &other) const { return m_index > other.m_index; }
+        bool operator<=(const expression_iterator &other) const { return m_index <= other.m_index; }
+        bool operator>=(const expression_iterator &other) const { return m_index >= other.m_index; }
+        
+        const expression_t &expression() const { return *m_expression; }
+        std::size_t index() const { return m_index; }
+        
+    private:
+        const expression_t *m_expression = nullptr;
+        std::size_t m_index = 0;
+    };
+    
+    // CRTP base, derived classes provide value_type, operator[](i) and size()
+    template<class derived_t>
+    class expression : public _expression_base
+    {
+    public:
+        const derived_t &derived() const { return static_cast<const derived_t &>(*this); }
+        
+        expression_iterator<derived_t> begin() const { return expression_iterator<derived_t>(&derived(), 0); }
+        expression_iterator<derived_t> end() const { return expression_iterator<derived_t>(&derived(), derived().size()); }
+    };
+    
+    template<class T>
+    struct _is_expression : std::is_base_of<_expression_base, typename std::decay<T>::type> { };
+    
+    // stored_t is 'const container_t &' for lvalues and 'container_t' for rvalues
+    template<class stored_t>
+    class container_expression : public expression<container_expression<stored_t>>
+    {
+    public:
+        using value_type = typename std::decay<stored_t>::type::value_type;
+        
+        explicit container_expression(stored_t container) : m_container(std::forward<stored_t>(container)) { }
+        
+        value_type operator[](std::size_t i) const { return m_container[i]; }
+        std::size_t size() const { return m_container.size(); }
+        
+    private:
+        stored_t m_container;
+    };
+    
+    // broadcasts a scalar to the size of the other operand
+    template<class T>
+    class scalar_expression : public expression<scalar_expression<T>>
+    {
+    public:
+        using value_type = T;
+        
+        explicit scalar_expression(T value) : m_value(value) { }
+        
+        value_type operator[](std::size_t) const { return m_value; }
+        std::size_t size() const { return std::numeric_limits<std::size_t>::max(); }
+        
+    private:
+        T m_value;
+    };
+    
+    template<class function_t, class argument_t>
+    class unary_expression : public expression<unary_expression<function_t, argument_t>>
+    {
+    public:
+        using value_type = typename std::decay<decltype(std::declval<function_t>()(std::declval<typename argument_t::value_type>()))>::type;
+        
+        unary_expression(function_t function, argument_t argument) : m_function(function), m_argument(std::move(argument)) { }
+        
+        value_type operator[](std::size_t i) const { return m_function(m_argument[i]); }
+        std::size_t size() const { return m_argument.size(); }
+        
+    private:
+        function_t m_function;
+        argument_t m_argument;
+    };
+    
+    template<class function_t, class lhs_t, class rhs_t>
+    class binary_expression : public expression<binary_expression<function_t, lhs_t, rhs_t>>
+    {
+    public:
+        using value_type = typename std::decay<decltype(std::declval<function_t>()(std::declval<typename lhs_t::value_type>(), 
+                                                                                   std::declval<typename rhs_t::value_type>()))>::type;
+        
+        binary_expression(function_t function, lhs_t lhs, rhs_t rhs) : m_function(function), m_lhs(std::move(lhs)), m_rhs(std::move(rhs))
+        {
+            const auto broadcast = std::numeric_limits<std::size_t>::max();
+            
+            if( m_lhs.size() != broadcast && m_rhs.size() != broadcast && m_lhs.size() != m_rhs.size() )
+                throw std::runtime_error("vector sizes do not match!");
+        }
+        
+        value_type operator[](std::size_t i) const { return m_function(m_lhs[i], m_rhs[i]); }
+        std::size_t size() const { return std::min(m_lhs.size(), m_rhs.size()); }
+        
+    private:
+        function_t m_function;
+        lhs_t m_lhs;
+        rhs_t m_rhs;
+    };
+    
+    struct _abs_function { template<class T> T operator()(T x) const { return x < 0 ? static_cast<T>(-x) : x; } };
+    struct _square_function { template<class T> T operator()(T x) const { return static_cast<T>(x * x); } };
+    
+    struct _plus_function { template<class T, class U> auto operator()(T a, U b) const -> decltype(a + b) { return a + b; } };
+    struct _minus_function { template<class T, class U> auto operator()(T a, U b) const -> decltype(a - b) { return a - b; } };
+    struct _multiplies_function { template<class T, class U> auto operator()(T a, U b) const -> decltype(a * b) { return a * b; } };
+    struct _divides_function { template<class T, class U> auto operator()(T a, U b) const -> decltype(a / b) { return a / b; } };
+    
+    template<class T>
+    inline typename std::enable_if<_is_expression<T>::value, typename std::decay<T>::type>::type _as_expression(T &&e)
+    {
+        return std::forward<T>(e);
+    }
+    
+    template<class T>
+    inline typename std::enable_if<std::is_arithmetic<typename std::decay<T>::type>::value, scalar_expression<typename std::decay<T>::type>>::type 
+    _as_expression(T &&value)
+    {
+        return scalar_expression<typename std::decay<T>::type>(value);
+    }
+    
+    template<class T, 
+             class stored_t = typename std::conditional<std::is_lvalue_reference<T>::value, 
+                                                        const typename std::decay<T>::type &, typename std::decay<T>::type>::type>
+    inline typename std::enable_if<!_is_expression<T>::value && !std::is_arithmetic<typename std::decay<T>::type>::value, container_expression<stored_t>>::type 
+    _as_expression(T &&container)
+    {
+        return container_expression<stored_t>(std::forward<T>(container));
+    }
+    
+    template<class T>
+    using _expression_t = decltype(_as_expression(std::declval<T>()));
+    
+    template<class T>
+    using _if_range = typename std::enable_if<!std::is_arithmetic<typename std::decay<T>::type>::value>::type;
+    
+    template<class lhs_t, class rhs_t>
+    using _if_expression_operands = typename std::enable_if<_is_expression<lhs_t>::value || _is_expression<rhs_t>::value>::type;
+    
+    template<class T, class = _if_range<T>>
+    inline _expression_t<T> lazy(T &&x) { return _as_expression(std::forward<T>(x)); }
+    
+    template<class T, class = _if_range<T>>
+    inline unary_expression<_abs_function, _expression_t<T>> abs(T &&x)
+    {
+        return unary_expression<_abs_function, _expression_t<T>>(_abs_function(), _as_expression(std::forward<T>(x)));
+    }
+    
+    template<class T, class = _if_range<T>>
+    inline unary_expression<_square_function, _expression_t<T>> square(T &&x)
+    {
+        return unary_expression<_square_function, _expression_t<T>>(_square_function(), _as_expression(std::forward<T>(x)));
+    }
+    
+    template<class function_t, class lhs_t, class rhs_t>
+    inline binary_expression<function_t, _expression_t<lhs_t>, _expression_t<rhs_t>> _make_binary(lhs_t &&lhs, rhs_t &&rhs)
+    {
+        return binary_expression<function_t, _expression_t<lhs_t>, _expression_t<rhs_t>>(function_t(), 
+            _as_expression(std::forward<lhs_t>(lhs)), _as_expression(std::forward<rhs_t>(rhs)));
+    }
+    
+    template<class lhs_t, class rhs_t, class = _if_expression_operands<lhs_t, rhs_t>>
+    inline binary_expression<_plus_function, _expression_t<lhs_t>, _expression_t<rhs_t>> operator+(lhs_t &&lhs, rhs_t &&rhs)
+    {
+        return _make_binary<_plus_function>(std::forward<lhs_t>(lhs), std::forward<rhs_t>(rhs));
+    }
+    
+    template<class lhs_t, class rhs_t, class = _if_expression_operands<lhs_t, rhs_t>>
+    inline binary_expression<_minus_function, _expression_t<lhs_t>, _expression_t<rhs_t>> operator-(lhs_t &&lhs, rhs_t &&rhs)
+    {
+        return _make_binary<_minus_function>(std::forward<lhs_t>(lhs), std::forward<rhs_t>(rhs));
+    }
+    
+    template<class lhs_t, class rhs_t, class = _if_expression_operands<lhs_t, rhs_t>>
+    inline binary_expression<_multiplies_function, _expression_t<lhs_t>, _expression_t<rhs_t>> operator*(lhs_t &&lhs, rhs_t &&rhs)
+    {
+        return _make_binary<_multiplies_function>(std::forward<lhs_t>(lhs), std::forward<rhs_t>(rhs));
+    }
+    
+    template<class lhs_t, class rhs_t, class = _if_expression_operands<lhs_t, rhs_t>>
+    inline binary_expression<_divides_function, _expression_t<lhs_t>, _expression_t<rhs_t>> operator/(lhs_t &&lhs, rhs_t &&rhs)
+    {
+        return _make_binary<_divides_function>(std::forward<lhs_t>(lhs), std::forward<rhs_t>(rhs));
+    }
+    
+    // Materializes an expression into a container, which is resized if necessary. For other 
+    // destinations use the iterators: std::copy(expr.begin(), expr.end(), out).
+    template<class container_t, class derived_t>
+    inline container_t &eval(container_t &out, const expression<derived_t> &expr)
+    {
+        const auto &e = expr.derived();
+        const auto n = e.size();
+        
+        if( out.size() != n )
+            out.resize(n);
+        
+        auto it = out.begin();
+        for(std::size_t i=0; i<n; ++i, ++it)
+            *it = e[i];
+        
+        return out;
+    }
+    
+    template<class derived_t, class container_t = std::vector<typename derived_t::value_type>>
+    inline container_t eval(const expression<derived_t> &expr)
+    {
+        container_t result;
+        eval(result, expr);
+        return result;
+    }
+    
+    // Reductions evaluate the expression in chunks which stay in the L1 cache, so the 
+    // vectorized kernels can be used: func(chunk, size) is called for each chunk
+    template<class expression_t, class function_t>
+    inline void _for_each_chunk(const expression_t &e, std::size_t first, const std::size_t last, function_t func)
+    {
+        using value_t = typename expression_t::value_type;
+        constexpr std::size_t chunk = 1024;
+        value_t buffer[chunk];
+        
+        for(; first < last; first += chunk)
+        {
+            const auto n = std::min(chunk, last - first);
+            
+            for(std::size_t j=0; j<n; ++j)
+                buffer[j] = e[first + j];
+            
+            func(static_cast<const value_t *>(buffer), n);
+        }
+    }
+    
+    template<class expression_t, class value_t = typename expression_t::value_type>
+    inline value_t _expression_sum(const expression_t &e, std::size_t first, const std::size_t last, std::true_type)
+    {
+        value_t sum = 0;
+        _for_each_chunk(e, first, last, [&](const value_t *chunk, std::size_t n){ sum += simd_sum(chunk, n); });
+        return sum;
+    }
+    
+    template<class expression_t, class value_t = typename expression_t::value_type>
+    inline value_t _expression_sum(const expression_t &e, std::size_t first, const std::size_t last, std::false_type)
+    {
+        value_t sum = 0;
+        for(; first < last; ++first) sum += e[first];
+        return sum;
+    }
+    
+    template<class expression_t, class value_t = typename expression_t::value_type>
+    inline running_stats<value_t> _expression_stats(const expression_t &e, std::size_t first, const std::size_t last, std::true_type)
+    {
+        running_stats<value_t> stats;
+        _for_each_chunk(e, first, last, [&](const value_t *chunk, std::size_t n){ stats.merge(_simd_variance_stats(chunk, n)); });
+        return stats;
+    }
+    
+    template<class expression_t, class stats_t = running_stats<_float_t<typename expression_t::value_type>>>
+    inline stats_t _expression_stats(const expression_t &e, std::size_t first, const std::size_t last, std::false_type)
+    {
+        stats_t stats;
+        for(; first < last; ++first) stats.push(e[first]);
+        return stats;
+    }
+    
+    template<class expression_t, class value_t = typename expression_t::value_type>
+    inline running_stats<_float_t<value_t>> _expression_stats(const expression_iterator<expression_t> begin, const expression_iterator<expression_t> end)
+    {
+        return _expression_stats(begin.expression(), begin.index(), end.index(), 
+                                 std::integral_constant<bool, _is_simd_type<value_t>::value && std::is_floating_point<value_t>::value>());
+    }
+    
+    // Mathematical container functions
+    // ================================
+    
+    // sums in the element type, so integer sums are exact (as long as they do not overflow)
+    template<class iterator_t, class number_t = typename std::iterator_traits<iterator_t>::value_type>
+    inline number_t _sum(iterator_t begin, const iterator_t end, std::false_type)
+    {
+        number_t sum = 0;
+        
+        for(; begin != end; ++begin)
+            sum += *begin;
+        
+        return sum;
+    }
+    
+    template<class iterator_t, class number_t = typename std::iterator_traits<iterator_t>::value_type>
+    inline number_t _sum(const iterator_t begin, const iterator_t end, std::true_type)
+    {
+        const std::size_t count = end - begin;
+        return simd_sum(count ? &*begin : nullptr, count);
+    }
+    
+    template<class expression_t, class number_t = typename expression_t::value_type>
+    inline number_t _sum(const expression_iterator<expression_t> begin, const expression_iterator<expression_t> end, std::false_type)
+    {
+        return _expression_sum(begin.expression(), begin.index(), end.index(), _is_simd_type<number_t>());
+    }
+    
+    template<class iterator_t, class number_t = typename std::iterator_traits<iterator_t>::value_type>
+    inline number_t _sum(const iterator_t begin, const iterator_t end)
+    {
+        return _sum(begin, end, _use_simd<iterator_t>());
+    }
+    
+    template<class iterator_t, class number_t = typename std::iterator_traits<iterator_t>::value_type>
+    inline number_t _average(iterator_t begin, const iterator_t end, std::false_type)
+    {
+        number_t sum = 0;
+        std::size_t count = 0;
+        
+        for(; begin != end; ++begin, ++count)
+            sum += *begin;
+        
+        return sum / static_cast<number_t>(count);
+    }
+    
+    template<class iterator_t, class number_t = typename std::iterator_traits<iterator_t>::value_type>
+    inline number_t _average(const iterator_t begin, const iterator_t end, std::true_type)
+    {
+        return _sum(begin, end, std::true_type()) / static_cast<number_t>(end - begin);
+    }
+    
+    // expressions are fused into a single loop
+    template<class expression_t, class number_t = typename expression_t::value_type>
+    inline number_t _average(const expression_iterator<expression_t> begin, const expression_iterator<expression_t> end, std::false_type)
+    {
+        return _sum(begin, end, std::false_type()) / static_cast<number_t>(end - begin);
+    }
+    
+    // Average (single pass, also works with input iterators)
+    template<class iterator_t, class number_t = typename std::iterator_traits<iterator_t>::value_type>
+    inline number_t average(iterator_t begin, const iterator_t end)
+    {
+        static_assert( std::is_arithmetic<number_t>::value, "Container must store arithmetic type");
+        
+        return _average(begin, end, _use_simd<iterator_t>());
+    }
+    
+    template<class container_t, class number_t = typename container_t::value_type>
+    inline number_t average(const container_t &data)
+    {
+        return average(data.begin(), data.end());
+    }
+    
+    template<class iterator_t, class number_t = typename std::iterator_traits<iterator_t>::value_type>
+    inline number_t _standard_deviation(const iterator_t begin, const iterator_t end, std::false_type)
+    {
+        return static_cast<number_t>(compute_stats<iterator_t, running_stats<_float_t<number_t>>>(begin, end).stddev());
+    }
+    
+    template<class iterator_t, class number_t = typename std::iterator_traits<iterator_t>::value_type>
+    inline number_t _standard_deviation(const iterator_t begin, const iterator_t end, std::true_type)
+    {
+        const std::size_t count = end - begin;
+        return _simd_variance_stats(count ? &*begin : nullptr, count).stddev();
+    }
+    
+    template<class expression_t, class number_t = typename expression_t::value_type>
+    inline number_t _standard_deviation(const expression_iterator<expression_t> begin, const expression_iterator<expression_t> end, std::false_type)
+    {
+        return static_cast<number_t>(_expression_stats(begin, end).stddev());
+    }
+    
+    // Standard deviation (single pass with mc::running_stats)
+    template<class iterator_t, class number_t = typename std::iterator_traits<iterator_t>::value_type>
+    inline number_t standard_deviation(const iterator_t begin, const iterator_t end)
+    {
+        static_assert( std::is_arithmetic<number_t>::value, "Container must store arithmetic type");
+        
+        return _standard_deviation(begin, end, 
+                                   std::integral_constant<bool, _use_simd<iterator_t>::value && std::is_floating_point<number_t>::value>());
+    }
+    
+    template<class container_t, class number_t = typename container_t::value_type>
+    inline number_t standard_deviation(const container_t &data)
+    {
+        return standard_deviation(data.begin(), data.end());
+    }
+    
+    // Vector operations
+    
+    template<class in_iterator_t, class out_iterator_t>
+    struct _use_simd_transform : std::integral_constant<bool, _use_simd<in_iterator_t>::value && _use_simd<out_iterator_t>::value &&
+        std::is_same<typename std::iterator_traits<in_iterator_t>::value_type, typename std::iterator_traits<out_iterator_t>::value_type>::value> { };
+    
+    template<bool absolute, class in_iterator_t, class out_iterator_t>
+    inline out_iterator_t _transform(const in_iterator_t begin, const in_iterator_t end, out_iterator_t out, std::false_type)
+    {
+        using number_t = typename std::iterator_traits<in_iterator_t>::value_type;
+        
+        if( absolute )
+            return std::transform(begin, end, out, [](const number_t &el){ return std::abs(el); });
+        else
+            return std::transform(begin, end, out, [](const number_t &el){ return el*el; });
+    }
+    
+    template<bool absolute, class in_iterator_t, class out_iterator_t>
+    inline out_iterator_t _transform(const in_iterator_t begin, const in_iterator_t end, out_iterator_t out, std::true_type)
+    {
+        if( begin != end )
+            simd_transform<absolute>(&*begin, &*out, end - begin);
+        
+        return out + (end - begin);
+    }
+    
+    template<class iterator_t, 
+             class container_t = std::vector<typename std::iterator_traits<iterator_t>::value_type>, 
+             class number_t = typename std::iterator_traits<iterator_t>::value_type>
+    inline container_t square_container(const iterator_t begin, const iterator_t end)
+    {
+        static_assert( std::is_arithmetic<number_t>::value, "Container must store arithmetic type");
+        container_t squared_container(end - begin);
+        
+        _transform<false>(begin, end, squared_container.begin(), 
+                          _use_simd_transform<iterator_t, typename container_t::iterator>());
+        
+        return squared_container;
+    }
+    
+    template<class container_t , class number_t = typename container_t::value_type>
+    inline container_t square_container(const container_t &data)
+    {
+        return square_container<typename container_t::const_iterator, container_t>(data.begin(), data.end());
+    }
+    
+    template<class iterator_t, 
+             class container_t = std::vector<typename std::iterator_traits<iterator_t>::value_type>, 
+             class number_t = typename std::iterator_traits<iterator_t>::value_type>
+    inline container_t abs_container(const iterator_t begin, const iterator_t end)
+    {
+        static_assert( std::is_arithmetic<number_t>::value, "Container must store arithmetic type");
+        container_t retcont(end - begin);
+        
+        _transform<true>(begin, end, retcont.begin(), _use_simd_transform<iterator_t, typename container_t::iterator>());
+        
+        return retcont;
+    }
+
+    template<class container_t , class number_t = typename container_t::value_type>
+    inline container_t abs_container(const container_t &data)
+    {
+        return abs_container<typename container_t::const_iterator, container_t>(data.begin(), data.end());
+    }
+    
+    // Output iterator variants write to 'out' (which may be 'begin') and return the end of the output
+    template<class in_iterator_t, class out_iterator_t>
+    inline out_iterator_t square_container(const in_iterator_t begin, const in_iterator_t end, out_iterator_t out)
+    {
+        static_assert( std::is_arithmetic<typename std::iterator_traits<in_iterator_t>::value_type>::value, "Container must store arithmetic type");
+        return _transform<false>(begin, end, out, _use_simd_transform<in_iterator_t, out_iterator_t>());
+    }
+    
+    template<class in_iterator_t, class out_iterator_t>
+    inline out_iterator_t abs_container(const in_iterator_t begin, const in_iterator_t end, out_iterator_t out)
+    {
+        static_assert( std::is_arithmetic<typename std::iterator_traits<in_iterator_t>::value_type>::value, "Container must store arithmetic type");
+        return _transform<true>(begin, end, out, _use_simd_transform<in_iterator_t, out_iterator_t>());
+    }
+    
+    template<class container_t>
+    inline container_t &square_inplace(container_t &data)
+    {
+        square_container(data.begin(), data.end(), data.begin());
+        return data;
+    }
+    
+    template<class container_t>
+    inline container_t &abs_inplace(container_t &data)
+    {
+        abs_container(data.begin(), data.end(), data.begin());
+        return data;
+    }
+    
+    // Parallel overloads
+    // ==================
+    
+    // With an execution policy, e.g. mc::average(mc::par, data) or mc::average(mc::par(8), data), 
+    // the data is split into blocks of a fixed number of elements, which are handed out to the 
+    // threads dynamically. Partial results are combined in block order, so the result does not 
+    // depend on the number of threads and is reproducible bit for bit. Ranges smaller than 
+    // 'threshold' are processed on the calling thread.
+    
+    // block_size = 0 means automatic as in mc::parallel_for, the blocks do not depend on the number
+    // of threads so that the results are the same for every thread count
+    inline std::size_t _block_size(const parallel_policy &policy)
+    {
+        return policy.block_size ? policy.block_size : parallel_policy().block_size;
+    }
+    
+    // calls func(block_begin, block_end, block_index) for all blocks, returns the number of blocks
+    template<class iterator_t, class function_t>
+    inline std::size_t _for_each_block(const parallel_policy &policy, const iterator_t begin, const iterator_t end, function_t func)
+    {
+        const std::size_t n = end - begin;
+        const std::size_t block = _block_size(policy);
+        const std::size_t blocks = (n + block - 1) / block;
+        
+        _run_tasks(blocks, policy.threads, [&](std::size_t i)
+        {
+            auto first = begin + i * block;
+            auto last = begin + std::min(n, (i + 1) * block);
+            func(first, last, i);
+        });
+        
+        return blocks;
+    }
+    
+    template<class iterator_t, class number_t = typename std::iterator_traits<iterator_t>::value_type>
+    inline number_t average(const sequential_policy &, const iterator_t begin, const iterator_t end) { return average(begin, end); }
+    
+    template<class iterator_t, class number_t = typename std::iterator_traits<iterator_t>::value_type>
+    inline number_t average(const parallel_policy &policy, const iterator_t begin, const iterator_t end)
+    {
+        static_assert( std::is_arithmetic<number_t>::value, "Container must store arithmetic type");
+        
+        const std::size_t n = end - begin;
+        
+        if( n < policy.threshold )
+            return average(begin, end);
+        
+        std::vector<number_t> sums((n + _block_size(policy) - 1) / _block_size(policy));
+        _for_each_block(policy, begin, end, [&](iterator_t first, iterator_t last, std::size_t i){ sums[i] = _sum(first, last); });
+        
+        return std::accumulate(sums.begin(), sums.end(), static_cast<number_t>(0)) / static_cast<number_t>(n);
+    }
+    
+    template<class policy_t, class container_t, class number_t = typename container_t::value_type>
+    inline number_t average(const policy_t &policy, const container_t &data)
+    {
+        return average(policy, data.begin(), data.end());
+    }
+    
+    template<class iterator_t, class stats_t = running_stats<_float_t<typename std::iterator_traits<iterator_t>::value_type>>>
+    inline stats_t _block_stats(const iterator_t begin, const iterator_t end, std::false_type)
+    {
+        return compute_stats<iterator_t, stats_t>(begin, end);
+    }
+    
+    template<class iterator_t>
+    inline auto _block_stats(const iterator_t begin, const iterator_t end, std::true_type) -> decltype(_simd_variance_stats(&*begin, 0))
+    {
+        return _simd_variance_stats(begin != end ? &*begin : nullptr, end - begin);
+    }
+    
+    template<class expression_t>
+    inline auto _block_stats(const expression_iterator<expression_t> begin, const expression_iterator<expression_t> end, std::false_type) 
+        -> decltype(_expression_stats(begin, end))
+    {
+        return _expression_stats(begin, end);
+    }
+    
+    template<class iterator_t, class number_t = typename std::iterator_traits<iterator_t>::value_type>
+    inline number_t standard_deviation(const sequential_policy &, const iterator_t begin, const iterator_t end) { return standard_deviation(begin, end); }
+    
+    template<class iterator_t, class number_t = typename std::iterator_traits<iterator_t>::value_type>
+    inline number_t standard_deviation(const parallel_policy &policy, const iterator_t begin, const iterator_t end)
+    {
+        static_assert( std::is_arithmetic<number_t>::value, "Container must store arithmetic type");
+        
+        using stats_t = running_stats<_float_t<number_t>>;
+        const std::size_t n = end - begin;
+        
+        if( n < policy.threshold )
+            return standard_deviation(begin, end);
+        
+        std::vector<stats_t> partial((n + _block_size(policy) - 1) / _block_size(policy));
+        _for_each_block(policy, begin, end, [&](iterator_t first, iterator_t last, std::size_t i)
+        {
+            partial[i] = _block_stats(first, last, std::integral_constant<bool, _use_simd<iterator_t>::value && std::is_floating_point<number_t>::value>());
+        });
+        
+        stats_t stats;
+        for(const auto &p : partial) stats.merge(p);
+        
+        return static_cast<number_t>(stats.stddev());
+    }
+    
+    template<class policy_t, class container_t, class number_t = typename container_t::value_type>
+    inline number_t standard_deviation(const policy_t &policy, const container_t &data)
+    {
+        return standard_deviation(policy, data.begin(), data.end());
+    }
+    
+    template<bool absolute, class iterator_t, class container_t>
+    inline container_t _transform_container(const parallel_policy &policy, const iterator_t begin, const iterator_t end)
+    {
+        static_assert( std::is_arithmetic<typename std::iterator_traits<iterator_t>::value_type>::value, "Container must store arithmetic type");
+        
+        container_t result(end - begin);
+        
+        if( static_cast<std::size_t>(end - begin) < policy.threshold )
+        {
+            _transform<absolute>(begin, end, result.begin(), _use_simd_transform<iterator_t, typename container_t::iterator>());
+            return result;
+        }
+        
+        auto out = result.begin();
+        _for_each_block(policy, begin, end, [&](iterator_t first, iterator_t last, std::size_t)
+        {
+            _transform<absolute>(first, last, out + (first - begin), _use_simd_transform<iterator_t, typename container_t::iterator>());
+        });
+        
+        return result;
+    }
+    
+    template<class iterator_t, 
+             class container_t = std::vector<typename std::iterator_traits<iterator_t>::value_type>>
+    inline container_t square_container(const parallel_policy &policy, const iterator_t begin, const iterator_t end)
+    {
+        return _transform_container<false, iterator_t, container_t>(policy, begin, end);
+    }
+    
+    template<class container_t>
+    inline container_t square_container(const parallel_policy &policy, const container_t &data)
+    {
+        return square_container<typename container_t::const_iterator, container_t>(policy, data.begin(), data.end());
+    }
+    
+    template<class iterator_t, 
+             class container_t = std::vector<typename std::iterator_traits<iterator_t>::value_type>>
+    inline container_t abs_container(const parallel_policy &policy, const iterator_t begin, const iterator_t end)
+    {
+        return _transform_container<true, iterator_t, container_t>(policy, begin, end);
+    }
+    
+    template<class container_t>
+    inline container_t abs_container(const parallel_policy &policy, const container_t &data)
+    {
+        return abs_container<typename container_t::const_iterator, container_t>(policy, data.begin(), data.end());
+    }
+    
+    template<class container_t>
+    inline container_t square_container(const sequential_policy &, const container_t &data) { return square_container(data); }
+    
+    template<class container_t>
+    inline container_t abs_container(const sequential_policy &, const container_t &data) { return abs_container(data); }
+    
+    // Order statistics
+    // ================
+    
+    // Percentiles are interpolated linearly between the two closest ranks (rank p / 100 * (n - 1), 
+    // the default of numpy). The plain functions copy the data once, the *_inplace variants 
+    // reorder the given range instead. Selection is O(n) with std::nth_element (introselect).
+    
+    template<class result_t>
+    inline result_t _interpolate(result_t lower, result_t upper, double fraction)
+    {
+        return fraction == 0.0 ? lower : lower + static_cast<result_t>(fraction) * (upper - lower);
+    }
+    
+    inline double _percentile_position(std::size_t n, double p)
+    {
+        if( n == 0 ) throw std::runtime_error("percentile of an empty range");
+        if( p != p ) throw std::runtime_error("percentile is NaN");
+        
+        return std::min(std::max(p, 0.0), 100.0) / 100.0 * (n - 1);
+    }
+    
+    template<class iterator_t, class result_t = _float_t<typename std::iterator_traits<iterator_t>::value_type>>
+    inline result_t percentile_inplace(const iterator_t begin, const iterator_t end, double p)
+    {
+        const std::size_t n = end - begin;
+        const double position = _percentile_position(n, p);
+        const auto rank = static_cast<std::size_t>(position);
+        
+        std::nth_element(begin, begin + rank, end);
+        
+        const auto lower = static_cast<result_t>(begin[rank]);
+        const auto upper = rank + 1 < n ? static_cast<result_t>(*std::min_element(begin + rank + 1, end)) : lower;
+        
+        return _interpolate(lower, upper, position - rank);
+    }
+    
+    template<class container_t, class result_t = _float_t<typename container_t::value_type>>
+    inline result_t percentile_inplace(container_t &data, double p) { return percentile_inplace(data.begin(), data.end(), p); }
+    
+    template<class iterator_t, class result_t = _float_t<typename std::iterator_traits<iterator_t>::value_type>>
+    inline result_t percentile(const iterator_t begin, const iterator_t end, double p)
+    {
+        std::vector<typename std::iterator_traits<iterator_t>::value_type> copy(begin, end);
+        return percentile_inplace(copy.begin(), copy.end(), p);
+    }
+    
+    template<class container_t, class result_t = _float_t<typename container_t::value_type>>
+    inline result_t percentile(const container_t &data, double p) { return percentile(data.begin(), data.end(), p); }
+    
+    template<class iterator_t, class result_t = _float_t<typename std::iterator_traits<iterator_t>::value_type>>
+    inline result_t median_inplace(const iterator_t begin, const iterator_t end) { return percentile_inplace(begin, end, 50.0); }
+    
+    template<class container_t, class result_t = _float_t<typename container_t::value_type>>
+    inline result_t median_inplace(container_t &data) { return percentile_inplace(data.begin(), data.end(), 50.0); }
+    
+    template<class iterator_t, class result_t = _float_t<typename std::iterator_traits<iterator_t>::value_type>>
+    inline result_t median(const iterator_t begin, const iterator_t end) { return percentile(begin, end, 50.0); }
+    
+    template<class container_t, class result_t = _float_t<typename container_t::value_type>>
+    inline result_t median(const container_t &data) { return percentile(data.begin(), data.end(), 50.0); }
+    
+    // selects all ranks in [rank_first, rank_last) (sorted) within data[first, last): partitions 
+    // at the middle rank and recurses into both sides, O(n log k) for k ranks
+    template<class iterator_t, class rank_iterator_t>
+    inline void _multi_select(const iterator_t data, std::size_t first, std::size_t last, rank_iterator_t rank_first, rank_iterator_t rank_last)
+    {
+        if( rank_first == rank_last ) return;
+        
+        auto middle = rank_first + (rank_last - rank_first) / 2;
+        std::nth_element(data + first, data + *middle, data + last);
+        
+        _multi_select(data, first, *middle, rank_first, middle);
+        _multi_select(data, *middle + 1, last, middle + 1, rank_last);
+    }
+    
+    // Many percentiles at once, e.g. percentiles(data, {50, 90, 99}), the results have the order of 'ps'
+    template<class iterator_t, class result_t = _float_t<typename std::iterator_traits<iterator_t>::value_type>>
+    inline std::vector<result_t> percentiles_inplace(const iterator_t begin, const iterator_t end, const std::vector<double> &ps)
+    {
+        const std::size_t n = end - begin;
+        std::vector<std::size_t> ranks;
+        
+        for(auto p : ps)
+        {
+            const auto rank = static_cast<std::size_t>(_percentile_position(n, p));
+            ranks.push_back(rank);
+            if( rank + 1 < n ) ranks.push_back(rank + 1);
+        }
+        
+        std::sort(ranks.begin(), ranks.end());
+        ranks.erase(std::unique(ranks.begin(), ranks.end()), ranks.end());
+        
+        _multi_select(begin, 0, n, ranks.begin(), ranks.end());
+        
+        std::vector<result_t> result;
+        result.reserve(ps.size());
+        
+        for(auto p : ps)
+        {
+            const double position = _percentile_position(n, p);
+            const auto rank = static_cast<std::size_t>(position);
+            const auto lower = static_cast<result_t>(begin[rank]);
+            
+            result.push_back(_interpolate(lower, rank + 1 < n ? static_cast<result_t>(begin[rank + 1]) : lower, position - rank));
+        }
+        
+        return result;
+    }
+    
+    template<class container_t, class result_t = _float_t<typename container_t::value_type>>
+    inline std::vector<result_t> percentiles_inplace(container_t &data, const std::vector<double> &ps) 
+    { 
+        return percentiles_inplace(data.begin(), data.end(), ps); 
+    }
+    
+    template<class iterator_t, class result_t = _float_t<typename std::iterator_traits<iterator_t>::value_type>>
+    inline std::vector<result_t> percentiles(const iterator_t begin, const iterator_t end, const std::vector<double> &ps)
+    {
+        std::vector<typename std::iterator_traits<iterator_t>::value_type> copy(begin, end);
+        return percentiles_inplace(copy.begin(), copy.end(), ps);
+    }
+    
+    template<class container_t, class result_t = _float_t<typename container_t::value_type>>
+    inline std::vector<result_t> percentiles(const container_t &data, const std::vector<double> &ps) 
+    { 
+        return percentiles(data.begin(), data.end(), ps); 
+    }
+    
+    // Mean without the smallest and largest 'proportion' of the values (floor(proportion * n) 
+    // values are removed at each end), proportion in [0, 0.5)
+    template<class iterator_t, class result_t = _float_t<typename std::iterator_traits<iterator_t>::value_type>>
+    inline result_t trimmed_mean_inplace(const iterator_t begin, const iterator_t end, double proportion)
+    {
+        const std::size_t n = end - begin;
+        
+        if( proportion != proportion ) throw std::runtime_error("trimmed mean proportion is NaN");
+        const auto cut = static_cast<std::size_t>(std::min(std::max(proportion, 0.0), 0.5) * n);
+        
+        if( n == 0 || 2 * cut >= n ) 
+            throw std::runtime_error("trimmed mean of an empty range");
+        
+        if( cut > 0 )
+        {
+            std::nth_element(begin, begin + cut, end);
+            std::nth_element(begin + cut, begin + (n - cut - 1), end);
+        }
+        
+        result_t sum = 0;
+        for(auto it = begin + cut; it != begin + (n - cut); ++it)
+            sum += static_cast<result_t>(*it);
+        
+        return sum / static_cast<result_t>(n - 2 * cut);
+    }
+    
+    template<class container_t, class result_t = _float_t<typename container_t::value_type>>
+    inline result_t trimmed_mean_inplace(container_t &data, double proportion) { return trimmed_mean_inplace(data.begin(), data.end(), proportion); }
+    
+    template<class iterator_t, class result_t = _float_t<typename std::iterator_traits<iterator_t>::value_type>>
+    inline result_t trimmed_mean(const iterator_t begin, const iterator_t end, double proportion)
+    {
+        std::vector<typename std::iterator_traits<iterator_t>::value_type> copy(begin, end);
+        return trimmed_mean_inplace(copy.begin(), copy.end(), proportion);
+    }
+    
+    template<class container_t, class result_t = _float_t<typename container_t::value_type>>
+    inline result_t trimmed_mean(const container_t &data, double proportion) { return trimmed_mean(data.begin(), data.end(), proportion); }
+    
+    template<class iterator_t, class result_t>
+    inline result_t _mad_inplace(const iterator_t begin, const iterator_t end, std::true_type /*is_floating_point*/)
+    {
+        using number_t = typename std::iterator_traits<iterator_t>::value_type;
+        const result_t center = median_inplace(begin, end);
+        
+        std::transform(begin, end, begin, [&](const number_t &x)
+        { 
+            const auto deviation = static_cast<result_t>(x) - center;
+            return static_cast<number_t>(deviation < 0 ? -deviation : deviation);
+        });
+        
+        return median_inplace(begin, end);
+    }
+    
+    // deviations of integers are not integral (e.g. 1.5), they do not fit into the data
+    template<class iterator_t, class result_t>
+    inline result_t _mad_inplace(const iterator_t begin, const iterator_t end, std::false_type /*is_floating_point*/)
+    {
+        std::vector<result_t> deviations(begin, end);
+        return _mad_inplace<typename std::vector<result_t>::iterator, result_t>(deviations.begin(), deviations.end(), std::true_type());
+    }
+    
+    // Median absolute deviation from the median (not scaled, multiply by 1.4826 to estimate 
+    // the standard deviation of a normal distribution). The in-place variant overwrites floating
+    // point data with the absolute deviations, integer data is copied.
+    template<class iterator_t, class result_t = _float_t<typename std::iterator_traits<iterator_t>::value_type>>
+    inline result_t mad_inplace(const iterator_t begin, const iterator_t end)
+    {
+        return _mad_inplace<iterator_t, result_t>(begin, end, std::is_floating_point<typename std::iterator_traits<iterator_t>::value_type>());
+    }
+    
+    template<class container_t, class result_t = _float_t<typename container_t::value_type>>
+    inline result_t mad_inplace(container_t &data) { return mad_inplace(data.begin(), data.end()); }
+    
+    template<class iterator_t, class result_t = _float_t<typename std::iterator_traits<iterator_t>::value_type>>
+    inline result_t mad(const iterator_t begin, const iterator_t end)
+    {
+        std::vector<result_t> copy(begin, end);
+        return mad_inplace(copy.begin(), copy.end());
+    }
+    
+    template<class container_t, class result_t = _float_t<typename container_t::value_type>>
+    inline result_t mad(const container_t &data) { return mad(data.begin(), data.end()); }
+    
+    // Parallel selection of the values with rank 'rank' and 'rank + 1' which neither copies nor 
+    // reorders the data: two pivots around the rank are taken from a sample, the elements between 
+    // them are counted and then collected in parallel, only this small band is selected. If the 
+    // rank is not inside the band (unlucky sample) the whole range is copied and selected.
+    template<class iterator_t, class number_t = typename std::remove_cv<typename std::iterator_traits<iterator_t>::value_type>::type>
+    inline std::pair<number_t, number_t> _parallel_select(const parallel_policy &policy, const iterator_t begin, const iterator_t end, std::size_t rank)
+    {
+        const std::size_t n = end - begin;
+        const std::size_t next_rank = std::min(rank + 1, n - 1);
+        
+        // fixed seed, so results and timings are reproducible
+        std::minstd_rand random(5489u);
+        std::vector<number_t> sample(std::min<std::size_t>(n, 1 << 16));
+        for(auto &s : sample) s = begin[random() % n];
+        std::sort(sample.begin(), sample.end());
+        
+        // the rank of the target in the sample has a standard deviation below sqrt(m) / 2
+        const double m = static_cast<double>(sample.size());
+        const double center = static_cast<double>(rank) / n * m;
+        const double margin = 2.0 * std::sqrt(m) + 2.0;
+        const number_t lower = sample[static_cast<std::size_t>(std::max(center - margin, 0.0))];
+        const number_t upper = sample[static_cast<std::size_t>(std::min(center + 1.0 + margin, m - 1.0))];
+        
+        const std::size_t blocks = (n + _block_size(policy) - 1) / _block_size(policy);
+        std::vector<std::size_t> below(blocks), inside(blocks);
+        
+        _for_each_block(policy, begin, end, [&](iterator_t first, iterator_t last, std::size_t i)
+        {
+            std::size_t b = 0, in = 0;
+            for(; first != last; ++first)
+            {
+                const number_t x = *first;
+                // branch free, x is close to the pivots for a large part of the data
+                b += x < lower;
+                in += !(x < lower) & !(upper < x);
+            }
+            below[i] = b;
+            inside[i] = in;
+        });
+        
+        const std::size_t total_below = std::accumulate(below.begin(), below.end(), std::size_t(0));
+        const std::size_t total_inside = std::accumulate(inside.begin(), inside.end(), std::size_t(0));
+        
+        std::vector<number_t> band;
+        std::size_t band_rank = rank;
+        
+        if( rank >= total_below && next_rank < total_below + total_inside )
+        {
+            // every element is stored, but the output position only advances for elements inside 
+            // the band (branch free). Each block gets one slot of slack for the last store, so 
+            // blocks never write into each other's part, afterwards the band is compacted.
+            std::vector<std::size_t> offsets(blocks, 0);
+            for(std::size_t i=1; i<blocks; ++i) offsets[i] = offsets[i-1] + inside[i-1] + 1;
+            
+            band.resize(total_inside + blocks);
+            _for_each_block(policy, begin, end, [&](iterator_t first, iterator_t last, std::size_t i)
+            {
+                auto out = band.begin() + offsets[i];
+                for(; first != last; ++first)
+                {
+                    const number_t x = *first;
+                    *out = x;
+                    out += !(x < lower) & !(upper < x);
+                }
+            });
+            
+            auto out = band.begin();
+            for(std::size_t i=0; i<blocks; ++i)
+                out = std::move(band.begin() + offsets[i], band.begin() + offsets[i] + inside[i], out);
+            band.resize(total_inside);
+            
+            band_rank = rank - total_below;
+        }
+        else
+            band.assign(begin, end);
+        
+        std::nth_element(band.begin(), band.begin() + band_rank, band.end());
+        const number_t value = band[band_rank];
+        const number_t next = band_rank + 1 < band.size() && next_rank > rank ? *std::min_element(band.begin() + band_rank + 1, band.end()) : value;
+        
+        return std::make_pair(value, next);
+    }
+    
+    template<class iterator_t, class result_t = _float_t<typename std::iterator_traits<iterator_t>::value_type>>
+    inline result_t percentile(const parallel_policy &policy, const iterator_t begin, const iterator_t end, double p)
+    {
+        const std::size_t n = end - begin;
+        
+        if( n < policy.threshold )
+            return percentile(begin, end, p);
+        
+        const double position = _percentile_position(n, p);
+        const auto rank = static_cast<std::size_t>(position);
+        const auto values = _parallel_select(policy, begin, end, rank);
+        
+        return _interpolate(static_cast<result_t>(values.first), static_cast<result_t>(values.second), position - rank);
+    }
+    
+    template<class container_t, class result_t = _float_t<typename container_t::value_type>>
+    inline result_t percentile(const parallel_policy &policy, const container_t &data, double p) 
+    { 
+        return percentile(policy, data.begin(), data.end(), p); 
+    }
+    
+    template<class container_t, class result_t = _float_t<typename container_t::value_type>>
+    inline result_t percentile(const sequential_policy &, const container_t &data, double p) { return percentile(data, p); }
+    
+    template<class container_t, class result_t = _float_t<typename container_t::value_type>>
+    inline std::vector<result_t> percentiles(const parallel_policy &policy, const container_t &data, const std::vector<double> &ps)
+    {
+        if( data.size() < policy.threshold )
+            return percentiles(data, ps);
+        
+        std::vector<result_t> result;
+        for(auto p : ps) result.push_back(percentile(policy, data, p));
+        return result;
+    }
+    
+    template<class container_t, class result_t = _float_t<typename container_t::value_type>>
+    inline std::vector<result_t> percentiles(const sequential_policy &, const container_t &data, const std::vector<double> &ps) 
+    { 
+        return percentiles(data, ps); 
+    }
+    
+    template<class container_t, class result_t = _float_t<typename container_t::value_type>>
+    inline result_t median(const parallel_policy &policy, const container_t &data) { return percentile(policy, data, 50.0); }
+    
+    template<class container_t, class result_t = _float_t<typename container_t::value_type>>
+    inline result_t median(const sequential_policy &, const container_t &data) { return median(data); }
+    
+    // the deviations are a lazy expression, so no copy of the data is made
+    template<class container_t, class result_t = _float_t<typename container_t::value_type>>
+    inline result_t mad(const parallel_policy &policy, const container_t &data)
+    {
+        const result_t center = median(policy, data);
+        return median(policy, mc::abs(mc::lazy(data) - center));
+    }
+    
+    // Multi-column statistics
+    // =======================
+    
+    template<class container_t, class ... containers_t>
+    inline std::size_t _common_size(const container_t &first, const containers_t &... columns)
+    {
+        const std::size_t sizes[] = { static_cast<std::size_t>(first.size()), static_cast<std::size_t>(columns.size())... };
+        
+        for(auto size : sizes)
+            if( size != sizes[0] )
+                throw std::runtime_error("vector sizes do not match!");
+        
+        return sizes[0];
+    }
+    
+    inline void _fill_columns(double *, std::size_t, std::size_t) { }
+    
+    // copies 'rows' values of every column iterator into a row major block with 'stride' columns
+    template<class iterator_t, class ... iterator_ts>
+    inline void _fill_columns(double *out, std::size_t stride, std::size_t rows, iterator_t &it, iterator_ts &... its)
+    {
+        for(std::size_t i=0; i<rows; ++i, ++it)
+            out[i * stride] = static_cast<double>(*it);
+        
+        _fill_columns(out + 1, stride, rows, its...);
+    }
+    
+    // Means and covariances of K columns in a single pass. Rows are processed in blocks: the 
+    // block is centered at its own mean and its co-moments are accumulated with rank-1 updates 
+    // of the K x K matrix (contiguous inner loop, vectorized by the compiler), then the block is 
+    // merged into the total (Chan et al.). Partial results of different threads can be merged.
+    class covariance_stats
+    {
+    public:
+        static constexpr std::size_t block_rows = 256;
+        
+        explicit covariance_stats(std::size_t columns = 0) : 
+            m_columns(columns), m_mean(columns, 0.0), m_comoment(columns * columns, 0.0), m_delta(columns, 0.0) { }
+        
+        // one row with columns() values
+        void push(const double *row)
+        {
+            _merge(1.0, row, nullptr);
+        }
+        
+        template<class ... containers_t>
+        void push_columns(const containers_t &... columns)
+        {
+            push_range(_common_size(columns...), columns.begin()...);
+        }
+        
+        // 'rows' rows, every iterator points to the first value of its column
+        template<class ... iterator_ts>
+        void push_range(std::size_t rows, iterator_ts ... columns)
+        {
+            if( sizeof...(columns) != m_columns )
+                throw std::runtime_error("number of columns does not match");
+            
+            std::vector<double> block(block_rows * m_columns), block_mean(m_columns), block_comoment(m_columns * m_columns);
+            
+            for(std::size_t first = 0; first < rows; first += block_rows)
+            {
+                const std::size_t n = rows - first < block_rows ? rows - first : block_rows;
+                _fill_columns(block.data(), m_columns, n, columns...);
+                _push_block(block.data(), n, block_mean.data(), block_comoment.data());
+            }
+        }
+        
+#if __cplusplus >= 201703L
+        // rows of tuple like elements, e.g. mc::zip(a, b, c)
+        template<class iterator_t>
+        void push_rows(iterator_t begin, const iterator_t end)
+        {
+            std::vector<double> block(block_rows * m_columns), block_mean(m_columns), block_comoment(m_columns * m_columns);
+            
+            while( begin != end )
+            {
+                std::size_t n = 0;
+                
+                for(; n < block_rows && begin != end; ++n, ++begin)
+                {
+                    double *row = block.data() + n * m_columns;
+                    std::apply([&](const auto &... values){ std::size_t k = 0; ((row[k++] = static_cast<double>(values)), ...); }, *begin);
+                }
+                
+                _push_block(block.data(), n, block_mean.data(), block_comoment.data());
+            }
+        }
+#endif
+        
+        void merge(const covariance_stats &other)
+        {
+            if( other.m_columns != m_columns )
+                throw std::runtime_error("number of columns does not match");
+            
+            _merge(other.m_count, other.m_mean.data(), other.m_comoment.data());
+        }
+        
+        covariance_stats &operator+=(const covariance_stats &other) { merge(other); return *this; }
+        
+        std::size_t columns() const { return m_columns; }
+        std::uint64_t count() const { return static_cast<std::uint64_t>(m_count); }
+        double mean(std::size_t i) const { return m_mean[i]; }
+        
+        // population covariance like mc::standard_deviation, sample_covariance divides by n - 1
+        double covariance(std::size_t i, std::size_t j) const { return _comoment(i, j) / m_count; }
+        double sample_covariance(std::size_t i, std::size_t j) const { return _comoment(i, j) / (m_count - 1); }
+        
+        double correlation(std::size_t i, std::size_t j) const
+        {
+            return _comoment(i, j) / std::sqrt(_comoment(i, i) * _comoment(j, j));
+        }
+        
+        std::vector<std::vector<double>> covariance_matrix() const
+        {
+            return _matrix([&](std::size_t i, std::size_t j){ return covariance(i, j); });
+        }
+        
+        std::vector<std::vector<double>> correlation_matrix() const
+        {
+            return _matrix([&](std::size_t i, std::size_t j){ return correlation(i, j); });
+        }
+        
+    private:
+        // only the upper triangle is stored
+        double _comoment(std::size_t i, std::size_t j) const { return i <= j ? m_comoment[i * m_columns + j] : m_comoment[j * m_columns + i]; }
+        
+        template<class function_t>
+        std::vector<std::vector<double>> _matrix(function_t func) const
+        {
+            std::vector<std::vector<double>> result(m_columns, std::vector<double>(m_columns));
+            
+            for(std::size_t i=0; i<m_columns; ++i)
+                for(std::size_t j=0; j<m_columns; ++j)
+                    result[i][j] = func(i, j);
+            
+            return result;
+        }
+        
+        void _push_block(double *block, std::size_t rows, double *mean, double *comoment)
+        {
+            const std::size_t k = m_columns;
+            
+            std::fill(mean, mean + k, 0.0);
+            std::fill(comoment, comoment + k * k, 0.0);
+            
+            for(std::size_t r=0; r<rows; ++r)
+                for(std::size_t i=0; i<k; ++i)
+                    mean[i] += block[r * k + i];
+            
+            for(std::size_t i=0; i<k; ++i) mean[i] /= rows;
+            
+            for(std::size_t r=0; r<rows; ++r)
+            {
+                double *row = block + r * k;
+                for(std::size_t i=0; i<k; ++i) row[i] -= mean[i];
+                
+                for(std::size_t i=0; i<k; ++i)
+                {
+                    const double x = row[i];
+                    double *c = comoment + i * k;
+                    
+                    for(std::size_t j=i; j<k; ++j) 
+                        c[j] += x * row[j];
+                }
+            }
+            
+            _merge(static_cast<double>(rows), mean, comoment);
+        }
+        
+        // Chan et al.: C = C_a + C_b + delta delta^T * n_a n_b / n, comoment may be null (single row)
+        void _merge(double count, const double *mean, const double *comoment)
+        {
+            if( count == 0.0 ) return;
+            
+            const std::size_t k = m_columns;
+            const double total = m_count + count;
+            const double factor = m_count * count / total;
+            
+            for(std::size_t i=0; i<k; ++i)
+                m_delta[i] = mean[i] - m_mean[i];
+            
+            for(std::size_t i=0; i<k; ++i)
+            {
+                double *c = m_comoment.data() + i * k;
+                const double d = m_delta[i] * factor;
+                
+                for(std::size_t j=i; j<k; ++j)
+                    c[j] += (comoment ? comoment[i * k + j] : 0.0) + d * m_delta[j];
+            }
+            
+            for(std::size_t i=0; i<k; ++i)
+                m_mean[i] += m_delta[i] * count / total;
+            
+            m_count = total;
+        }
+        
+        std::size_t m_columns;
+        double m_count = 0.0;
+        std::vector<double> m_mean;
+        std::vector<double> m_comoment;
+        std::vector<double> m_delta;
+    };
+    
+#if __cplusplus >= 201703L
+    template<class range_t>
+    using _row_t = typename std::decay<decltype(*std::begin(std::declval<range_t &>()))>::type;
+    
+    // a single range of tuple like rows, e.g. mc::zip(a, b, c)
+    template<class ... containers_t>
+    struct _zipped_rows : std::false_type { };
+    
+    template<class range_t>
+    struct _zipped_rows<range_t> : _is_tuple_like<_row_t<range_t>> { };
+#endif
+    
+    // columns as in mc::export_containers (equal sizes, arithmetic values) or one zipped range
+    template<class ... containers_t>
+    inline covariance_stats compute_covariance(const containers_t &... columns)
+    {
+#if __cplusplus >= 201703L
+        if constexpr( _zipped_rows<containers_t...>::value )
+        {
+            const auto &rows = std::get<0>(std::forward_as_tuple(columns...));
+            
+            covariance_stats stats(std::tuple_size<_row_t<decltype(rows)>>::value);
+            stats.push_rows(std::begin(rows), std::end(rows));
+            return stats;
+        }
+        else
+#endif
+        {
+            covariance_stats stats(sizeof...(columns));
+            stats.push_columns(columns...);
+            return stats;
+        }
+    }
+    
+    template<class ... containers_t>
+    inline std::size_t _covariance_columns(const containers_t &... columns)
+    {
+#if __cplusplus >= 201703L
+        if constexpr( _zipped_rows<containers_t...>::value )
+            return std::tuple_size<_row_t<decltype(std::get<0>(std::forward_as_tuple(columns...)))>>::value;
+        else
+#endif
+            return sizeof...(columns);
+    }
+    
+    // pushes the rows [first, first + count) of the columns or of the zipped range
+    template<class ... containers_t>
+    inline void _push_rows(covariance_stats &stats, std::size_t first, std::size_t count, const containers_t &... columns)
+    {
+#if __cplusplus >= 201703L
+        if constexpr( _zipped_rows<containers_t...>::value )
+        {
+            const auto begin = std::begin(std::get<0>(std::forward_as_tuple(columns...))) + first;
+            stats.push_rows(begin, begin + count);
+        }
+        else
+#endif
+            stats.push_range(count, (columns.begin() + first)...);
+    }
+    
+    // Rows are split into blocks which are processed in parallel and merged in block order, 
+    // so the result does not depend on the number of threads (random access containers only)
+    template<class ... containers_t>
+    inline covariance_stats compute_covariance(const parallel_policy &policy, const containers_t &... columns)
+    {
+        const std::size_t n = _common_size(columns...);
+        
+        if( n < policy.threshold )
+            return compute_covariance(columns...);
+        
+        const std::size_t block = _block_size(policy);
+        const std::size_t blocks = (n + block - 1) / block;
+        const std::size_t width = _covariance_columns(columns...);
+        std::vector<covariance_stats> partial(blocks, covariance_stats(width));
+        
+        _run_tasks(blocks, policy.threads, [&](std::size_t i)
+        {
+            const std::size_t first = i * block;
+            _push_rows(partial[i], first, std::min(block, n - first), columns...);
+        });
+        
+        covariance_stats stats(width);
+        for(const auto &p : partial) stats.merge(p);
+        
+        return stats;
+    }
+    
+    // K x K matrix of population covariances, e.g. mc::covariance_matrix(a, b, c) or mc::covariance_matrix(mc::par, a, b, c)
+    template<class ... containers_t>
+    inline std::vector<std::vector<double>> covariance_matrix(const containers_t &... columns)
+    {
+        return compute_covariance(columns...).covariance_matrix();
+    }
+    
+    template<class ... containers_t>
+    inline std::vector<std::vector<double>> correlation_matrix(const containers_t &... columns)
+    {
+        return compute_covariance(columns...).correlation_matrix();
+    }
+    
+    // Histogram with fixed bins: bin i counts values in [edges[i], edges[i+1]), the last bin 
+    // also contains its upper edge. Values outside are counted as underflow or overflow, NaN is 
+    // ignored. Equal width bins are found in O(1), others by binary search.
+    class histogram
+    {
+    public:
+        explicit histogram(std::vector<double> edges) : m_edges(std::move(edges))
+        {
+            if( m_edges.size() < 2 || !std::is_sorted(m_edges.begin(), m_edges.end()) )
+                throw std::runtime_error("histogram requires at least two sorted bin edges");
+            
+            m_counts.assign(m_edges.size() - 1, 0);
+        }
+        
+        // 'bins' bins of equal width between min and max
+        histogram(std::size_t bins, double min, double max) : m_counts(std::max<std::size_t>(bins, 1), 0), m_uniform(true)
+        {
+            if( !(min < max) )
+                max = min + 1.0;
+            
+            for(std::size_t i=0; i<=m_counts.size(); ++i)
+                m_edges.push_back(i == m_counts.size() ? max : min + (max - min) * i / m_counts.size());
+            
+            m_scale = m_counts.size() / (max - min);
+        }
+        
+        // bins with (about) the same number of values of 'data', edges at its percentiles
+        template<class container_t>
+        static histogram quantile_bins(const container_t &data, std::size_t bins)
+        {
+            std::vector<double> ps;
+            for(std::size_t i=0; i<=std::max<std::size_t>(bins, 1); ++i)
+                ps.push_back(100.0 * i / std::max<std::size_t>(bins, 1));
+            
+            auto edges = percentiles(data, ps);
+            edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+            if( edges.size() < 2 ) edges.push_back(edges.front() + 1.0);
+            
+            return histogram(std::vector<double>(edges.begin(), edges.end()));
+        }
+        
+        void push(double x)
+        {
+            if( x < m_edges.front() ) { ++m_underflow; return; }
+            if( x > m_edges.back() ) { ++m_overflow; return; }
+            if( x != x ) return;
+            
+            ++m_counts[bin(x)];
+        }
+        
+        template<class iterator_t>
+        void push(iterator_t begin, const iterator_t end)
+        {
+            for(; begin != end; ++begin) push(static_cast<double>(*begin));
+        }
+        
+        void merge(const histogram &other)
+        {
+            if( other.m_edges != m_edges )
+                throw std::runtime_error("histograms with different bins can not be merged");
+            
+            for(std::size_t i=0; i<m_counts.size(); ++i)
+                m_counts[i] += other.m_counts[i];
+            
+            m_underflow += other.m_underflow;
+            m_overflow += other.m_overflow;
+        }
+        
+        histogram &operator+=(const histogram &other) { merge(other); return *this; }
+        
+        // bin of a value inside [edges().front(), edges().back()]
+        std::size_t bin(double x) const
+        {
+            std::size_t i = m_uniform ? static_cast<std::size_t>((x - m_edges.front()) * m_scale) : 
+                                        static_cast<std::size_t>(std::upper_bound(m_edges.begin(), m_edges.end(), x) - m_edges.begin()) - 1;
+            
+            return std::min(i, m_counts.size() - 1);
+        }
+        
+        std::size_t bins() const { return m_counts.size(); }
+        const std::vector<double> &edges() const { return m_edges; }
+        const std::vector<std::uint64_t> &counts() const { return m_counts; }
+        std::uint64_t underflow() const { return m_underflow; }
+        std::uint64_t overflow() const { return m_overflow; }
+        std::uint64_t count() const { return std::accumulate(m_counts.begin(), m_counts.end(), std::uint64_t(0)); }
+        
+        // one row per bin with a bar of at most 'width' characters
+        table to_table(std::size_t width = 40) const
+        {
+            table t;
+            auto &creator = t.create();
+            const auto largest = std::max<std::uint64_t>(*std::max_element(m_counts.begin(), m_counts.end()), 1);
+            
+            creator("from", "to", "count", "")(horizontal_line('-'));
+            
+            for(std::size_t i=0; i<m_counts.size(); ++i)
+                creator(m_edges[i], m_edges[i+1], m_counts[i], std::string(m_counts[i] * width / largest, '#'));
+            
+            return t;
+        }
+        
+    private:
+        std::vector<double> m_edges;
+        std::vector<std::uint64_t> m_counts;
+        std::uint64_t m_underflow = 0;
+        std::uint64_t m_overflow = 0;
+        bool m_uniform = false;
+        double m_scale = 0.0;
+    };
+    
+    inline void _push_histogram_row(histogram *, std::size_t, const std::size_t *) { }
+    
+    template<class iterator_t, class ... iterator_ts>
+    inline void _push_histogram_row(histogram *h, std::size_t row, const std::size_t *sizes, iterator_t &it, iterator_ts &... its)
+    {
+        if( row < *sizes ) h->push(static_cast<double>(*it++));
+        _push_histogram_row(h + 1, row, sizes + 1, its...);
+    }
+    
+    template<class ... iterator_ts>
+    inline void _fill_histogram_rows(histogram *h, const std::size_t *sizes, std::size_t rows, iterator_ts ... its)
+    {
+        for(std::size_t row=0; row<rows; ++row)
+            _push_histogram_row(h, row, sizes, its...);
+    }
+    
+    // Adds every column to its histogram in a single sweep over the rows, a column which is 
+    // shorter than the others ends earlier
+    template<class ... containers_t>
+    inline void fill_histograms(std::vector<histogram> &histograms, const containers_t &... columns)
+    {
+        if( histograms.size() != sizeof...(columns) )
+            throw std::runtime_error("number of histograms must match number of containers");
+        
+        const std::size_t sizes[] = { 0, static_cast<std::size_t>(std::distance(columns.begin(), columns.end()))... };
+        const std::size_t rows = *std::max_element(std::begin(sizes), std::end(sizes));
+        
+        _fill_histogram_rows(histograms.data(), sizes + 1, rows, columns.begin()...);
+    }
+    
+    // One histogram with 'bins' equal width bins from minimum to maximum per column
+    template<class ... containers_t>
+    inline std::vector<histogram> histograms(std::size_t bins, const containers_t &... columns)
+    {
+        std::vector<histogram> result;
+        
+        const int expand[] = { 0, (result.push_back(columns.begin() == columns.end() ? histogram(bins, 0.0, 1.0) :
+            histogram(bins, static_cast<double>(*std::min_element(columns.begin(), columns.end())), 
+                            static_cast<double>(*std::max_element(columns.begin(), columns.end())))), 0)... };
+        (void)expand;
+        
+        fill_histograms(result, columns...);
+        return result;
+    }
+    
+    // One histogram per column with bins of (about) equal counts
+    template<class ... containers_t>
+    inline std::vector<histogram> quantile_histograms(std::size_t bins, const containers_t &... columns)
+    {
+        std::vector<histogram> result;
+        
+        const int expand[] = { 0, (result.push_back(histogram::quantile_bins(columns, bins)), 0)... };
+        (void)expand;
+        
+        fill_histograms(result, columns...);
+        return result;
+    }
+    
+    // Latency histograms and quantile sketches
+    // ========================================
+    
+    // HDR style histogram of non-negative integers, e.g. latencies in nanoseconds. Every power of 
+    // two is split into 2^precision_bits buckets, so a reported value differs from the recorded 
+    // one by less than 2^-(precision_bits+1) relative. Memory is fixed (2^precision_bits * 
+    // (65 - precision_bits) counters, 58 KiB for the default of 7 bits), recording is O(1).
+    class log_histogram
+    {
+    public:
+        explicit log_histogram(unsigned precision_bits = 7) : 
+            m_precision(std::min(std::max(precision_bits, 1u), 16u)), m_counts(bucket_count(m_precision), 0) { }
+        
+        void record(std::uint64_t value, std::uint64_t count = 1)
+        {
+            m_counts[bucket_index(value, m_precision)] += count;
+            m_count += count;
+            m_sum += static_cast<double>(value) * count;
+            m_min = std::min(m_min, value);
+            m_max = std::max(m_max, value);
+        }
+        
+        // durations are recorded in nanoseconds
+        template<class rep_t, class period_t>
+        void record(std::chrono::duration<rep_t, period_t> duration, std::uint64_t count = 1)
+        {
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+            record(static_cast<std::uint64_t>(ns > 0 ? ns : 0), count);
+        }
+        
+        void merge(const log_histogram &other)
+        {
+            if( other.m_precision != m_precision )
+                throw std::runtime_error("histograms with different precision can not be merged");
+            
+            for(std::size_t i=0; i<m_counts.size(); ++i)
+                m_counts[i] += other.m_counts[i];
+            
+            m_count += other.m_count;
+            m_sum += other.m_sum;
+            m_min = std::min(m_min, other.m_min);
+            m_max = std::max(m_max, other.m_max);
+        }
+        
+        log_histogram &operator+=(const log_histogram &other) { merge(other); return *this; }
+        
+        void reset() { *this = log_histogram(m_precision); }
+        
+        unsigned precision_bits() const { return m_precision; }
+        std::uint64_t count() const { return m_count; }
+        std::uint64_t min() const { return m_count ? m_min : 0; }
+        std::uint64_t max() const { return m_max; }
+        double mean() const { return m_count ? m_sum / m_count : 0.0; }
+        
+        // smallest value v with at least q * count() values <= v (bucket midpoint), q in [0,1]
+        std::uint64_t quantile(double q) const
+        {
+            if( m_count == 0 ) return 0;
+            
+            auto rank = static_cast<std::uint64_t>(std::ceil(std::min(std::max(q, 0.0), 1.0) * m_count));
+            rank = std::max<std::uint64_t>(rank, 1);
+            
+            std::uint64_t cumulative = 0;
+            for(std::size_t i=0; i<m_counts.size(); ++i)
+            {
+                cumulative += m_counts[i];
+                
+                if( cumulative >= rank )
+                {
+                    auto lower = bucket_lower(i, m_precision);
+                    auto middle = lower + (bucket_upper(i, m_precision) - lower) / 2;
+                    return std::min(std::max(middle, m_min), m_max);
+                }
+            }
+            
+            return m_max;
+        }
+        
+        // calls func(lower, upper, count) for all non-empty buckets in ascending order
+        template<class function_t>
+        void for_each_bucket(function_t func) const
+        {
+            for(std::size_t i=0; i<m_counts.size(); ++i)
+                if( m_counts[i] )
+                    func(bucket_lower(i, m_precision), bucket_upper(i, m_precision), m_counts[i]);
+        }
+        
+        static std::size_t bucket_count(unsigned precision_bits) { return (std::size_t(1) << precision_bits) * (65 - precision_bits); }
+        
+        // values below 2^(precision_bits+1) have their own bucket, above the sub-bucket is 
+        // given by the precision_bits+1 leading bits of the value
+        static std::size_t bucket_index(std::uint64_t value, unsigned precision_bits)
+        {
+            const std::uint64_t sub_buckets = std::uint64_t(1) << precision_bits;
+            
+            if( value < 2 * sub_buckets ) 
+                return static_cast<std::size_t>(value);
+            
+            const unsigned shift = _log2(value) - precision_bits;
+            return static_cast<std::size_t>(sub_buckets * shift + (value >> shift));
+        }
+        
+        static std::uint64_t bucket_lower(std::size_t index, unsigned precision_bits)
+        {
+            const std::uint64_t sub_buckets = std::uint64_t(1) << precision_bits;
+            
+            if( index < 2 * sub_buckets ) 
+                return index;
+            
+            const unsigned shift = static_cast<unsigned>(index / sub_buckets - 1);
+            return (index - sub_buckets * shift) << shift;
+        }
+        
+        static std::uint64_t bucket_upper(std::size_t index, unsigned precision_bits)
+        {
+            const std::uint64_t sub_buckets = std::uint64_t(1) << precision_bits;
+            
+            if( index < 2 * sub_buckets ) 
+                return index;
+            
+            const unsigned shift = static_cast<unsigned>(index / sub_buckets - 1);
+            return bucket_lower(index, precision_bits) + ((std::uint64_t(1) << shift) - 1);
+        }
+        
+    private:
+        friend class concurrent_histogram;
+        
+        static unsigned _log2(std::uint64_t value)
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            return 63 - __builtin_clzll(value);
+#else
+            unsigned result = 0;
+            while( value >>= 1 ) ++result;
+            return result;
+#endif
+        }
+        
+        unsigned m_precision;
+        std::vector<std::uint64_t> m_counts;
+        std::uint64_t m_count = 0;
+        double m_sum = 0.0;
+        std::uint64_t m_min = std::numeric_limits<std::uint64_t>::max();
+        std::uint64_t m_max = 0;
+    };
+    
+    // log_histogram for recording from many threads: every thread records into its own shard 
+    // with relaxed atomics, so recording takes no lock and threads do not share cache lines.
+    // snapshot() merges all shards and may be called while other threads are recording.
+    class concurrent_histogram
+    {
+    public:
+        explicit concurrent_histogram(unsigned precision_bits = 7) : m_precision(log_histogram(precision_bits).precision_bits())
+        {
+            for(auto &s : m_shards) s.store(nullptr, std::memory_order_relaxed);
+        }
+        
+        ~concurrent_histogram()
+        {
+            for(auto &s : m_shards) delete s.load(std::memory_order_relaxed);
+        }
+        
+        concurrent_histogram(const concurrent_histogram &) = delete;
+        concurrent_histogram &operator=(const concurrent_histogram &) = delete;
+        
+        void record(std::uint64_t value, std::uint64_t count = 1)
+        {
+            auto &s = local_shard();
+            
+            s.counts[log_histogram::bucket_index(value, m_precision)].fetch_add(count, std::memory_order_relaxed);
+            s.count.fetch_add(count, std::memory_order_relaxed);
+            s.sum.fetch_add(value * count, std::memory_order_relaxed);
+            
+            auto min = s.min.load(std::memory_order_relaxed);
+            while( value < min && !s.min.compare_exchange_weak(min, value, std::memory_order_relaxed) ) { }
+            
+            auto max = s.max.load(std::memory_order_relaxed);
+            while( value > max && !s.max.compare_exchange_weak(max, value, std::memory_order_relaxed) ) { }
+        }
+        
+        template<class rep_t, class period_t>
+        void record(std::chrono::duration<rep_t, period_t> duration, std::uint64_t count = 1)
+        {
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+            record(static_cast<std::uint64_t>(ns > 0 ? ns : 0), count);
+        }
+        
+        log_histogram snapshot() const
+        {
+            log_histogram result(m_precision);
+            
+            for(const auto &slot : m_shards)
+            {
+                const shard *s = slot.load(std::memory_order_acquire);
+                if( !s ) continue;
+                
+                for(std::size_t i=0; i<result.m_counts.size(); ++i)
+                    result.m_counts[i] += s->counts[i].load(std::memory_order_relaxed);
+                
+                result.m_count += s->count.load(std::memory_order_relaxed);
+                result.m_sum += static_cast<double>(s->sum.load(std::memory_order_relaxed));
+                result.m_min = std::min(result.m_min, s->min.load(std::memory_order_relaxed));
+                result.m_max = std::max(result.m_max, s->max.load(std::memory_order_relaxed));
+            }
+            
+            return result;
+        }
+        
+    private:
+        static constexpr std::size_t shard_count = 64;
+        
+        struct shard
+        {
+            explicit shard(std::size_t buckets) : counts(new std::atomic<std::uint64_t>[buckets]())
+            {
+                for(std::size_t i=0; i<buckets; ++i) counts[i].store(0, std::memory_order_relaxed);
+            }
+            
+            std::unique_ptr<std::atomic<std::uint64_t>[]> counts;
+            std::atomic<std::uint64_t> count{0};
+            std::atomic<std::uint64_t> sum{0};
+            std::atomic<std::uint64_t> min{std::numeric_limits<std::uint64_t>::max()};
+            std::atomic<std::uint64_t> max{0};
+        };
+        
+        shard &local_shard()
+        {
+            // with more than 'shard_count' threads some share a shard (still correct, only slower)
+            auto &slot = m_shards[_thread_index() % shard_count];
+            shard *s = slot.load(std::memory_order_acquire);
+            
+            if( !s )
+            {
+                shard *created = new shard(log_histogram::bucket_count(m_precision));
+                
+                if( slot.compare_exchange_strong(s, created, std::memory_order_acq_rel) )
+                    s = created;
+                else
+                    delete created;
+            }
+            
+            return *s;
+        }
+        
+        unsigned m_precision;
+        std::atomic<shard *> m_shards[shard_count];
+    };
+    
+    // Merging t-digest (Dunning & Ertl) for real values: a quantile sketch with bounded memory 
+    // (about 'compression' centroids plus a buffer of 4 * compression values), which is most 
+    // accurate at the tails. Values are buffered and merged into the centroids when the buffer 
+    // is full or a quantile is requested, digests of different threads can be merged.
+    template<typename T = double>
+    class tdigest
+    {
+        static_assert( std::is_arithmetic<T>::value, "tdigest requires an arithmetic type");
+        
+    public:
+        explicit tdigest(double compression = 100.0) : 
+            m_compression(std::max(compression, 10.0)), m_buffer_capacity(static_cast<std::size_t>(4 * m_compression))
+        {
+            m_buffer.reserve(m_buffer_capacity);
+        }
+        
+        void push(T x)
+        {
+            m_buffer.push_back(centroid{ static_cast<double>(x), 1.0 });
+            m_count += 1;
+            m_min = std::min(m_min, static_cast<double>(x));
+            m_max = std::max(m_max, static_cast<double>(x));
+            
+            if( m_buffer.size() >= m_buffer_capacity ) compress();
+        }
+        
+        template<class iterator_t>
+        void push(iterator_t begin, const iterator_t end)
+        {
+            for(; begin != end; ++begin) push(*begin);
+        }
+        
+        void merge(const tdigest &other)
+        {
+            other.compress();
+            
+            for(const auto &c : other.m_centroids)
+            {
+                m_buffer.push_back(c);
+                if( m_buffer.size() >= m_buffer_capacity ) compress();
+            }
+            
+            m_count += other.m_count;
+            m_min = std::min(m_min, other.m_min);
+            m_max = std::max(m_max, other.m_max);
+        }
+        
+        tdigest &operator+=(const tdigest &other) { merge(other); return *this; }
+        
+        std::uint64_t count() const { return m_count; }
+        T min() const { return m_count ? static_cast<T>(m_min) : T(0); }
+        T max() const { return m_count ? static_cast<T>(m_max) : T(0); }
+        std::size_t centroid_count() const { compress(); return m_centroids.size(); }
+        
+        double mean() const
+        {
+            compress();
+            
+            double sum = 0.0;
+            for(const auto &c : m_centroids) sum += c.mean * c.weight;
+            return m_count ? sum / m_count : 0.0;
+        }
+        
+        // q in [0,1], interpolated linearly between the centroids (and min/max at the ends)
+        T quantile(double q) const
+        {
+            compress();
+            
+            if( m_centroids.empty() ) return T(0);
+            if( q <= 0.0 ) return min();
+            if( q >= 1.0 ) return max();
+            
+            const double index = q * m_count;
+            const auto &first = m_centroids.front();
+            const auto &last = m_centroids.back();
+            
+            if( index < first.weight / 2 )
+                return static_cast<T>(m_min + (first.mean - m_min) * index / (first.weight / 2));
+            
+            double cumulative = first.weight / 2;
+            
+            for(std::size_t i=0; i+1<m_centroids.size(); ++i)
+            {
+                const double width = (m_centroids[i].weight + m_centroids[i+1].weight) / 2;
+                
+                if( index < cumulative + width )
+                {
+                    const double t = (index - cumulative) / width;
+                    return static_cast<T>(m_centroids[i].mean + t * (m_centroids[i+1].mean - m_centroids[i].mean));
+                }
+                
+                cumulative += width;
+            }
+            
+            const double t = std::min((index - cumulative) / (last.weight / 2), 1.0);
+            return static_cast<T>(last.mean + t * (m_max - last.mean));
+        }
+        
+    private:
+        struct centroid
+        {
+            double mean;
+            double weight;
+        };
+        
+        // scale function k1: k(q) = compression / (2 pi) * asin(2q - 1), a centroid may span 
+        // at most one unit of k, so centroids near q = 0 and q = 1 stay small
+        double next_limit(double q) const
+        {
+            const double pi = 3.14159265358979323846;
+            const double k = m_compression / (2 * pi) * std::asin(2 * q - 1) + 1;
+            return (std::sin(std::min(k * 2 * pi / m_compression, pi / 2)) + 1) / 2;
+        }
+        
+        void compress() const
+        {
+            if( m_buffer.empty() ) return;
+            
+            m_buffer.insert(m_buffer.end(), m_centroids.begin(), m_centroids.end());
+            std::sort(m_buffer.begin(), m_buffer.end(), [](const centroid &a, const centroid &b){ return a.mean < b.mean; });
+            
+            double total = 0.0;
+            for(const auto &c : m_buffer) total += c.weight;
+            
+            m_centroids.clear();
+            
+            centroid current = m_buffer.front();
+            double weight_before = 0.0;
+            double limit = next_limit(0.0);
+            
+            for(std::size_t i=1; i<m_buffer.size(); ++i)
+            {
+                const auto &next = m_buffer[i];
+                
+                if( (weight_before + current.weight + next.weight) / total <= limit )
+                {
+                    current.weight += next.weight;
+                    current.mean += (next.mean - current.mean) * next.weight / current.weight;
+                }
+                else
+                {
+                    weight_before += current.weight;
+                    m_centroids.push_back(current);
+                    limit = next_limit(weight_before / total);
+                    current = next;
+                }
+            }
+            
+            m_centroids.push_back(current);
+            m_buffer.clear();
+        }
+        
+        double m_compression;
+        std::size_t m_buffer_capacity;
+        mutable std::vector<centroid> m_centroids;
+        mutable std::vector<centroid> m_buffer;
+        std::uint64_t m_count = 0;
+        double m_min = std::numeric_limits<double>::max();
+        double m_max = std::numeric_limits<double>::lowest();
+    };
+    
+    // tdigest for pushing from many threads: every thread pushes into its own shard. A t-digest 
+    // cannot be updated with atomics, so each shard has a lock, which is only contended by 
+    // snapshot() (and by threads beyond the 64th, which share shards). snapshot() merges all 
+    // shards into one tdigest and may be called while other threads are pushing.
+    template<typename T = double>
+    class concurrent_tdigest
+    {
+    public:
+        explicit concurrent_tdigest(double compression = 100.0) : m_compression(compression)
+        {
+            for(auto &s : m_shards) s.store(nullptr, std::memory_order_relaxed);
+        }
+        
+        ~concurrent_tdigest()
+        {
+            for(auto &s : m_shards) delete s.load(std::memory_order_relaxed);
+        }
+        
+        concurrent_tdigest(const concurrent_tdigest &) = delete;
+        concurrent_tdigest &operator=(const concurrent_tdigest &) = delete;
+        
+        void push(T x)
+        {
+            auto &s = local_shard();
+            std::lock_guard<std::mutex> lock(s.mutex);
+            s.digest.push(x);
+        }
+        
+        template<class iterator_t>
+        void push(iterator_t begin, const iterator_t end)
+        {
+            auto &s = local_shard();
+            std::lock_guard<std::mutex> lock(s.mutex);
+            s.digest.push(begin, end);
+        }
+        
+        tdigest<T> snapshot() const
+        {
+            tdigest<T> result(m_compression);
+            
+            for(const auto &slot : m_shards)
+            {
+                shard *s = slot.load(std::memory_order_acquire);
+                if( !s ) continue;
+                
+                std::lock_guard<std::mutex> lock(s->mutex);
+                result.merge(s->digest);
+            }
+            
+            return result;
+        }
+        
+    private:
+        static constexpr std::size_t shard_count = 64;
+        
+        struct shard
+        {
+            explicit shard(double compression) : digest(compression) { }
+            
+            std::mutex mutex;
+            tdigest<T> digest;
+        };
+        
+        shard &local_shard()
+        {
+            auto &slot = m_shards[_thread_index() % shard_count];
+            shard *s = slot.load(std::memory_order_acquire);
+            
+            if( !s )
+            {
+                shard *created = new shard(m_compression);
+                
+                if( slot.compare_exchange_strong(s, created, std::memory_order_acq_rel) )
+                    s = created;
+                else
+                    delete created;
+            }
+            
+            return *s;
+        }
+        
+        double m_compression;
+        std::atomic<shard *> m_shards[shard_count];
+    };
+    
+    template<class sketch_t>
+    inline table _quantile_table(const sketch_t &sketch, const std::string &unit)
+    {
+        table t;
+        auto &creator = t.create();
+        
+        const std::string suffix = unit.empty() ? "" : " [" + unit + "]";
+        
+        creator("count", "min" + suffix, "mean" + suffix, "p50" + suffix, "p90" + suffix, 
+                "p99" + suffix, "p99.9" + suffix, "max" + suffix)(horizontal_line('-'));
+        creator(sketch.count(), sketch.min(), sketch.mean(), sketch.quantile(0.5), sketch.quantile(0.9),
+                sketch.quantile(0.99), sketch.quantile(0.999), sketch.max());
+        
+        return t;
+    }
+    
+    // count, mean, min, max and p50/p90/p99/p99.9 in one row, 'unit' is appended to the headers
+    inline table to_table(const log_histogram &histogram, const std::string &unit = "ns") { return _quantile_table(histogram, unit); }
+    
+    template<typename T>
+    inline table to_table(const tdigest<T> &digest, const std::string &unit = "") { return _quantile_table(digest, unit); }
+    
+    template<class histogram_t, class function_object_t>
+    inline double _measure_iterations(function_object_t &func, std::size_t iterations, histogram_t &histogram)
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto last = start;
+        
+        for(std::size_t i=0; i<iterations; ++i)
+        {
+            func();
+            
+            auto now = std::chrono::steady_clock::now();
+            histogram.record(now - last);
+            last = now;
+        }
+        
+        std::chrono::duration<double> elapsed = last - start;
+        return elapsed.count() / iterations;
+    }
+    
+    // Same as mc::measure_time, additionally records the duration of every single iteration 
+    // in nanoseconds (each iteration is timed, so very short functions include the clock overhead)
+    template<class function_object_t>
+    inline double measure_time(function_object_t func, std::size_t iterations, log_histogram &histogram)
+    {
+        return _measure_iterations(func, iterations, histogram);
+    }
+    
+    template<class function_object_t>
+    inline double measure_time(function_object_t func, std::size_t iterations, concurrent_histogram &histogram)
+    {
+        return _measure_iterations(func, iterations, histogram);
     }
 }
 
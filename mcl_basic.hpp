@@ -12,101 +12,568 @@
 #include <functional>
 #include <string>
 #include <sstream>
+#include <algorithm>
 #include <fstream>
 #include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <exception>
+#include <cctype>
+#include <cstdio>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <array>
+#include <limits>
+#include <tuple>
+#include <utility>
+
+#if __cplusplus >= 201402L
+#define MCL_CONSTEXPR14 constexpr
+#else
+#define MCL_CONSTEXPR14
+#endif
+
+#if __cplusplus >= 201703L
+#include <charconv>
+#include <string_view>
+#endif
+
+// polymorphic allocators for the allocator aware overloads, see mcl_memory.hpp
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define MCL_HAS_PMR
+#endif
+#endif
     
 
 namespace mc
 {
-    // Container export functions
-    // ==========================
-
-    template<class container_t>
-    inline std::string stringify_container(const container_t &c)
+    // Container formatting
+    // ====================
+    
+    // Values are appended to a caller supplied buffer (std::string, std::pmr::string or any type 
+    // with append(const char *, size) and push_back), so a reused buffer does not allocate. Numbers 
+    // are written with std::to_chars if available, types which are neither numbers, strings, 
+    // ranges nor pairs/tuples go through a reused stream. This is the only formatter of mcl: 
+    // tables, tsv files and exports all use it, so numbers look the same everywhere.
+    //
+    //     ranges               [ 1 2 3 ]           nested: [ [ 1 2 ] [ 3 ] ]
+    //     maps                 { a: 1 b: 2 }
+    //     pairs, tuples, zip   (1, a)              [ (1, a) (2, b) ]
+    //     truncated            [ 1 2 3 … 998 999 ]
+    struct format_options
+    {
+        int precision = 6;                  // significant digits (like std::ostream), -1 = shortest exact representation
+        bool fixed = false;                 // precision counts the digits after the decimal point (like std::fixed)
+        std::size_t max_items = 0;          // larger ranges show only their first and last elements, 0 = all
+        const char *ellipsis = "…";
+        
+        format_options &set_precision(int digits) { precision = digits; return *this; }
+        format_options &set_fixed(bool enable = true) { fixed = enable; return *this; }
+        format_options &set_max_items(std::size_t items) { max_items = items; return *this; }
+        format_options &set_ellipsis(const char *text) { ellipsis = text; return *this; }
+    };
+    
+    // numbers in the shortest representation which reads back to the same value, e.g. for files
+    inline format_options _exact_format() { return format_options().set_precision(-1); }
+    
+    template<class ... types_t>
+    struct _make_void { typedef void type; };
+    
+    template<class T, class = void>
+    struct _is_range : std::false_type { };
+    
+    template<class T>
+    struct _is_range<T, typename _make_void<decltype(std::begin(std::declval<const T &>())), decltype(std::end(std::declval<const T &>()))>::type> : std::true_type { };
+    
+    template<class T, class = void>
+    struct _is_map : std::false_type { };
+    
+    template<class T>
+    struct _is_map<T, typename _make_void<typename T::key_type, typename T::mapped_type>::type> : std::true_type { };
+    
+    // pairs, tuples and everything else with std::tuple_size (e.g. zipped elements)
+    template<class T, class = void>
+    struct _is_tuple_like : std::false_type { };
+    
+    template<class T>
+    struct _is_tuple_like<T, typename _make_void<decltype(std::tuple_size<T>::value)>::type> : std::true_type { };
+    
+    template<class T>
+    struct _is_string : std::integral_constant<bool, std::is_same<T, char *>::value || std::is_same<T, const char *>::value ||
+        (std::is_array<T>::value && std::is_same<typename std::remove_cv<typename std::remove_extent<T>::type>::type, char>::value)> { };
+    
+    template<class traits_t, class allocator_t>
+    struct _is_string<std::basic_string<char, traits_t, allocator_t>> : std::true_type { };
+    
+#if __cplusplus >= 201703L
+    template<class traits_t>
+    struct _is_string<std::basic_string_view<char, traits_t>> : std::true_type { };
+#endif
+    
+    template<class T>
+    struct _is_character : std::integral_constant<bool, std::is_same<T, char>::value || 
+        std::is_same<T, signed char>::value || std::is_same<T, unsigned char>::value> { };
+    
+    // which overload of _format_value is used
+    template<class T>
+    using _format_kind = std::integral_constant<int, 
+        _is_string<T>::value ? 0 : 
+        std::is_same<T, bool>::value || _is_character<T>::value ? 1 :
+        std::is_integral<T>::value ? 2 : 
+        std::is_floating_point<T>::value ? 3 :
+        _is_range<T>::value ? 4 : 
+        _is_tuple_like<T>::value ? 5 : 6>;
+    
+    template<class buffer_t, class T>
+    inline void format_to(buffer_t &buffer, const T &value, const format_options &options = format_options());
+    
+    template<class buffer_t>
+    inline void _append_chars(buffer_t &buffer, const char *chars) { buffer.append(chars, std::char_traits<char>::length(chars)); }
+    
+    template<class buffer_t, class T>
+    inline void _format_value(buffer_t &buffer, const T &value, const format_options &, std::integral_constant<int, 0>)
+    {
+#if __cplusplus >= 201703L
+        std::string_view text(value);
+        buffer.append(text.data(), text.size());
+#else
+        const std::string &text = value;
+        buffer.append(text.data(), text.size());
+#endif
+    }
+    
+    // bool as 0/1 and characters as they are, like std::ostream
+    template<class buffer_t, class T>
+    inline void _format_value(buffer_t &buffer, const T &value, const format_options &, std::integral_constant<int, 1>)
+    {
+        buffer.push_back(std::is_same<T, bool>::value ? (value ? '1' : '0') : static_cast<char>(value));
+    }
+    
+    template<class buffer_t, class T>
+    inline void _format_value(buffer_t &buffer, const T &value, const format_options &, std::integral_constant<int, 2>)
+    {
+        char chars[32];
+#if defined(__cpp_lib_to_chars)
+        buffer.append(chars, static_cast<std::size_t>(std::to_chars(chars, chars + sizeof(chars), value).ptr - chars));
+#else
+        int size = std::is_signed<T>::value ? std::snprintf(chars, sizeof(chars), "%lld", static_cast<long long>(value)) : 
+                                              std::snprintf(chars, sizeof(chars), "%llu", static_cast<unsigned long long>(value));
+        buffer.append(chars, static_cast<std::size_t>(size));
+#endif
+    }
+    
+    template<class buffer_t, class T>
+    inline void _format_value(buffer_t &buffer, const T &value, const format_options &options, std::integral_constant<int, 3>)
+    {
+        // large fixed values do not fit into the buffer, they are written in scientific notation
+        char chars[128];
+        const int precision = options.precision == 0 && !options.fixed ? 1 : options.precision;
+#if defined(__cpp_lib_to_chars)
+        auto result = precision < 0 ? std::to_chars(chars, chars + sizeof(chars), value) :
+            std::to_chars(chars, chars + sizeof(chars), value, options.fixed ? std::chars_format::fixed : std::chars_format::general, precision);
+        
+        if( result.ec != std::errc() )
+            result = std::to_chars(chars, chars + sizeof(chars), value, std::chars_format::scientific, std::min(precision, 17));
+        
+        buffer.append(chars, static_cast<std::size_t>(result.ptr - chars));
+#else
+        const long double x = value;
+        int size = precision < 0 ? std::snprintf(chars, sizeof(chars), "%.*Lg", std::numeric_limits<T>::max_digits10, x) :
+            std::snprintf(chars, sizeof(chars), options.fixed ? "%.*Lf" : "%.*Lg", precision, x);
+        
+        if( size < 0 || size >= static_cast<int>(sizeof(chars)) )
+            size = std::snprintf(chars, sizeof(chars), "%.*Le", std::min(precision, 17), x);
+        
+        buffer.append(chars, static_cast<std::size_t>(size));
+#endif
+    }
+    
+    template<class buffer_t, class T>
+    inline void _format_entry(buffer_t &buffer, const T &value, const format_options &options, std::false_type /*is_map*/)
+    {
+        format_to(buffer, value, options);
+    }
+    
+    template<class buffer_t, class T>
+    inline void _format_entry(buffer_t &buffer, const T &entry, const format_options &options, std::true_type /*is_map*/)
     {
-        std::stringstream stream;
+        format_to(buffer, entry.first, options);
+        buffer.append(": ", 2);
+        format_to(buffer, entry.second, options);
+    }
+    
+    // ranges with more than max_items elements show the first (max_items + 1) / 2 and the last max_items / 2
+    template<class buffer_t, class T>
+    inline void _format_value(buffer_t &buffer, const T &range, const format_options &options, std::integral_constant<int, 4>)
+    {
+        const bool is_map = _is_map<T>::value;
+        buffer.append(is_map ? "{ " : "[ ", 2);
+        
+        auto it = std::begin(range);
+        const auto end = std::end(range);
+        std::size_t skip_at = static_cast<std::size_t>(-1), skipped = 0;
+        
+        if( options.max_items > 0 )
+        {
+            const auto size = static_cast<std::size_t>(std::distance(it, end));
+            
+            if( size > options.max_items )
+            {
+                skip_at = (options.max_items + 1) / 2;
+                skipped = size - options.max_items;
+            }
+        }
         
-        stream << "[ ";
-        for(auto it = c.begin(); it != c.end(); it++)
+        for(std::size_t i = 0; it != end; ++it, ++i)
         {
-            stream << *it << " ";
+            if( i == skip_at )
+            {
+                _append_chars(buffer, options.ellipsis);
+                buffer.push_back(' ');
+                std::advance(it, skipped);
+                if( it == end ) break;
+            }
+            
+            _format_entry(buffer, *it, options, std::integral_constant<bool, _is_map<T>::value>());
+            buffer.push_back(' ');
         }
-        stream << "]";
         
-        return stream.str();
+        buffer.push_back(is_map ? '}' : ']');
     }
-
+    
+    template<std::size_t index, std::size_t size>
+    struct _format_tuple
+    {
+        template<class buffer_t, class T>
+        static void apply(buffer_t &buffer, const T &tuple, const format_options &options)
+        {
+            if( index > 0 ) buffer.append(", ", 2);
+            
+            using std::get;
+            format_to(buffer, get<index>(tuple), options);
+            _format_tuple<index + 1, size>::apply(buffer, tuple, options);
+        }
+    };
+    
+    template<std::size_t size>
+    struct _format_tuple<size, size>
+    {
+        template<class buffer_t, class T>
+        static void apply(buffer_t &, const T &, const format_options &) { }
+    };
+    
+    template<class buffer_t, class T>
+    inline void _format_value(buffer_t &buffer, const T &tuple, const format_options &options, std::integral_constant<int, 5>)
+    {
+        buffer.push_back('(');
+        _format_tuple<0, std::tuple_size<T>::value>::apply(buffer, tuple, options);
+        buffer.push_back(')');
+    }
+    
+    template<class buffer_t, class T>
+    inline void _format_value(buffer_t &buffer, const T &value, const format_options &options, std::integral_constant<int, 6>)
+    {
+        thread_local std::ostringstream stream;
+        stream.str("");
+        stream.clear();
+        stream.precision(options.precision < 0 ? 17 : options.precision);
+        stream << value;
+        
+        const std::string text = stream.str();
+        buffer.append(text.data(), text.size());
+    }
+    
+    // appends the textual representation of value to buffer
+    template<class buffer_t, class T>
+    inline void format_to(buffer_t &buffer, const T &value, const format_options &options)
+    {
+        _format_value(buffer, value, options, _format_kind<T>());
+    }
+    
+    // Container export functions
+    // ==========================
+    
     template<class container_t>
-    inline void print_container(const container_t &c, std::string name = "")
+    inline std::string stringify_container(const container_t &c, const format_options &options = format_options())
     {
-        std::string name_str = name.empty() ? "" : name + " = ";
-        std::cout << name_str << stringify_container(c) << std::endl;
+        std::string result;
+        format_to(result, c, options);
+        return result;
     }
     
-    inline void export_containers(std::string filename, std::vector<std::string> headers) 
+#if defined(MCL_HAS_PMR)
+    // same as above, but the string is allocated from 'resource' (e.g. an mc::arena)
+    template<class container_t>
+    inline std::pmr::string stringify_container(const container_t &c, std::pmr::memory_resource *resource, 
+                                                const format_options &options = format_options())
     {
-        if( headers.size() != 0 )
-            throw std::runtime_error("number of headers must match number of containers");
+        std::pmr::string result(resource);
+        format_to(result, c, options);
+        return result;
     }
+#endif
+    
+    // formats into a reused buffer and writes it without flushing the stream
+    template<class container_t>
+    inline void print_container(const container_t &c, const std::string &name = "", const format_options &options = format_options(), 
+                                std::ostream &stream = std::cout)
+    {
+        thread_local std::string buffer;
+        buffer.clear();
+        
+        if( !name.empty() ) 
+        {
+            buffer += name;
+            buffer += " = ";
+        }
         
-    template<class container_t, class ... containers_t>
-    inline void export_containers(std::string filename, std::vector<std::string> headers, 
-                                  const container_t &container, const containers_t& ... remaining)
+        format_to(buffer, c, options);
+        buffer += '\n';
+        stream.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    }
+    
+    // Buffered delimiter separated writer
+    // ==================================
+    
+    // part of a larger string, e.g. one line of a file which was read at once
+    struct _char_range
+    {
+        const char *first;
+        const char *last;
+    };
+    
+    template<class buffer_t>
+    inline void format_to(buffer_t &buffer, const _char_range &value, const format_options & = format_options())
+    {
+        buffer.append(value.first, static_cast<std::size_t>(value.last - value.first));
+    }
+    
+    
+    class tsv_writer
     {
-        std::ifstream old_file(filename, std::ios::in);
-        std::stringstream file_buffer;
+    public:
+        enum mode_t { truncate, append };
         
-        // file is empty
-        if(old_file.peek() == std::ifstream::traits_type::eof() )
+        tsv_writer(const std::string &filename, char delimiter = '\t', mode_t mode = truncate, 
+                   std::size_t buffer_size = 1 << 20) :
+            m_delimiter(delimiter), m_buffer_size(buffer_size)
         {
-            // write first header and erase afterwards
-            file_buffer << headers.front() << '\n';
-            headers.erase(headers.begin());
-            
-            // write data of first container
-            for(auto &el : container)
+            // in append mode only the size of the existing file is queried, it is never read
+            if( mode == append )
             {
-                file_buffer << el << '\n';
+                std::ifstream old_file(filename, std::ios::in | std::ios::binary | std::ios::ate);
+                m_existing_bytes = old_file ? static_cast<std::size_t>(old_file.tellg()) : 0;
             }
+            
+            m_file.open(filename, std::ios::out | std::ios::binary | (mode == append ? std::ios::app : std::ios::trunc));
+            
+            if( !m_file )
+                throw std::runtime_error("could not open file '" + filename + "'");
+            
+            m_buffer.reserve(m_buffer_size + 256);
         }
-        else
+        
+        tsv_writer(const tsv_writer &) = delete;
+        tsv_writer &operator=(const tsv_writer &) = delete;
+        
+        ~tsv_writer() { write_buffer(); }
+        
+        // true if nothing has been written to the file yet (neither by this writer nor before)
+        bool empty() const { return m_existing_bytes == 0 && m_written_bytes == 0 && m_buffer.empty(); }
+        
+        char delimiter() const { return m_delimiter; }
+        
+        // Writes a single field, the delimiter is inserted automatically. Numbers are written 
+        // exactly (shortest representation which reads back to the same value).
+        template<class type_t>
+        void write_field(const type_t &value)
+        {
+            if( m_row_started ) m_buffer += m_delimiter;
+            format_to(m_buffer, value, m_format);
+            m_row_started = true;
+        }
+        
+        void end_row()
+        {
+            m_buffer += '\n';
+            m_row_started = false;
+            
+            if( m_buffer.size() >= m_buffer_size )
+                write_buffer();
+        }
+        
+        template<class ... types_t>
+        void write_row(const types_t& ... values)
+        {
+            using expander = int[];
+            (void)expander{ 0, (write_field(values), 0)... };
+            end_row();
+        }
+        
+        template<class container_t>
+        void write_header(const container_t &headers)
+        {
+            for(const auto &header : headers)
+                write_field(header);
+            end_row();
+        }
+        
+        // Writes the containers column by column, each row is written exactly once
+        template<class ... containers_t>
+        void write_columns(const containers_t& ... containers)
+        {
+            write_columns_impl(static_cast<const std::vector<std::string> *>(nullptr), containers...);
+        }
+        
+        // Same as above, but every row starts with the corresponding entry of 'prefixes'
+        template<class prefixes_t, class ... containers_t>
+        void write_prefixed_columns(const prefixes_t &prefixes, const containers_t& ... containers)
+        {
+            write_columns_impl(&prefixes, containers...);
+        }
+        
+        void flush()
+        {
+            write_buffer();
+            m_file.flush();
+        }
+        
+    private:
+        // no columns, nothing to write
+        template<class prefixes_t>
+        void write_columns_impl(const prefixes_t *) { }
+        
+        template<class prefixes_t, class container_t, class ... containers_t>
+        void write_columns_impl(const prefixes_t *prefixes, const container_t &container, const containers_t& ... containers)
         {
-            bool has_header = false;
-            auto it = container.begin();
+            const std::size_t sizes[] = { static_cast<std::size_t>(container.size()), static_cast<std::size_t>(containers.size())... };
             
-            for(char next = old_file.get(); !old_file.eof(); old_file.get(next))
+            for(auto size : sizes)
+                if( size != sizes[0] || (prefixes && prefixes->size() != size) )
+                    throw std::runtime_error("vector sizes do not match!");
+            
+            write_rows(prefixes, sizes[0], container.begin(), containers.begin()...);
+        }
+        
+        template<class prefixes_t, class ... iterators_t>
+        void write_rows(const prefixes_t *prefixes, std::size_t rows, iterators_t ... its)
+        {
+            using expander = int[];
+            
+            for(std::size_t i=0; i<rows; ++i)
             {
-                if( next == '\n' )
-                {
-                    if( !has_header )
-                    {
-                        if( !headers.empty() )
-                            file_buffer << '\t' << headers.front();
-                        else
-                            throw std::runtime_error("number of headers must match number of containers");
-                        
-                        headers.erase(headers.begin());
-                        has_header = true;
-                    }
-                    else
-                    {
-                        if( it != container.end() )
-                            file_buffer << '\t' << *it++;
-                        else
-                            throw std::runtime_error("vector sizes do not match!");
-                    }
-                }
-                file_buffer << next;
+                if( prefixes ) write_field((*prefixes)[i]);
+                
+                (void)expander{ 0, (write_field(*its), ++its, 0)... };
+                end_row();
             }
         }
         
+        void write_buffer()
+        {
+            m_file.write(m_buffer.data(), m_buffer.size());
+            m_written_bytes += m_buffer.size();
+            m_buffer.clear();
+        }
+        
+        std::ofstream m_file;
+        std::string m_buffer;
+        format_options m_format = _exact_format();
+        
+        char m_delimiter;
+        bool m_row_started = false;
+        std::size_t m_buffer_size;
+        std::size_t m_existing_bytes = 0;
+        std::size_t m_written_bytes = 0;
+    };
+    
+    // Container export
+    // ================
+    
+    inline void export_containers(tsv_writer &, const std::vector<std::string> &headers)
+    {
+        if( headers.size() != 0 )
+            throw std::runtime_error("number of headers must match number of containers");
+    }
+    
+    // Writes the header (only if the file is still empty) and all rows through the given writer
+    template<class ... containers_t>
+    inline void export_containers(tsv_writer &writer, const std::vector<std::string> &headers, 
+                                  const containers_t& ... containers)
+    {
+        if( headers.size() != sizeof...(containers_t) )
+            throw std::runtime_error("number of headers must match number of containers");
+        
+        if( writer.empty() )
+            writer.write_header(headers);
+        
+        writer.write_columns(containers...);
+    }
+    
+    inline void export_containers(const std::string &, const std::vector<std::string> &headers)
+    {
+        if( headers.size() != 0 )
+            throw std::runtime_error("number of headers must match number of containers");
+    }
+    
+    // Exports the containers as columns. If the file already contains data, the containers are 
+    // appended as new columns to the right of the existing ones.
+    template<class ... containers_t>
+    inline void export_containers(std::string filename, const std::vector<std::string> &headers, 
+                                  const containers_t& ... containers)
+    {
+        if( headers.size() != sizeof...(containers_t) )
+            throw std::runtime_error("number of headers must match number of containers");
+        
+        std::ifstream old_file(filename, std::ios::in | std::ios::binary);
+        
+        // file is empty
+        if( !old_file || old_file.peek() == std::ifstream::traits_type::eof() )
+        {
+            old_file.close();
+            
+            tsv_writer writer(filename);
+            export_containers(writer, headers, containers...);
+            return;
+        }
+        
+        // read the existing file at once, then rewrite every line extended by the new columns
+        old_file.seekg(0, std::ios::end);
+        std::string content(static_cast<std::size_t>(old_file.tellg()), '\0');
+        old_file.seekg(0, std::ios::beg);
+        old_file.read(&content[0], static_cast<std::streamsize>(content.size()));
         old_file.close();
         
-        std::ofstream new_file(filename, std::ios::out  | std::ios::trunc);
-        new_file << file_buffer.str();
-        new_file.close();
+        // lines as in std::getline, without a separate string per line
+        std::vector<_char_range> lines;
+        for(const char *first = content.data(), *end = first + content.size(); first != end; )
+        {
+            const char *last = std::find(first, end, '\n');
+            lines.push_back(_char_range{ first, last });
+            first = last == end ? end : last + 1;
+        }
+        
+        const _char_range old_header = lines.front();
+        lines.erase(lines.begin());
+        
+        std::size_t sizes[] = { static_cast<std::size_t>(containers.size())... };
+        for(auto size : sizes)
+            if( size != lines.size() )
+                throw std::runtime_error("vector sizes do not match!");
         
-        export_containers(filename, headers, remaining...);
+        tsv_writer writer(filename);
+        
+        writer.write_field(old_header);
+        writer.write_header(headers);
+        writer.write_prefixed_columns(lines, containers...);
     }
     
     inline void clear_file(std::string filename)
@@ -117,22 +584,409 @@ namespace mc
     // Generate ranges
     // ===============
     
-    template<typename T>
-    inline std::vector<T> range(T start, T step, int steps)
+    // Lazy random access sequences: element i is computed from i when it is accessed, so a 
+    // sequence of any (64 bit) length needs O(1) memory. iota and linspace are constexpr.
+    
+    template<class T>
+    struct _arithmetic_sequence
+    {
+        T start;
+        T step;
+        
+        constexpr T operator()(std::uint64_t i) const { return start + static_cast<T>(i) * step; }
+    };
+    
+    // the last element is exactly 'stop' (if it is part of the sequence)
+    template<class T>
+    struct _linear_sequence
+    {
+        T start;
+        T step;
+        T stop;
+        std::uint64_t stop_index;
+        
+        constexpr T operator()(std::uint64_t i) const { return i == stop_index ? stop : start + static_cast<T>(i) * step; }
+    };
+    
+    template<class T>
+    struct _log_sequence
+    {
+        _linear_sequence<T> exponents;
+        T base;
+        
+        T operator()(std::uint64_t i) const { return std::pow(base, exponents(i)); }
+    };
+    
+    template<class T, class generator_t>
+    class sequence_view
     {
-        std::vector<T> range;
+    public:
+        using value_type = T;
+        using size_type = std::uint64_t;
         
-        for(int i{0}; i != steps; ++i)
+        class iterator
         {
-            range.push_back(start + i * step);
-        }
+        public:
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type = T;
+            using reference = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            
+            constexpr iterator() : m_generator(), m_index(0) { }
+            constexpr iterator(generator_t generator, std::uint64_t index) : m_generator(generator), m_index(index) { }
+            
+            constexpr T operator*() const { return m_generator(m_index); }
+            constexpr T operator[](difference_type n) const { return m_generator(m_index + n); }
+            
+            MCL_CONSTEXPR14 iterator &operator++() { ++m_index; return *this; }
+            MCL_CONSTEXPR14 iterator &operator--() { --m_index; return *this; }
+            MCL_CONSTEXPR14 iterator operator++(int) { return iterator(m_generator, m_index++); }
+            MCL_CONSTEXPR14 iterator operator--(int) { return iterator(m_generator, m_index--); }
+            MCL_CONSTEXPR14 iterator &operator+=(difference_type n) { m_index += n; return *this; }
+            MCL_CONSTEXPR14 iterator &operator-=(difference_type n) { m_index -= n; return *this; }
+            
+            constexpr iterator operator+(difference_type n) const { return iterator(m_generator, m_index + n); }
+            constexpr iterator operator-(difference_type n) const { return iterator(m_generator, m_index - n); }
+            constexpr difference_type operator-(const iterator &other) const { return static_cast<difference_type>(m_index - other.m_index); }
+            friend constexpr iterator operator+(difference_type n, const iterator &it) { return it + n; }
+            
+            constexpr bool operator==(const iterator &other) const { return m_index == other.m_index; }
+            constexpr bool operator!=(const iterator &other) const { return m_index != other.m_index; }
+            constexpr bool operator<(const iterator &other) const { return m_index < other.m_index; }
+            constexpr bool operator>(const iterator &other) const { return m_index > other.m_index; }
+            constexpr bool operator<=(const iterator &other) const { return m_index <= other.m_index; }
+            constexpr bool operator>=(const iterator &other) const { return m_index >= other.m_index; }
+            
+        private:
+            generator_t m_generator;
+            std::uint64_t m_index;
+        };
+        
+        constexpr sequence_view(generator_t generator, std::uint64_t size) : m_generator(generator), m_size(size) { }
+        
+        constexpr iterator begin() const { return iterator(m_generator, 0); }
+        constexpr iterator end() const { return iterator(m_generator, m_size); }
+        
+        constexpr std::uint64_t size() const { return m_size; }
+        constexpr bool empty() const { return m_size == 0; }
+        
+        constexpr T operator[](std::uint64_t i) const { return m_generator(i); }
+        constexpr T front() const { return m_generator(0); }
+        constexpr T back() const { return m_generator(m_size - 1); }
+        
+        std::vector<T> to_vector() const { return std::vector<T>(begin(), end()); }
+        
+        // the sequence generators returned std::vector before they became lazy
+        operator std::vector<T>() const { return to_vector(); }
+        
+    private:
+        generator_t m_generator;
+        std::uint64_t m_size;
+    };
+    
+    template<class T>
+    constexpr std::uint64_t _sequence_size(T start, T stop, T step, std::true_type /*is_integral*/)
+    {
+        return (step > 0 ? start >= stop : start <= stop) ? 0 : 
+               static_cast<std::uint64_t>((stop - start) / step + ((stop - start) % step != 0 ? 1 : 0));
+    }
+    
+    template<class T>
+    constexpr std::uint64_t _sequence_size(T start, T stop, T step, std::false_type /*is_integral*/)
+    {
+        return !((stop - start) / step > 0) ? 0 : 
+               static_cast<std::uint64_t>((stop - start) / step) + (static_cast<T>(static_cast<std::uint64_t>((stop - start) / step)) < (stop - start) / step ? 1 : 0);
+    }
+    
+    template<class T>
+    using iota_view = sequence_view<T, _arithmetic_sequence<T>>;
+    
+    // start, start + step, ... up to 'stop' (excluded) like range() in python
+    template<class T, class U, class V, class value_t = typename std::common_type<T, U, V>::type>
+    constexpr iota_view<value_t> iota(T start, U stop, V step)
+    {
+        return iota_view<value_t>(_arithmetic_sequence<value_t>{ static_cast<value_t>(start), static_cast<value_t>(step) }, 
+            step == 0 ? 0 : _sequence_size<value_t>(start, stop, step, std::is_integral<value_t>()));
+    }
+    
+    template<class T, class U>
+    constexpr iota_view<typename std::common_type<T, U>::type> iota(T start, U stop) { return iota(start, stop, typename std::common_type<T, U>::type(1)); }
+    
+    template<class T>
+    constexpr iota_view<T> iota(T stop) { return iota(T(0), stop, T(1)); }
+    
+    // 'steps' elements start, start + step, ...
+    template<typename T>
+    constexpr iota_view<T> range(T start, T step, std::uint64_t steps)
+    {
+        return iota_view<T>(_arithmetic_sequence<T>{ start, step }, steps);
+    }
+    
+    template<class T, class U>
+    using _floating_t = typename std::conditional<std::is_floating_point<typename std::common_type<T, U>::type>::value,
+                                                  typename std::common_type<T, U>::type, double>::type;
+    
+    template<class T>
+    using linspace_view = sequence_view<T, _linear_sequence<T>>;
+    
+    template<class T>
+    constexpr _linear_sequence<T> _linear(T start, T stop, std::uint64_t num, bool endpoint)
+    {
+        return _linear_sequence<T>{ start, (stop - start) / static_cast<T>(endpoint ? (num > 1 ? num - 1 : 1) : (num > 0 ? num : 1)), 
+                                    stop, endpoint && num > 1 ? num - 1 : num };
+    }
+    
+    // 'num' evenly spaced values from 'start' to 'stop' (included if 'endpoint') like numpy.linspace
+    template<class T, class U, class value_t = _floating_t<T, U>>
+    constexpr linspace_view<value_t> linspace(T start, U stop, std::uint64_t num, bool endpoint = true)
+    {
+        return linspace_view<value_t>(_linear<value_t>(static_cast<value_t>(start), static_cast<value_t>(stop), num, endpoint), num);
+    }
+    
+    template<class T>
+    using logspace_view = sequence_view<T, _log_sequence<T>>;
+    
+    // base^x for 'num' evenly spaced x from 'start' to 'stop' like numpy.logspace (not constexpr, std::pow)
+    template<class T, class U, class value_t = _floating_t<T, U>>
+    inline logspace_view<value_t> logspace(T start, U stop, std::uint64_t num, bool endpoint = true, value_t base = 10)
+    {
+        return logspace_view<value_t>(_log_sequence<value_t>{ _linear<value_t>(static_cast<value_t>(start), static_cast<value_t>(stop), num, endpoint), base }, num);
+    }
+    
+#if __cplusplus >= 201703L
+    // Compile time lookup tables, e.g. constexpr auto table = mc::to_array<64>(mc::linspace(0, 1, 64), f)
+    template<std::size_t N, class view_t, class function_t>
+    constexpr auto to_array(const view_t &view, function_t func)
+    {
+        std::array<decltype(func(view[0])), N> result{};
+        
+        for(std::size_t i=0; i<N && i<view.size(); ++i)
+            result[i] = func(view[i]);
         
-        return range;
+        return result;
+    }
+    
+    template<std::size_t N, class view_t>
+    constexpr auto to_array(const view_t &view)
+    {
+        return to_array<N>(view, [](auto value){ return value; });
     }
+#endif
     
     // Templated string conversion functions
     // =====================================
     
+#if __cplusplus >= 201703L
+    // All conversions work on std::string_view and std::from_chars, so no allocation is
+    // necessary. Supported are all arithmetic types, enums (via their underlying type), 
+    // std::chrono::duration (with optional unit suffix, e.g. "1.5s" or "20ms"), std::string
+    // and std::string_view. Surrounding whitespace and a leading '+' are ignored.
+    
+    template<typename T>
+    struct conversion_result
+    {
+        T value{};
+        std::errc error{};
+        std::size_t position = 0;   // position of the first character which could not be converted
+        
+        explicit operator bool() const { return error == std::errc(); }
+    };
+    
+    template<typename T> struct _is_duration : std::false_type { };
+    template<typename rep_t, typename period_t> struct _is_duration<std::chrono::duration<rep_t, period_t>> : std::true_type { };
+    
+    template<typename T> struct _dependent_false : std::false_type { };
+    
+    template<typename T>
+    inline std::from_chars_result _from_chars(const char *first, const char *last, T &value)
+    {
+        if constexpr ( std::is_same<T, bool>::value )
+        {
+            std::string_view str(first, last - first);
+            
+            for(auto word : { "true", "True", "TRUE" })
+                if( str.substr(0, std::char_traits<char>::length(word)) == word )
+                    return { first + std::char_traits<char>::length(word), (value = true, std::errc()) };
+            
+            for(auto word : { "false", "False", "FALSE" })
+                if( str.substr(0, std::char_traits<char>::length(word)) == word )
+                    return { first + std::char_traits<char>::length(word), (value = false, std::errc()) };
+            
+            long long number = 0;
+            auto result = _from_chars(first, last, number);
+            value = number != 0;
+            return result;
+        }
+        else if constexpr ( std::is_same<T, char>::value )
+        {
+            if( first == last ) return { first, std::errc::invalid_argument };
+            value = *first;
+            return { first + 1, std::errc() };
+        }
+        else if constexpr ( std::is_enum<T>::value )
+        {
+            typename std::underlying_type<T>::type number{};
+            auto result = _from_chars(first, last, number);
+            value = static_cast<T>(number);
+            return result;
+        }
+        else if constexpr ( _is_duration<T>::value )
+        {
+            using rep_t = typename T::rep;
+            
+            // integer representations are parsed exactly, unless the number has a fraction
+            std::from_chars_result result;
+            double number = 0;
+            
+            if constexpr ( std::is_integral<rep_t>::value )
+            {
+                rep_t integer = 0;
+                result = _from_chars(first, last, integer);
+                
+                if( result.ec == std::errc() && (result.ptr == last || std::string_view(".eE").find(*result.ptr) == std::string_view::npos) )
+                {
+                    number = static_cast<double>(integer);
+                    value = T(integer);
+                }
+                else
+                    result = _from_chars(first, last, number);
+            }
+            else
+                result = _from_chars(first, last, number);
+            
+            if( result.ec != std::errc() )
+                return result;
+            
+            std::string_view unit(result.ptr, last - result.ptr);
+            
+            auto cast = [&](auto duration)
+            {
+                if constexpr ( std::is_integral<rep_t>::value )
+                    value = std::chrono::round<T>(duration);
+                else
+                    value = std::chrono::duration_cast<T>(duration);
+                return std::from_chars_result{ last, std::errc() };
+            };
+            
+            using namespace std::chrono;
+            
+            if( unit.empty() )
+                return std::is_integral<rep_t>::value && value.count() == number ? result : cast(duration<double, typename T::period>(number));
+            else if( unit == "ns" )  return cast(duration<double, std::nano>(number));
+            else if( unit == "us" )  return cast(duration<double, std::micro>(number));
+            else if( unit == "ms" )  return cast(duration<double, std::milli>(number));
+            else if( unit == "s" )   return cast(duration<double>(number));
+            else if( unit == "min" ) return cast(duration<double, std::ratio<60>>(number));
+            else if( unit == "h" )   return cast(duration<double, std::ratio<3600>>(number));
+            else
+                return { result.ptr, std::errc::invalid_argument };
+        }
+        else if constexpr ( std::is_arithmetic<T>::value )
+        {
+            // std::from_chars does not accept a leading '+'
+            if( first != last && *first == '+' && last - first > 1 && first[1] != '-' && first[1] != '+' )
+                ++first;
+            
+            return std::from_chars(first, last, value);
+        }
+        else
+            static_assert( _dependent_false<T>::value, "type not implemented for conversion");
+    }
+    
+    // Converts the whole string, reports the error and its position instead of throwing
+    template<typename T>
+    inline conversion_result<T> convert_checked(std::string_view str)
+    {
+        conversion_result<T> result;
+        
+        if constexpr ( std::is_same<T, std::string>::value || std::is_same<T, std::string_view>::value )
+        {
+            result.value = T(str);
+            result.position = str.size();
+            return result;
+        }
+        else
+        {
+            const char *begin = str.data();
+            const char *first = begin;
+            const char *last = begin + str.size();
+            
+            while( first != last && std::isspace(static_cast<unsigned char>(*first)) ) ++first;
+            while( last != first && std::isspace(static_cast<unsigned char>(*(last-1))) ) --last;
+            
+            auto parsed = _from_chars(first, last, result.value);
+            
+            result.error = parsed.ec;
+            result.position = static_cast<std::size_t>(parsed.ptr - begin);
+            
+            // trailing garbage
+            if( parsed.ec == std::errc() && parsed.ptr != last )
+                result.error = std::errc::invalid_argument;
+            
+            if( first == last )
+                result.error = std::errc::invalid_argument;
+            
+            return result;
+        }
+    }
+    
+    template<typename T>
+    inline T convert(std::string_view str)
+    {
+        auto result = convert_checked<T>(str);
+        
+        if( !result )
+            throw std::runtime_error("cannot convert '" + std::string(str) + "': " + 
+                                     (result.error == std::errc::result_out_of_range ? "out of range" : "invalid character") + 
+                                     " at position " + std::to_string(result.position));
+        
+        return std::move(result.value);
+    }
+    
+    // Converts all values of a delimiter separated line into 'buffer' and returns their number. 
+    // If the delimiter is a whitespace, repeated delimiters are treated as one. 
+    template<typename T>
+    inline std::size_t convert_many(std::string_view line, char delimiter, T *buffer, std::size_t capacity)
+    {
+        const bool skip_empty = std::isspace(static_cast<unsigned char>(delimiter));
+        std::size_t count = 0;
+        std::size_t begin = 0;
+        
+        while( begin <= line.size() )
+        {
+            auto end = std::min(line.find(delimiter, begin), line.size());
+            auto token = line.substr(begin, end - begin);
+            begin = end + 1;
+            
+            if( token.empty() && (skip_empty || (count == 0 && end == line.size())) )
+                continue;
+            
+            if( count == capacity )
+                throw std::runtime_error("line contains more than " + std::to_string(capacity) + " values");
+            
+            auto result = convert_checked<T>(token);
+            
+            if( !result )
+                throw std::runtime_error("cannot convert '" + std::string(token) + "' (value " + std::to_string(count) + 
+                                         ", position " + std::to_string(token.data() - line.data() + result.position) + ")");
+            
+            buffer[count++] = std::move(result.value);
+        }
+        
+        return count;
+    }
+    
+    // Same as above, 'values' is cleared but its capacity is reused
+    template<typename T>
+    inline std::size_t convert_many(std::string_view line, char delimiter, std::vector<T> &values)
+    {
+        values.resize(std::count(line.begin(), line.end(), delimiter) + 1);
+        values.resize(convert_many(line, delimiter, values.data(), values.size()));
+        
+        return values.size();
+    }
+#else
     template<typename T> inline T convert(const std::string &str){ static_assert("type not implemented for conversion"); }
     template<> inline float convert<float>(const std::string &str) { return static_cast<float>(std::atof(str.data())); }
     template<> inline double convert<double>(const std::string &str) { return std::atof(str.data()); }
@@ -147,6 +1001,137 @@ namespace mc
         else
             return static_cast<bool>(std::atoi(str.data()));
     }
+#endif
+    
+    // Parallel execution helper
+    // =========================
+    
+    inline std::size_t _default_thread_count()
+    {
+        auto threads = std::thread::hardware_concurrency();
+        return threads == 0 ? 1 : threads;
+    }
+    
+    // Execution policies, e.g. mc::average(mc::par, data) or mc::average(mc::par(8), data)
+    struct sequential_policy { };
+    
+    struct parallel_policy
+    {
+        std::size_t threads = 0;                // 0 = all cores
+        std::size_t threshold = 1 << 16;        // minimum number of elements for parallel execution
+        std::size_t block_size = 1 << 15;       // elements per block, 0 = automatic
+        
+        parallel_policy operator()(std::size_t thread_count) const
+        {
+            parallel_policy policy = *this;
+            policy.threads = thread_count;
+            return policy;
+        }
+    };
+    
+    constexpr sequential_policy seq{};
+    constexpr parallel_policy par{};
+    
+    // Runs helper() 'count' times on other threads and returns at once. Without a launcher every 
+    // _run_tasks starts its own threads, mcl_parallel.hpp installs the global thread_pool here.
+    typedef void (*_helper_launcher)(std::size_t count, const std::function<void()> &helper);
+    
+    inline _helper_launcher &_launch_helpers()
+    {
+        static _helper_launcher launcher = nullptr;
+        return launcher;
+    }
+    
+    // Calls func(i) for every i in [0, tasks) on up to 'threads' threads (0 = all cores), the
+    // calling thread takes part. Tasks are handed out dynamically, so uneven tasks are balanced.
+    // The first exception thrown by a task is rethrown after all threads have finished.
+    template<class function_t>
+    inline void _run_tasks(std::size_t tasks, std::size_t threads, function_t func)
+    {
+        if( threads == 0 ) threads = _default_thread_count();
+        threads = std::min(threads, tasks);
+        
+        std::atomic<std::size_t> next{0};
+        std::exception_ptr error;
+        std::mutex error_mutex;
+        
+        auto worker = [&]()
+        {
+            for(auto i = next++; i < tasks; i = next++)
+            {
+                try 
+                { 
+                    func(i); 
+                }
+                catch(...)
+                {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    if( !error ) error = std::current_exception();
+                    next = tasks;
+                }
+            }
+        };
+        
+        struct helper_state
+        {
+            std::mutex mutex;
+            std::condition_variable idle;
+            std::size_t active = 0;
+            bool closed = false;
+        };
+        
+        const _helper_launcher launcher = _launch_helpers();
+        
+        if( launcher && threads > 1 )
+        {
+            // helpers which start after the calling thread has finished all tasks (e.g. because the
+            // pool is busy) return without touching the worker, so only running helpers are awaited
+            auto state = std::make_shared<helper_state>();
+            auto *run = &worker;
+            
+            launcher(threads - 1, [state, run]()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    if( state->closed ) return;
+                    ++state->active;
+                }
+                
+                (*run)();
+                
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if( --state->active == 0 ) state->idle.notify_all();
+            });
+            
+            worker();
+            
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->closed = true;
+            state->idle.wait(lock, [&]{ return state->active == 0; });
+        }
+        else
+        {
+            std::vector<std::thread> pool;
+            for(std::size_t t=1; t<threads; ++t)
+                pool.emplace_back(worker);
+            
+            worker();
+            
+            for(auto &thread : pool)
+                thread.join();
+        }
+        
+        if( error )
+            std::rethrow_exception(error);
+    }
+    
+    // Threads are numbered in order of their first call, e.g. to pick a shard of a concurrent counter
+    inline std::size_t _thread_index()
+    {
+        static std::atomic<std::size_t> next_index{0};
+        thread_local std::size_t index = next_index.fetch_add(1, std::memory_order_relaxed);
+        return index;
+    }
     
     // Function time measuring
     // =======================
@@ -154,18 +1139,36 @@ namespace mc
     template< typename function_object_t>
     double measure_time(function_object_t func, std::size_t iterations = 1)
     {
-        auto start = std::chrono::high_resolution_clock::now();
+        auto start = std::chrono::steady_clock::now();
         
         for(std::size_t i=0; i<iterations; ++i)
             func();
         
-        auto end = std::chrono::high_resolution_clock::now();
+        auto end = std::chrono::steady_clock::now();
         
         std::chrono::duration<double> elapsed = end - start;
         
         return elapsed.count() / iterations;
     }
     
+    // Formats seconds with a suitable unit, e.g. 1.23e-5 -> "12.3us"
+    inline std::string _format_seconds(double seconds)
+    {
+        const char *units[] = { "s", "ms", "us", "ns" };
+        
+        std::size_t unit = 0;
+        while( unit < 3 && std::abs(seconds) < 1.0 && seconds != 0.0 )
+        {
+            seconds *= 1000.0;
+            ++unit;
+        }
+        
+        std::string result;
+        format_to(result, seconds, format_options().set_precision(3));
+        result += units[unit];
+        return result;
+    }
+    
 }
 
 #endif // AVERAGE_HPP
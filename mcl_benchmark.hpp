@@ -0,0 +1,600 @@
+#ifndef MCL_BENCHMARK_HPP
+#define MCL_BENCHMARK_HPP
+
+#if __cplusplus < 201703L
+#error "error: 'mcl_benchmark.hpp' requires C++17!"
+#endif
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+#include <memory>
+#include <cstdint>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "mcl_basic.hpp"
+#include "mcl_arithmetic.hpp"
+#include "mcl_tabular.hpp"
+
+namespace mc
+{
+    // Optimization barriers
+    // =====================
+    
+    // Forces the compiler to assume that 'value' is read, so the computation of it cannot be removed
+    template<typename T>
+    inline void do_not_optimize(const T &value)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "r,m"(value) : "memory");
+#else
+        static volatile const T *sink;
+        sink = &value;
+#endif
+    }
+    
+    template<typename T>
+    inline void do_not_optimize(T &value)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : "+r,m"(value) : : "memory");
+#else
+        static volatile T *sink;
+        sink = &value;
+#endif
+    }
+    
+    // Forces all pending memory writes to be treated as visible
+    inline void clobber_memory()
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : : "memory");
+#else
+        std::atomic_signal_fence(std::memory_order_acq_rel);
+#endif
+    }
+    
+    // Hardware performance counters
+    // =============================
+    
+    enum class perf_event : std::size_t
+    {
+        cycles, instructions, l1d_misses, llc_misses, branch_misses, context_switches
+    };
+    
+    constexpr std::size_t _perf_event_count = 6;
+    
+    inline const char *to_string(perf_event event)
+    {
+        static const char *names[] = { "cycles", "instructions", "L1d misses", "LLC misses", "branch misses", "context switches" };
+        return names[static_cast<std::size_t>(event)];
+    }
+    
+    struct perf_counter_values
+    {
+        double counts[_perf_event_count] = {};
+        bool available[_perf_event_count] = {};
+        
+        double operator[](perf_event event) const { return counts[static_cast<std::size_t>(event)]; }
+        bool has(perf_event event) const { return available[static_cast<std::size_t>(event)]; }
+        
+        // instructions per cycle, 0 if not available
+        double ipc() const
+        {
+            return has(perf_event::cycles) && has(perf_event::instructions) && (*this)[perf_event::cycles] > 0 ?
+                   (*this)[perf_event::instructions] / (*this)[perf_event::cycles] : 0.0;
+        }
+        
+        // e.g. counts per iteration
+        perf_counter_values operator/(double divisor) const
+        {
+            perf_counter_values result = *this;
+            for(auto &c : result.counts) c /= divisor;
+            return result;
+        }
+    };
+    
+    // Group of hardware counters opened with perf_event_open (Linux only). Counters which the 
+    // kernel or container does not allow are skipped, if none can be opened available() is 
+    // false and all reads return zero counts marked as not available. Counts are scaled if the
+    // kernel had to multiplex the counters.
+    class perf_counters
+    {
+    public:
+        perf_counters()
+        {
+#if defined(__linux__)
+            const std::uint32_t types[] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, 
+                                            PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE };
+            const std::uint64_t configs[] = 
+            { 
+                PERF_COUNT_HW_CPU_CYCLES, 
+                PERF_COUNT_HW_INSTRUCTIONS,
+                PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+                PERF_COUNT_HW_CACHE_MISSES,
+                PERF_COUNT_HW_BRANCH_MISSES,
+                PERF_COUNT_SW_CONTEXT_SWITCHES
+            };
+            
+            for(std::size_t i=0; i<_perf_event_count; ++i)
+            {
+                perf_event_attr attr;
+                std::memset(&attr, 0, sizeof(attr));
+                attr.size = sizeof(attr);
+                attr.type = types[i];
+                attr.config = configs[i];
+                attr.disabled = m_leader < 0 ? 1 : 0;
+                attr.exclude_kernel = types[i] == PERF_TYPE_SOFTWARE ? 0 : 1;    // context switches happen in the kernel
+                attr.exclude_hv = 1;
+                attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+                
+                int fd = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, m_leader, 0));
+                
+                if( fd < 0 )
+                {
+                    if( m_error.empty() ) m_error = std::string("perf_event_open: ") + std::strerror(errno);
+                    continue;
+                }
+                
+                if( m_leader < 0 ) m_leader = fd;
+                
+                m_fds.push_back(fd);
+                m_events.push_back(i);
+            }
+#else
+            m_error = "performance counters are only supported on Linux";
+#endif
+        }
+        
+        perf_counters(const perf_counters &) = delete;
+        perf_counters &operator=(const perf_counters &) = delete;
+        
+        ~perf_counters()
+        {
+#if defined(__linux__)
+            for(auto fd : m_fds) ::close(fd);
+#endif
+        }
+        
+        bool available() const { return !m_fds.empty(); }
+        
+        // reason why (some) counters could not be opened
+        const std::string &error() const { return m_error; }
+        
+        void start()
+        {
+#if defined(__linux__)
+            if( !available() ) return;
+            
+            ::ioctl(m_leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ::ioctl(m_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+        }
+        
+        // adds the counts since the last start() to the accumulated values
+        void stop()
+        {
+#if defined(__linux__)
+            if( !available() ) return;
+            
+            ::ioctl(m_leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+            
+            // layout: nr, time enabled, time running, values[nr]
+            std::uint64_t buffer[3 + _perf_event_count] = {};
+            
+            if( ::read(m_leader, buffer, sizeof(buffer)) <= 0 )
+                return;
+            
+            double scale = buffer[2] > 0 ? static_cast<double>(buffer[1]) / buffer[2] : 0.0;
+            
+            for(std::size_t i=0; i<buffer[0] && i<m_events.size(); ++i)
+                m_values.counts[m_events[i]] += buffer[3+i] * scale;
+#endif
+        }
+        
+        perf_counter_values read() const 
+        { 
+            auto values = m_values;
+            for(auto e : m_events) values.available[e] = true;
+            return values; 
+        }
+        
+        void reset() { m_values = perf_counter_values(); }
+        
+    private:
+        std::vector<int> m_fds;
+        std::vector<std::size_t> m_events;
+        int m_leader = -1;
+        std::string m_error;
+        
+        perf_counter_values m_values;
+    };
+    
+    // Counts the events of the enclosing scope
+    class scoped_counters
+    {
+    public:
+        explicit scoped_counters(perf_counters &counters) : m_counters(counters) { m_counters.start(); }
+        ~scoped_counters() { m_counters.stop(); }
+        
+    private:
+        perf_counters &m_counters;
+    };
+    
+    // Same as mc::measure_time, additionally accumulates the counters over all iterations
+    template<typename function_object_t>
+    inline double measure_time(function_object_t func, std::size_t iterations, perf_counters &counters)
+    {
+        double time;
+        {
+            scoped_counters scope(counters);
+            time = measure_time(func, iterations);
+        }
+        return time;
+    }
+    
+    inline table to_table(const perf_counter_values &values, std::size_t iterations = 1)
+    {
+        table t;
+        auto &creator = t.create();
+        
+        creator("event", "total", "per iteration")(horizontal_line('-'));
+        
+        for(std::size_t i=0; i<_perf_event_count; ++i)
+        {
+            auto event = static_cast<perf_event>(i);
+            
+            if( values.has(event) )
+                creator(to_string(event), static_cast<std::uint64_t>(values[event]), values[event] / iterations);
+            else
+                creator(to_string(event), "n/a", "n/a");
+        }
+        
+        creator("IPC", values.ipc(), "");
+        return t;
+    }
+    
+    // Benchmark results
+    // =================
+    
+    // Linear interpolated quantile of sorted data, q in [0,1]
+    inline double _sorted_quantile(const std::vector<double> &sorted, double q)
+    {
+        if( sorted.empty() ) return 0.0;
+        
+        double position = q * (sorted.size() - 1);
+        auto lower = static_cast<std::size_t>(position);
+        auto upper = std::min(lower + 1, sorted.size() - 1);
+        
+        return sorted[lower] + (position - lower) * (sorted[upper] - sorted[lower]);
+    }
+    
+    struct benchmark_result
+    {
+        std::string name;
+        std::size_t parameter = 0;
+        bool has_parameter = false;
+        
+        std::size_t iterations = 0;     // iterations per sample (batch size)
+        std::vector<double> samples;    // seconds per iteration, one entry per sample
+        
+        double median = 0.0;
+        double mad = 0.0;               // median absolute deviation
+        double mean = 0.0;
+        double min = 0.0;
+        double max = 0.0;
+        double p50 = 0.0;
+        double p90 = 0.0;
+        double p99 = 0.0;
+        std::size_t outliers = 0;       // samples further than 3 (scaled) MADs away from the median
+        
+        perf_counter_values counters;   // per iteration, only if enabled with benchmark::count_events()
+        log_histogram latencies;        // nanoseconds of every iteration, only if enabled with benchmark::record_latencies()
+        
+        void evaluate()
+        {
+            if( samples.empty() ) return;
+            
+            auto sorted = samples;
+            std::sort(sorted.begin(), sorted.end());
+            
+            median = _sorted_quantile(sorted, 0.5);
+            p50 = median;
+            p90 = _sorted_quantile(sorted, 0.9);
+            p99 = _sorted_quantile(sorted, 0.99);
+            min = sorted.front();
+            max = sorted.back();
+            
+            double sum = 0.0;
+            for(auto s : sorted) sum += s;
+            mean = sum / sorted.size();
+            
+            std::vector<double> deviations;
+            deviations.reserve(sorted.size());
+            for(auto s : sorted) deviations.push_back(std::abs(s - median));
+            std::sort(deviations.begin(), deviations.end());
+            
+            mad = _sorted_quantile(deviations, 0.5);
+            
+            // 1.4826 scales the MAD to the standard deviation of a normal distribution
+            outliers = std::count_if(sorted.begin(), sorted.end(),
+                                     [&](double s){ return std::abs(s - median) > 3.0 * 1.4826 * mad; });
+        }
+    };
+    
+    // Benchmark harness
+    // =================
+    
+    // Runs a function in batches. The batch size is calibrated so that one batch takes at
+    // least 'min_sample_time', every batch gives one sample (time per iteration).
+    class benchmark
+    {
+    public:
+        using clock = std::chrono::steady_clock;
+        
+        benchmark &warmup(std::chrono::duration<double> time) { m_warmup = time; return *this; }
+        benchmark &samples(std::size_t count) { m_samples = std::max<std::size_t>(count, 1); return *this; }
+        benchmark &min_sample_time(std::chrono::duration<double> time) { m_min_sample_time = time; return *this; }
+        benchmark &max_iterations(std::size_t count) { m_max_iterations = std::max<std::size_t>(count, 1); return *this; }
+        
+        // collect hardware counters during the samples, silently ignored if not available
+        benchmark &count_events(bool enable = true) { m_count_events = enable; return *this; }
+        
+        // time every single iteration of the samples into benchmark_result::latencies, which 
+        // gives the full distribution (p99.9, max) but adds the clock overhead to every iteration
+        benchmark &record_latencies(bool enable = true) { m_record_latencies = enable; return *this; }
+        
+        template<class function_t>
+        const benchmark_result &run(const std::string &name, function_t func)
+        {
+            benchmark_result result;
+            result.name = name;
+            
+            measure(result, func);
+            
+            m_results.push_back(std::move(result));
+            return m_results.back();
+        }
+        
+        // Runs func(parameter) for every parameter, e.g. for different input sizes
+        template<class function_t>
+        void run(const std::string &name, const std::vector<std::size_t> &parameters, function_t func)
+        {
+            for(auto parameter : parameters)
+            {
+                benchmark_result result;
+                result.name = name;
+                result.parameter = parameter;
+                result.has_parameter = true;
+                
+                measure(result, [&](){ func(parameter); });
+                
+                m_results.push_back(std::move(result));
+            }
+        }
+        
+        const std::vector<benchmark_result> &results() const { return m_results; }
+        void clear() { m_results.clear(); }
+        
+        table to_table() const
+        {
+            table t;
+            auto &creator = t.create();
+            
+            if( m_count_events )
+                creator("name", "param", "samples", "iterations", "median", "MAD", "p50", "p90", "p99", "outliers",
+                        "cycles", "instr.", "IPC", "L1d miss", "LLC miss", "br. miss")(horizontal_line('-'));
+            else
+                creator("name", "param", "samples", "iterations", "median", "MAD", "p50", "p90", "p99", "outliers")
+                       (horizontal_line('-'));
+            
+            auto count = [](const perf_counter_values &values, perf_event event)
+            {
+                std::string buffer = "n/a";
+                if( values.has(event) ) { buffer.clear(); format_to(buffer, values[event], format_options().set_precision(4)); }
+                return buffer;
+            };
+            
+            for(const auto &r : m_results)
+            {
+                auto param = r.has_parameter ? std::to_string(r.parameter) : std::string("-");
+                
+                if( m_count_events )
+                    creator(r.name, param, r.samples.size(), r.iterations, _format_seconds(r.median), 
+                            _format_seconds(r.mad), _format_seconds(r.p50), _format_seconds(r.p90), 
+                            _format_seconds(r.p99), r.outliers, count(r.counters, perf_event::cycles), 
+                            count(r.counters, perf_event::instructions), r.counters.ipc(),
+                            count(r.counters, perf_event::l1d_misses), count(r.counters, perf_event::llc_misses),
+                            count(r.counters, perf_event::branch_misses));
+                else
+                    creator(r.name, param, r.samples.size(), r.iterations, _format_seconds(r.median), 
+                            _format_seconds(r.mad), _format_seconds(r.p50), _format_seconds(r.p90), 
+                            _format_seconds(r.p99), r.outliers);
+            }
+            
+            return t;
+        }
+        
+        // distribution of single iterations, only for benchmarks with record_latencies()
+        table latency_table() const
+        {
+            table t;
+            auto &creator = t.create();
+            
+            creator("name", "param", "iterations", "min", "mean", "p50", "p90", "p99", "p99.9", "max")(horizontal_line('-'));
+            
+            for(const auto &r : m_results)
+            {
+                if( r.latencies.count() == 0 ) continue;
+                
+                const auto &h = r.latencies;
+                auto format = [](double ns){ return _format_seconds(ns * 1e-9); };
+                
+                creator(r.name, r.has_parameter ? std::to_string(r.parameter) : std::string("-"), h.count(), format(h.min()),
+                        format(h.mean()), format(h.quantile(0.5)), format(h.quantile(0.9)), format(h.quantile(0.99)), 
+                        format(h.quantile(0.999)), format(h.max()));
+            }
+            
+            return t;
+        }
+        
+        // times are written in seconds, benchmarks without a parameter get "-"
+        void export_tsv(const std::string &filename, char delimiter = '\t') const
+        {
+            tsv_writer writer(filename, delimiter);
+            writer.write_row("name", "parameter", "samples", "iterations", "median", "mad", "mean", "min", "max",
+                             "p50", "p90", "p99", "outliers");
+            
+            for(const auto &r : m_results)
+            {
+                auto param = r.has_parameter ? std::to_string(r.parameter) : std::string("-");
+                writer.write_row(r.name, param, r.samples.size(), r.iterations, r.median, r.mad, r.mean,
+                                 r.min, r.max, r.p50, r.p90, r.p99, r.outliers);
+            }
+        }
+        
+        // times are written in seconds, values which are not finite as null
+        void export_json(std::ostream &stream) const
+        {
+            std::string buffer = "[\n";
+            const format_options exact = _exact_format();
+            
+            auto field = [&](const char *key, const auto &value, bool last = false)
+            {
+                buffer += "\"";
+                buffer += key;
+                buffer += "\": ";
+                
+                bool finite = true;
+                if constexpr ( std::is_floating_point_v<std::decay_t<decltype(value)>> ) finite = std::isfinite(value);
+                
+                if( finite ) format_to(buffer, value, exact);
+                else buffer += "null";
+                
+                buffer += last ? "" : ", ";
+            };
+            
+            for(std::size_t i=0; i<m_results.size(); ++i)
+            {
+                const auto &r = m_results[i];
+                
+                buffer += "  { \"name\": \"";
+                for(char c : r.name)
+                {
+                    if( c == '"' || c == '\\' ) buffer += '\\';
+                    buffer += c;
+                }
+                buffer += "\", ";
+                
+                if( r.has_parameter ) field("parameter", r.parameter);
+                field("samples", r.samples.size());
+                field("iterations", r.iterations);
+                field("median", r.median);
+                field("mad", r.mad);
+                field("mean", r.mean);
+                field("min", r.min);
+                field("max", r.max);
+                field("p50", r.p50);
+                field("p90", r.p90);
+                field("p99", r.p99);
+                if( r.latencies.count() ) field("p999_iteration", r.latencies.quantile(0.999) * 1e-9);
+                field("outliers", r.outliers, true);
+                
+                buffer += i + 1 == m_results.size() ? " }\n" : " },\n";
+            }
+            
+            buffer += "]\n";
+            stream << buffer;
+        }
+    
+    private:
+        template<class function_t>
+        void measure(benchmark_result &result, function_t func)
+        {
+            // warmup, also gives a first estimate of the runtime
+            auto warmup_end = clock::now() + std::chrono::duration_cast<clock::duration>(m_warmup);
+            std::size_t warmup_iterations = 0;
+            auto warmup_start = clock::now();
+            
+            do
+            {
+                func();
+                clobber_memory();
+                ++warmup_iterations;
+            }
+            while( clock::now() < warmup_end );
+            
+            std::chrono::duration<double> warmup_time = clock::now() - warmup_start;
+            
+            // calibrate batch size
+            double estimate = warmup_time.count() / warmup_iterations;
+            std::size_t batch = estimate > 0.0 ? static_cast<std::size_t>(m_min_sample_time.count() / estimate) : 1;
+            batch = std::min(std::max<std::size_t>(batch, 1), m_max_iterations);
+            
+            while( batch < m_max_iterations && time_batch(func, batch) < m_min_sample_time.count() )
+                batch *= 2;
+            
+            result.iterations = batch;
+            result.samples.reserve(m_samples);
+            
+            std::unique_ptr<perf_counters> counters;
+            if( m_count_events ) counters.reset(new perf_counters());
+            
+            for(std::size_t i=0; i<m_samples; ++i)
+            {
+                if( counters ) counters->start();
+                if( m_record_latencies )
+                    result.samples.push_back(measure_time([&](){ func(); clobber_memory(); }, batch, result.latencies));
+                else
+                    result.samples.push_back(time_batch(func, batch) / batch);
+                if( counters ) counters->stop();
+            }
+            
+            if( counters )
+                result.counters = counters->read() / static_cast<double>(batch * m_samples);
+            
+            result.evaluate();
+        }
+        
+        template<class function_t>
+        double time_batch(function_t &func, std::size_t batch)
+        {
+            auto start = clock::now();
+            
+            for(std::size_t i=0; i<batch; ++i)
+            {
+                func();
+                clobber_memory();
+            }
+            
+            std::chrono::duration<double> elapsed = clock::now() - start;
+            return elapsed.count();
+        }
+        
+        std::chrono::duration<double> m_warmup{0.05};
+        std::chrono::duration<double> m_min_sample_time{0.001};
+        std::size_t m_samples = 30;
+        std::size_t m_max_iterations = 1ul << 30;
+        bool m_count_events = false;
+        bool m_record_latencies = false;
+        
+        std::vector<benchmark_result> m_results;
+    };
+}
+
+#endif
@@ -0,0 +1,946 @@
+#ifndef MCL_IO_HPP
+#define MCL_IO_HPP
+
+#if __cplusplus < 201703L
+#error "error: 'mcl_io.hpp' requires C++17!"
+#endif
+
+#if !defined(__unix__) && !defined(__APPLE__)
+#error "error: 'mcl_io.hpp' requires a POSIX system (mmap)!"
+#endif
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+#include <iterator>
+#include <algorithm>
+#include <charconv>
+#include <tuple>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mcl_basic.hpp"
+
+namespace mc
+{
+    // Memory mapped files
+    // ===================
+    
+    // Read-only mapping of a whole file, the mapping is released in the destructor
+    class mapped_file
+    {
+    public:
+        mapped_file() = default;
+        
+        explicit mapped_file(const std::string &filename)
+        {
+            int fd = ::open(filename.c_str(), O_RDONLY);
+            
+            if( fd < 0 )
+                throw std::runtime_error("could not open file '" + filename + "'");
+            
+            struct stat info;
+            if( ::fstat(fd, &info) != 0 )
+            {
+                ::close(fd);
+                throw std::runtime_error("could not stat file '" + filename + "'");
+            }
+            
+            m_size = static_cast<std::size_t>(info.st_size);
+            
+            // mmap does not accept empty mappings
+            if( m_size > 0 )
+            {
+                void *ptr = ::mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+                
+                if( ptr == MAP_FAILED )
+                {
+                    ::close(fd);
+                    throw std::runtime_error("could not map file '" + filename + "'");
+                }
+                
+                m_data = static_cast<const char *>(ptr);
+            }
+            
+            ::close(fd);
+        }
+        
+        mapped_file(const mapped_file &) = delete;
+        mapped_file &operator=(const mapped_file &) = delete;
+        
+        mapped_file(mapped_file &&other) noexcept : m_data(other.m_data), m_size(other.m_size)
+        {
+            other.m_data = nullptr;
+            other.m_size = 0;
+        }
+        
+        mapped_file &operator=(mapped_file &&other) noexcept
+        {
+            if( this != &other )
+            {
+                unmap();
+                std::swap(m_data, other.m_data);
+                std::swap(m_size, other.m_size);
+            }
+            return *this;
+        }
+        
+        ~mapped_file() { unmap(); }
+        
+        const char *data() const { return m_data; }
+        std::size_t size() const { return m_size; }
+        bool empty() const { return m_size == 0; }
+        
+        // hint for the kernel, e.g. MADV_SEQUENTIAL or MADV_WILLNEED
+        void advise(int advice) const
+        {
+            if( m_data ) ::madvise(const_cast<char *>(m_data), m_size, advice);
+        }
+    
+    private:
+        void unmap()
+        {
+            if( m_data ) ::munmap(const_cast<char *>(m_data), m_size);
+            m_data = nullptr;
+        }
+        
+        const char *m_data = nullptr;
+        std::size_t m_size = 0;
+    };
+    
+    // Lightweight non-owning view on contiguous elements
+    template<typename T>
+    class span
+    {
+    public:
+        using value_type = std::remove_cv_t<T>;
+        using iterator = T *;
+        
+        span() = default;
+        span(T *data, std::size_t size) : m_data(data), m_size(size) { }
+        
+        T *data() const { return m_data; }
+        std::size_t size() const { return m_size; }
+        bool empty() const { return m_size == 0; }
+        
+        T *begin() const { return m_data; }
+        T *end() const { return m_data + m_size; }
+        
+        T &operator[](std::size_t i) const { return m_data[i]; }
+    
+    private:
+        T *m_data = nullptr;
+        std::size_t m_size = 0;
+    };
+    
+    // Binary columnar format
+    // ======================
+    
+    // Layout (native byte order, checked on load):
+    //   header       magic, byte order mark, version, #columns, #rows, alignment
+    //   descriptors  type, name length, offset and size of the data block, name
+    //   data blocks  one per column, each aligned to 'alignment' bytes
+    // Numeric columns are stored as plain arrays, string columns as #rows+1
+    // offsets (uint64) followed by the concatenated characters.
+    
+    enum class binary_type : std::uint32_t
+    {
+        int8 = 1, uint8, int16, uint16, int32, uint32, int64, uint64, float32, float64, boolean, string
+    };
+    
+    inline std::string to_string(binary_type type)
+    {
+        static const char *names[] = { "invalid", "int8", "uint8", "int16", "uint16", "int32", "uint32",
+                                       "int64", "uint64", "float32", "float64", "bool", "string" };
+        auto i = static_cast<std::uint32_t>(type);
+        return i < sizeof(names)/sizeof(names[0]) ? names[i] : names[0];
+    }
+    
+    // bytes per element of a numeric column, 0 for strings and unknown types
+    inline std::uint64_t _binary_element_size(binary_type type)
+    {
+        switch( type )
+        {
+            case binary_type::int8: case binary_type::uint8: case binary_type::boolean: return 1;
+            case binary_type::int16: case binary_type::uint16: return 2;
+            case binary_type::int32: case binary_type::uint32: case binary_type::float32: return 4;
+            case binary_type::int64: case binary_type::uint64: case binary_type::float64: return 8;
+            default: return 0;
+        }
+    }
+    
+    template<typename T>
+    constexpr binary_type _binary_type_of()
+    {
+        if constexpr ( std::is_same_v<T, bool> )
+            return binary_type::boolean;
+        else if constexpr ( std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view> )
+            return binary_type::string;
+        else if constexpr ( std::is_floating_point_v<T> )
+        {
+            static_assert( sizeof(T) == 4 || sizeof(T) == 8, "only 32 and 64 bit floating point types are supported");
+            return sizeof(T) == 4 ? binary_type::float32 : binary_type::float64;
+        }
+        else
+        {
+            static_assert( std::is_integral_v<T>, "type not supported by the binary format");
+            
+            constexpr auto base = sizeof(T) == 1 ? 1u : sizeof(T) == 2 ? 3u : sizeof(T) == 4 ? 5u : 7u;
+            return static_cast<binary_type>(std::is_signed_v<T> ? base : base + 1);
+        }
+    }
+    
+    struct _binary_header
+    {
+        char magic[8];
+        std::uint32_t byte_order;
+        std::uint32_t version;
+        std::uint64_t columns;
+        std::uint64_t rows;
+        std::uint64_t alignment;
+    };
+    
+    struct _binary_descriptor
+    {
+        std::uint32_t type;
+        std::uint32_t name_length;
+        std::uint64_t offset;
+        std::uint64_t bytes;
+    };
+    
+    constexpr char _binary_magic[8] = { 'M', 'C', 'L', 'B', 'I', 'N', '\0', '\0' };
+    constexpr std::uint32_t _binary_byte_order = 0x01020304;
+    constexpr std::uint32_t _binary_version = 1;
+    
+    inline std::uint64_t _align_up(std::uint64_t value, std::uint64_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+    
+    // containers with random access iterators and a data() member store their elements contiguously
+    template<class container_t, class = void>
+    struct _is_contiguous : std::false_type { };
+    
+    template<class container_t>
+    struct _is_contiguous<container_t, std::void_t<decltype(std::declval<const container_t &>().data())>> :
+        std::is_same<typename std::iterator_traits<typename container_t::const_iterator>::iterator_category,
+                     std::random_access_iterator_tag> { };
+    
+    template<class container_t>
+    inline std::uint64_t _binary_column_bytes(const container_t &c)
+    {
+        using value_t = typename container_t::value_type;
+        
+        if constexpr ( _binary_type_of<value_t>() == binary_type::string )
+        {
+            std::uint64_t chars = 0;
+            for(const auto &str : c) chars += str.size();
+            return (c.size() + 1) * sizeof(std::uint64_t) + chars;
+        }
+        else
+            return c.size() * sizeof(value_t);
+    }
+    
+    template<class container_t>
+    inline void _binary_write_column(std::ofstream &file, const container_t &c)
+    {
+        using value_t = typename container_t::value_type;
+        
+        if constexpr ( _binary_type_of<value_t>() == binary_type::string )
+        {
+            std::vector<std::uint64_t> offsets;
+            offsets.reserve(c.size() + 1);
+            offsets.push_back(0);
+            
+            for(const auto &str : c) offsets.push_back(offsets.back() + str.size());
+            
+            file.write(reinterpret_cast<const char *>(offsets.data()), offsets.size() * sizeof(std::uint64_t));
+            for(const auto &str : c) file.write(str.data(), str.size());
+        }
+        else if constexpr ( std::is_same_v<value_t, bool> )
+        {
+            for(bool b : c)
+            {
+                char byte = b ? 1 : 0;
+                file.write(&byte, 1);
+            }
+        }
+        else if constexpr ( _is_contiguous<container_t>::value )
+        {
+            file.write(reinterpret_cast<const char *>(c.data()), c.size() * sizeof(value_t));
+        }
+        else
+        {
+            // e.g. std::list, write through a buffer
+            std::vector<value_t> buffer;
+            buffer.reserve(std::min<std::size_t>(c.size(), 1 << 16));
+            
+            for(const auto &el : c)
+            {
+                buffer.push_back(el);
+                
+                if( buffer.size() == buffer.capacity() )
+                {
+                    file.write(reinterpret_cast<const char *>(buffer.data()), buffer.size() * sizeof(value_t));
+                    buffer.clear();
+                }
+            }
+            
+            file.write(reinterpret_cast<const char *>(buffer.data()), buffer.size() * sizeof(value_t));
+        }
+    }
+    
+    // Exports the containers as columns of a binary file, which can be loaded with mc::binary_file
+    template<class ... containers_t>
+    inline void export_binary(const std::string &filename, const std::vector<std::string> &headers,
+                              const containers_t& ... containers)
+    {
+        if( headers.size() != sizeof...(containers_t) )
+            throw std::runtime_error("number of headers must match number of containers");
+        
+        constexpr std::uint64_t alignment = 64;
+        
+        std::vector<std::uint64_t> rows = { static_cast<std::uint64_t>(containers.size())... };
+        std::vector<std::uint32_t> types = { static_cast<std::uint32_t>(_binary_type_of<typename containers_t::value_type>())... };
+        std::vector<std::uint64_t> bytes = { _binary_column_bytes(containers)... };
+        
+        // no containers give a valid file without columns and rows
+        const std::uint64_t row_count = rows.empty() ? 0 : rows.front();
+        
+        for(auto r : rows)
+            if( r != row_count )
+                throw std::runtime_error("vector sizes do not match!");
+        
+        // compute layout
+        std::uint64_t position = sizeof(_binary_header);
+        for(const auto &name : headers)
+            position += _align_up(sizeof(_binary_descriptor) + name.size(), 8);
+        
+        std::vector<_binary_descriptor> descriptors(headers.size());
+        for(std::size_t i=0; i<headers.size(); ++i)
+        {
+            position = _align_up(position, alignment);
+            descriptors[i] = _binary_descriptor{ types[i], static_cast<std::uint32_t>(headers[i].size()), position, bytes[i] };
+            position += bytes[i];
+        }
+        
+        // write
+        std::ofstream file(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+        
+        if( !file )
+            throw std::runtime_error("could not open file '" + filename + "'");
+        
+        _binary_header header{ {}, _binary_byte_order, _binary_version, headers.size(), row_count, alignment };
+        std::memcpy(header.magic, _binary_magic, sizeof(header.magic));
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        
+        const char zeros[alignment] = {};
+        std::uint64_t written = sizeof(header);
+        
+        auto pad_to = [&](std::uint64_t target)
+        {
+            file.write(zeros, target - written);
+            written = target;
+        };
+        
+        for(std::size_t i=0; i<headers.size(); ++i)
+        {
+            file.write(reinterpret_cast<const char *>(&descriptors[i]), sizeof(_binary_descriptor));
+            file.write(headers[i].data(), headers[i].size());
+            written += sizeof(_binary_descriptor) + headers[i].size();
+            pad_to(_align_up(written, 8));
+        }
+        
+        std::size_t i = 0;
+        auto write_column = [&](const auto &c)
+        {
+            pad_to(descriptors[i].offset);
+            _binary_write_column(file, c);
+            written += descriptors[i++].bytes;
+        };
+        
+        (write_column(containers), ...);
+        
+        if( !file )
+            throw std::runtime_error("error while writing file '" + filename + "'");
+    }
+    
+    // Zero-copy access to a string column of a binary file
+    class string_column
+    {
+    public:
+        string_column() = default;
+        string_column(const std::uint64_t *offsets, const char *chars, std::size_t size) :
+            m_offsets(offsets), m_chars(chars), m_size(size) { }
+        
+        std::size_t size() const { return m_size; }
+        
+        std::string_view operator[](std::size_t i) const
+        {
+            return std::string_view(m_chars + m_offsets[i], m_offsets[i+1] - m_offsets[i]);
+        }
+        
+        // random access, dereferencing yields a std::string_view by value
+        struct iterator
+        {
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type = std::string_view;
+            using reference = std::string_view;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            
+            const string_column *column;
+            std::size_t i;
+            
+            bool operator != (const iterator &other) const { return i != other.i; }
+            bool operator == (const iterator &other) const { return i == other.i; }
+            bool operator < (const iterator &other) const { return i < other.i; }
+            bool operator > (const iterator &other) const { return i > other.i; }
+            bool operator <= (const iterator &other) const { return i <= other.i; }
+            bool operator >= (const iterator &other) const { return i >= other.i; }
+            
+            iterator &operator ++ () { ++i; return *this; }
+            iterator &operator -- () { --i; return *this; }
+            iterator operator ++ (int) { return iterator{ column, i++ }; }
+            iterator operator -- (int) { return iterator{ column, i-- }; }
+            iterator &operator += (difference_type n) { i += n; return *this; }
+            iterator &operator -= (difference_type n) { i -= n; return *this; }
+            iterator operator + (difference_type n) const { return iterator{ column, i + n }; }
+            iterator operator - (difference_type n) const { return iterator{ column, i - n }; }
+            difference_type operator - (const iterator &other) const { return static_cast<difference_type>(i) - static_cast<difference_type>(other.i); }
+            
+            std::string_view operator * () const { return (*column)[i]; }
+            std::string_view operator [] (difference_type n) const { return (*column)[i + n]; }
+        };
+        
+        iterator begin() const { return iterator{ this, 0 }; }
+        iterator end() const { return iterator{ this, m_size }; }
+    
+    private:
+        const std::uint64_t *m_offsets = nullptr;
+        const char *m_chars = nullptr;
+        std::size_t m_size = 0;
+    };
+    
+    // Memory mapped binary file written by mc::export_binary. All returned views
+    // point directly into the mapping and are valid as long as this object lives.
+    class binary_file
+    {
+    public:
+        struct column_info
+        {
+            std::string name;
+            binary_type type;
+            std::uint64_t offset;
+            std::uint64_t bytes;
+        };
+        
+        explicit binary_file(const std::string &filename) : m_file(filename)
+        {
+            if( m_file.size() < sizeof(_binary_header) )
+                throw std::runtime_error("'" + filename + "' is not a mcl binary file");
+            
+            _binary_header header;
+            std::memcpy(&header, m_file.data(), sizeof(header));
+            
+            if( std::memcmp(header.magic, _binary_magic, sizeof(header.magic)) != 0 )
+                throw std::runtime_error("'" + filename + "' is not a mcl binary file");
+            if( header.byte_order != _binary_byte_order )
+                throw std::runtime_error("'" + filename + "' was written with a different byte order");
+            if( header.version != _binary_version )
+                throw std::runtime_error("'" + filename + "' has unsupported version " + std::to_string(header.version));
+            
+            m_rows = header.rows;
+            m_alignment = header.alignment;
+            
+            std::uint64_t position = sizeof(header);
+            for(std::uint64_t i=0; i<header.columns; ++i)
+            {
+                _binary_descriptor desc;
+                
+                if( position + sizeof(desc) > m_file.size() )
+                    throw std::runtime_error("'" + filename + "' is truncated");
+                
+                std::memcpy(&desc, m_file.data() + position, sizeof(desc));
+                position += sizeof(desc);
+                
+                if( desc.name_length > m_file.size() - position || desc.offset > m_file.size() || desc.bytes > m_file.size() - desc.offset )
+                    throw std::runtime_error("'" + filename + "' is truncated");
+                
+                m_columns.push_back(column_info{ std::string(m_file.data() + position, desc.name_length),
+                                                 static_cast<binary_type>(desc.type), desc.offset, desc.bytes });
+                validate(m_columns.back(), true);
+                
+                position = _align_up(position + desc.name_length, 8);
+            }
+        }
+        
+        std::size_t rows() const { return m_rows; }
+        std::size_t alignment() const { return m_alignment; }
+        const std::vector<column_info> &columns() const { return m_columns; }
+        
+        std::vector<std::string> column_names() const
+        {
+            std::vector<std::string> names;
+            for(const auto &c : m_columns) names.push_back(c.name);
+            return names;
+        }
+        
+        const column_info &info(const std::string &name) const
+        {
+            for(const auto &c : m_columns)
+                if( c.name == name )
+                    return c;
+            
+            throw std::runtime_error("column '" + name + "' does not exist");
+        }
+        
+        // typed view on a numeric column, T must match the stored type exactly
+        template<typename T>
+        span<const T> column(const std::string &name) const
+        {
+            static_assert( !std::is_same_v<T, std::string>, "use string_column() for string columns");
+            
+            const auto &c = info(name);
+            
+            if( c.type != _binary_type_of<T>() )
+                throw std::runtime_error("column '" + name + "' has type " + to_string(c.type) +
+                                         ", requested " + to_string(_binary_type_of<T>()));
+            
+            validate(c, false);
+            return span<const T>(reinterpret_cast<const T *>(m_file.data() + c.offset), m_rows);
+        }
+        
+        string_column strings(const std::string &name) const
+        {
+            const auto &c = info(name);
+            
+            if( c.type != binary_type::string )
+                throw std::runtime_error("column '" + name + "' has type " + to_string(c.type) + ", requested string");
+            
+            validate(c, false);
+            auto offsets = reinterpret_cast<const std::uint64_t *>(m_file.data() + c.offset);
+            auto chars = m_file.data() + c.offset + (m_rows + 1) * sizeof(std::uint64_t);
+            
+            return string_column(offsets, chars, m_rows);
+        }
+    
+    private:
+        // the header is not trusted, a column whose data block cannot hold all rows would let the 
+        // views read outside of the mapping. The string offsets are checked one by one only when
+        // the file is opened, later accesses check the sizes and the last offset.
+        void validate(const column_info &c, bool check_offsets) const
+        {
+            auto corrupt = [&](const char *reason)
+            {
+                return std::runtime_error("column '" + c.name + "' is corrupt: " + reason);
+            };
+            
+            if( c.offset > m_file.size() || c.bytes > m_file.size() - c.offset )
+                throw corrupt("data block exceeds the file");
+            
+            if( c.type != binary_type::string )
+            {
+                const std::uint64_t size = _binary_element_size(c.type);
+                
+                if( size == 0 )
+                    throw corrupt("unknown type");
+                if( c.offset % size != 0 )
+                    throw corrupt("data block is not aligned");
+                if( m_rows > c.bytes / size )
+                    throw corrupt("data block is smaller than the number of rows");
+                
+                return;
+            }
+            
+            // #rows+1 offsets followed by the characters
+            if( c.offset % sizeof(std::uint64_t) != 0 )
+                throw corrupt("data block is not aligned");
+            if( m_rows >= c.bytes / sizeof(std::uint64_t) )
+                throw corrupt("string offsets do not fit into the data block");
+            
+            auto offsets = reinterpret_cast<const std::uint64_t *>(m_file.data() + c.offset);
+            const std::uint64_t chars = c.bytes - (m_rows + 1) * sizeof(std::uint64_t);
+            
+            if( offsets[0] > offsets[m_rows] || offsets[m_rows] > chars )
+                throw corrupt("string offsets exceed the characters");
+            
+            if( check_offsets )
+                for(std::uint64_t i=0; i<m_rows; ++i)
+                    if( offsets[i] > offsets[i+1] )
+                        throw corrupt("string offsets are not increasing");
+        }
+        
+        mapped_file m_file;
+        std::uint64_t m_rows = 0;
+        std::uint64_t m_alignment = 0;
+        std::vector<column_info> m_columns;
+    };
+    
+    // Delimiter separated reader
+    // ==========================
+    
+    // Parses a single field in place with mc::convert_checked, no intermediate std::string is created
+    template<typename T>
+    inline void _parse_field(const char *first, const char *last, T &value, std::size_t line)
+    {
+        if constexpr ( std::is_same_v<T, std::string> )
+            value.assign(first, last);
+        else
+        {
+            auto result = convert_checked<T>(std::string_view(first, last - first));
+            
+            if( !result )
+                throw std::runtime_error("line " + std::to_string(line) + ": cannot convert '" + 
+                                         std::string(first, last) + "'");
+            
+            value = result.value;
+        }
+    }
+    
+    // std::vector<bool> cannot be written concurrently, therefore booleans are parsed into bytes first
+    enum class _parsed_bool : char { };
+    
+    inline void _parse_field(const char *first, const char *last, _parsed_bool &value, std::size_t line)
+    {
+        bool b;
+        _parse_field(first, last, b, line);
+        value = static_cast<_parsed_bool>(b);
+    }
+    
+    template<typename T>
+    using _parse_storage_t = std::conditional_t<std::is_same_v<T, bool>, _parsed_bool, T>;
+    
+    // Reader for files written by export_containers. The file is memory mapped, the first line is 
+    // the header. Fields must not contain the delimiter or line breaks. Columns of type 
+    // std::string_view point directly into the mapping and are valid as long as the reader lives.
+    class tsv_reader
+    {
+    public:
+        explicit tsv_reader(const std::string &filename, char delimiter = '\t') :
+            m_file(filename), m_delimiter(delimiter)
+        {
+            const char *end = m_file.data() + m_file.size();
+            const char *line_end = next_line_end(m_file.data(), end);
+            
+            m_data_begin = line_end == end ? end : line_end + 1;
+            m_position = m_data_begin;
+            
+            auto fields = split(m_file.data(), strip(m_file.data(), line_end));
+            for(auto field : fields)
+                m_header.emplace_back(field);
+        }
+        
+        const std::vector<std::string> &header() const { return m_header; }
+        
+        std::size_t column_index(const std::string &name) const
+        {
+            auto found = std::find(m_header.begin(), m_header.end(), name);
+            
+            if( found == m_header.end() )
+                throw std::runtime_error("column '" + name + "' does not exist");
+            
+            return found - m_header.begin();
+        }
+        
+        // Parses the whole file in parallel. The data is split into newline-aligned chunks, 
+        // the rows of each chunk are counted first, so every chunk is parsed directly into its 
+        // final position. An empty 'columns' list selects the first columns in file order.
+        template<typename ... types_t>
+        std::tuple<std::vector<types_t>...> read(const std::vector<std::string> &columns = {}, std::size_t threads = 0)
+        {
+            auto indices = column_indices(sizeof...(types_t), columns);
+            
+            if( threads == 0 ) threads = _default_thread_count();
+            
+            // split into chunks
+            const char *end = m_file.data() + m_file.size();
+            std::size_t chunk_count = std::max<std::size_t>(1, std::min<std::size_t>(threads * 4, (end - m_data_begin) / (1 << 16)));
+            
+            std::vector<const char *> bounds = { m_data_begin };
+            for(std::size_t i=1; i<chunk_count; ++i)
+            {
+                const char *guess = std::max(bounds.back(), m_data_begin + (end - m_data_begin) * i / chunk_count);
+                const char *line_end = next_line_end(guess, end);
+                bounds.push_back(line_end == end ? end : line_end + 1);
+            }
+            bounds.push_back(end);
+            
+            // count rows per chunk
+            std::vector<std::size_t> first_row(chunk_count + 1, 0);
+            _run_tasks(chunk_count, threads, [&](std::size_t i)
+            {
+                first_row[i+1] = count_rows(bounds[i], bounds[i+1]);
+            });
+            
+            for(std::size_t i=0; i<chunk_count; ++i)
+                first_row[i+1] += first_row[i];
+            
+            // parse chunks into place
+            std::tuple<std::vector<_parse_storage_t<types_t>>...> storage;
+            std::apply([&](auto & ... vecs){ (vecs.resize(first_row.back()), ...); }, storage);
+            
+            _run_tasks(chunk_count, threads, [&](std::size_t i)
+            {
+                parse_rows(bounds[i], bounds[i+1], first_row[i], 0, indices, storage, std::index_sequence_for<types_t...>());
+            });
+            
+            m_position = end;
+            
+            return convert_storage<types_t...>(std::move(storage), std::index_sequence_for<types_t...>());
+        }
+        
+        // Streaming mode: parses the next (at most) 'rows' rows into the given vectors, which are 
+        // resized and can be reused across calls, so memory stays bounded. Returns the number of 
+        // rows read, 0 at the end of the file.
+        template<typename ... types_t>
+        std::size_t read_batch(std::size_t rows, const std::vector<std::string> &columns, std::vector<types_t> & ... outputs)
+        {
+            auto indices = column_indices(sizeof...(types_t), columns);
+            
+            const char *end = m_file.data() + m_file.size();
+            const char *batch_end = m_position;
+            
+            std::size_t count = 0;
+            while( count < rows && batch_end != end )
+            {
+                const char *line_end = next_line_end(batch_end, end);
+                if( strip(batch_end, line_end) != batch_end ) ++count;
+                batch_end = line_end == end ? end : line_end + 1;
+            }
+            
+            std::tuple<std::vector<types_t> & ...> storage(outputs...);
+            std::apply([&](auto & ... vecs){ (vecs.resize(count), ...); }, storage);
+            
+            parse_rows(m_position, batch_end, 0, m_batch_row, indices, storage, std::index_sequence_for<types_t...>());
+            
+            // pages which were consumed are not needed any longer
+            release_pages(m_position, batch_end);
+            
+            m_position = batch_end;
+            m_batch_row += count;
+            
+            return count;
+        }
+        
+        // starts reading again after the header
+        void rewind() 
+        { 
+            m_position = m_data_begin; 
+            m_batch_row = 0;
+        }
+    
+    private:
+        const char *next_line_end(const char *first, const char *last) const
+        {
+            auto found = static_cast<const char *>(std::memchr(first, '\n', last - first));
+            return found ? found : last;
+        }
+        
+        // removes a trailing '\r'
+        static const char *strip(const char *first, const char *last)
+        {
+            return (last != first && *(last-1) == '\r') ? last - 1 : last;
+        }
+        
+        std::vector<std::string_view> split(const char *first, const char *last) const
+        {
+            std::vector<std::string_view> fields;
+            split(first, last, fields);
+            return fields;
+        }
+        
+        void split(const char *first, const char *last, std::vector<std::string_view> &fields) const
+        {
+            fields.clear();
+            
+            if( first == last ) return;
+            
+            while( true )
+            {
+                auto found = static_cast<const char *>(std::memchr(first, m_delimiter, last - first));
+                
+                if( !found )
+                {
+                    fields.emplace_back(first, last - first);
+                    return;
+                }
+                
+                fields.emplace_back(first, found - first);
+                first = found + 1;
+            }
+        }
+        
+        std::vector<std::size_t> column_indices(std::size_t count, const std::vector<std::string> &columns) const
+        {
+            std::vector<std::size_t> indices;
+            
+            if( count == 0 )
+                throw std::runtime_error("no columns requested");
+            
+            if( columns.empty() )
+            {
+                if( count > m_header.size() )
+                    throw std::runtime_error("file has less columns than requested");
+                
+                for(std::size_t i=0; i<count; ++i)
+                    indices.push_back(i);
+            }
+            else
+            {
+                if( columns.size() != count )
+                    throw std::runtime_error("number of headers must match number of containers");
+                
+                for(const auto &name : columns)
+                    indices.push_back(column_index(name));
+            }
+            
+            return indices;
+        }
+        
+        // number of non-empty lines in [first, last)
+        std::size_t count_rows(const char *first, const char *last) const
+        {
+            std::size_t rows = 0;
+            
+            while( first != last )
+            {
+                const char *line_end = next_line_end(first, last);
+                if( strip(first, line_end) != first ) ++rows;
+                first = line_end == last ? last : line_end + 1;
+            }
+            
+            return rows;
+        }
+        
+        template<class storage_t, std::size_t ... I>
+        void parse_rows(const char *first, const char *last, std::size_t row, std::size_t skipped_rows, 
+                        const std::vector<std::size_t> &indices, storage_t &storage, std::index_sequence<I...>) const
+        {
+            std::vector<std::string_view> fields;
+            std::size_t max_index = *std::max_element(indices.begin(), indices.end());
+            
+            while( first != last )
+            {
+                const char *line_end = next_line_end(first, last);
+                
+                split(first, strip(first, line_end), fields);
+                
+                if( !fields.empty() )
+                {
+                    // +2: one for the header, one because lines are counted from 1
+                    std::size_t line = skipped_rows + row + 2;
+                    
+                    if( fields.size() <= max_index )
+                        throw std::runtime_error("line " + std::to_string(line) + " has only " + 
+                                                 std::to_string(fields.size()) + " fields");
+                    
+                    auto parse = [&](auto &vec, std::size_t index)
+                    {
+                        using value_t = typename std::decay_t<decltype(vec)>::value_type;
+                        auto field = fields[index];
+                        
+                        if constexpr ( std::is_same_v<value_t, bool> )
+                        {
+                            bool value;
+                            _parse_field(field.data(), field.data() + field.size(), value, line);
+                            vec[row] = value;
+                        }
+                        else
+                            _parse_field(field.data(), field.data() + field.size(), vec[row], line);
+                    };
+                    
+                    (parse(std::get<I>(storage), indices[I]), ...);
+                    ++row;
+                }
+                
+                first = line_end == last ? last : line_end + 1;
+            }
+        }
+        
+        void release_pages(const char *first, const char *last) const
+        {
+            const auto page = static_cast<std::uintptr_t>(::sysconf(_SC_PAGESIZE));
+            auto begin = (reinterpret_cast<std::uintptr_t>(first) + page - 1) / page * page;
+            auto end = reinterpret_cast<std::uintptr_t>(last) / page * page;
+            
+            if( end > begin )
+                ::madvise(reinterpret_cast<void *>(begin), end - begin, MADV_DONTNEED);
+        }
+        
+        template<typename ... types_t, class storage_t, std::size_t ... I>
+        static std::tuple<std::vector<types_t>...> convert_storage(storage_t &&storage, std::index_sequence<I...>)
+        {
+            auto convert = [](auto &&vec, auto *type)
+            {
+                using T = std::remove_pointer_t<decltype(type)>;
+                
+                if constexpr ( std::is_same_v<T, bool> )
+                {
+                    std::vector<bool> bools(vec.size());
+                    for(std::size_t i=0; i<vec.size(); ++i) bools[i] = static_cast<bool>(vec[i]);
+                    return bools;
+                }
+                else
+                    return std::move(vec);
+            };
+            
+            return std::tuple<std::vector<types_t>...>(convert(std::get<I>(storage), static_cast<types_t *>(nullptr))...);
+        }
+        
+        mapped_file m_file;
+        char m_delimiter;
+        
+        std::vector<std::string> m_header;
+        const char *m_data_begin;
+        const char *m_position;
+        std::size_t m_batch_row = 0;
+    };
+    
+    template<class columns_t, std::size_t ... I, class ... containers_t>
+    inline void _assign_columns(columns_t &columns, std::index_sequence<I...>, containers_t & ... containers)
+    {
+        auto assign = [](auto &column, auto &container)
+        {
+            if constexpr ( std::is_same_v<std::decay_t<decltype(column)>, std::decay_t<decltype(container)>> )
+                container = std::move(column);
+            else
+                container.assign(column.begin(), column.end());
+        };
+        
+        (assign(std::get<I>(columns), containers), ...);
+    }
+    
+    // Reads the columns 'headers' into the containers. Containers without random access 
+    // (e.g. std::list) are filled after parsing into a std::vector.
+    template<class ... containers_t>
+    inline void import_containers(tsv_reader &reader, const std::vector<std::string> &headers, 
+                                  containers_t & ... containers)
+    {
+        if( headers.size() != sizeof...(containers_t) )
+            throw std::runtime_error("number of headers must match number of containers");
+        
+        auto columns = reader.read<typename containers_t::value_type...>(headers);
+        
+        _assign_columns(columns, std::index_sequence_for<containers_t...>(), containers...);
+    }
+    
+    template<class ... containers_t>
+    inline void import_containers(const std::string &filename, const std::vector<std::string> &headers, 
+                                  containers_t & ... containers)
+    {
+        tsv_reader reader(filename);
+        import_containers(reader, headers, containers...);
+    }
+}
+
+#endif
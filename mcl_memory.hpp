@@ -0,0 +1,264 @@
+#ifndef MCL_MEMORY_HPP
+#define MCL_MEMORY_HPP
+
+#if __cplusplus < 201703L
+#error "error: 'mcl_memory.hpp' requires C++17!"
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+#include "mcl_basic.hpp"
+
+// Usage: all memory resources plug into std::pmr containers and the allocator aware parts of
+// mcl, e.g. mc::table(&arena) or mc::stringify_container(v, &arena).
+namespace mc
+{
+    // Arena
+    // =====
+
+    // Monotonic allocator: allocations bump a pointer inside large blocks, deallocation does
+    // nothing and everything is freed at once by release() or the destructor. Not thread safe,
+    // use one arena per thread (e.g. per report or per parsed file).
+    class arena : public std::pmr::memory_resource
+    {
+    public:
+        explicit arena(std::size_t block_size = 64 << 10, std::pmr::memory_resource *upstream = std::pmr::new_delete_resource()) :
+            m_upstream(upstream), m_first_block_size(std::max<std::size_t>(block_size, 256)), m_next_block_size(m_first_block_size) { }
+
+        // the first allocations use the given buffer (e.g. on the stack), which is never freed
+        arena(void *buffer, std::size_t size, std::pmr::memory_resource *upstream = std::pmr::new_delete_resource()) :
+            arena(std::max<std::size_t>(size, 256), upstream)
+        {
+            m_initial = static_cast<char *>(buffer);
+            m_initial_size = size;
+            m_current = m_initial;
+            m_end = m_initial + size;
+        }
+
+        ~arena() override { release(); }
+
+        arena(const arena &) = delete;
+        arena &operator=(const arena &) = delete;
+
+        // frees all blocks, every pointer handed out before becomes invalid
+        void release()
+        {
+            while( m_blocks )
+            {
+                block_t *previous = m_blocks->previous;
+                m_upstream->deallocate(m_blocks, m_blocks->size, alignof(std::max_align_t));
+                m_blocks = previous;
+            }
+
+            m_current = m_initial;
+            m_end = m_initial ? m_initial + m_initial_size : nullptr;
+            m_next_block_size = m_first_block_size;
+            m_used = 0;
+            m_reserved = 0;
+        }
+
+        // bytes handed out since the last release (including alignment)
+        std::size_t bytes_used() const { return m_used; }
+
+        // bytes allocated from the upstream resource
+        std::size_t bytes_reserved() const { return m_reserved; }
+
+        std::pmr::memory_resource *upstream_resource() const { return m_upstream; }
+
+    protected:
+        void *do_allocate(std::size_t bytes, std::size_t alignment) override
+        {
+            if( void *p = bump(bytes, alignment) ) return p;
+
+            // large requests get their own block, so the current block is not wasted
+            const std::size_t required = sizeof(block_t) + bytes + alignment;
+
+            if( required > m_next_block_size / 2 )
+            {
+                auto *block = allocate_block(required);
+                char *p = align(reinterpret_cast<char *>(block + 1), alignment);
+                m_used += bytes;
+                return p;
+            }
+
+            auto *block = allocate_block(m_next_block_size);
+            m_current = reinterpret_cast<char *>(block + 1);
+            m_end = reinterpret_cast<char *>(block) + block->size;
+            m_next_block_size = std::min<std::size_t>(2 * m_next_block_size, 16 << 20);
+
+            return bump(bytes, alignment);
+        }
+
+        void do_deallocate(void *, std::size_t, std::size_t) override { }
+
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+
+    private:
+        struct alignas(std::max_align_t) block_t
+        {
+            block_t *previous;
+            std::size_t size;
+        };
+
+        static char *align(char *p, std::size_t alignment)
+        {
+            auto address = reinterpret_cast<std::uintptr_t>(p);
+            return p + ((alignment - address % alignment) % alignment);
+        }
+
+        void *bump(std::size_t bytes, std::size_t alignment)
+        {
+            if( !m_current ) return nullptr;
+
+            char *p = align(m_current, alignment);
+            if( p > m_end || static_cast<std::size_t>(m_end - p) < bytes ) return nullptr;
+
+            m_used += static_cast<std::size_t>(p + bytes - m_current);
+            m_current = p + bytes;
+            return p;
+        }
+
+        block_t *allocate_block(std::size_t size)
+        {
+            auto *block = static_cast<block_t *>(m_upstream->allocate(size, alignof(std::max_align_t)));
+            block->previous = m_blocks;
+            block->size = size;
+
+            m_blocks = block;
+            m_reserved += size;
+            return block;
+        }
+
+        std::pmr::memory_resource *m_upstream;
+        std::size_t m_first_block_size;
+        std::size_t m_next_block_size;
+
+        block_t *m_blocks = nullptr;
+        char *m_current = nullptr;
+        char *m_end = nullptr;
+        char *m_initial = nullptr;
+        std::size_t m_initial_size = 0;
+
+        std::size_t m_used = 0;
+        std::size_t m_reserved = 0;
+    };
+
+    // Pool allocator
+    // ==============
+
+    // Size-class allocator for many small objects which are freed individually (strings, list
+    // and map nodes): requests up to 4 KiB are rounded up to a power of two and served from a
+    // free list of that size, which is refilled in chunks of 64 KiB. Larger requests go to the
+    // upstream resource. Memory is returned to the upstream resource by release() or the destructor.
+    class pool_resource : public std::pmr::memory_resource
+    {
+    public:
+        static constexpr std::size_t max_block_size = 4096;
+
+        // thread_safe = true locks a mutex per size class, otherwise use the pool from one thread only
+        explicit pool_resource(bool thread_safe = false, std::pmr::memory_resource *upstream = std::pmr::new_delete_resource()) :
+            m_upstream(upstream), m_thread_safe(thread_safe) { }
+
+        ~pool_resource() override { release(); }
+
+        pool_resource(const pool_resource &) = delete;
+        pool_resource &operator=(const pool_resource &) = delete;
+
+        void release()
+        {
+            for(auto &c : m_classes)
+            {
+                for(void *chunk : c.chunks)
+                    m_upstream->deallocate(chunk, chunk_size, alignof(std::max_align_t));
+
+                c.chunks.clear();
+                c.free = nullptr;
+            }
+        }
+
+        std::pmr::memory_resource *upstream_resource() const { return m_upstream; }
+
+    protected:
+        void *do_allocate(std::size_t bytes, std::size_t alignment) override
+        {
+            const std::size_t index = size_class(bytes, alignment);
+            if( index >= class_count ) return m_upstream->allocate(bytes, alignment);
+
+            auto &c = m_classes[index];
+            std::unique_lock<std::mutex> lock(c.mutex, std::defer_lock);
+            if( m_thread_safe ) lock.lock();
+
+            if( !c.free ) refill(c, min_block_size << index);
+
+            node_t *node = c.free;
+            c.free = node->next;
+            return node;
+        }
+
+        void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) override
+        {
+            const std::size_t index = size_class(bytes, alignment);
+            if( index >= class_count ) return m_upstream->deallocate(p, bytes, alignment);
+
+            auto &c = m_classes[index];
+            std::unique_lock<std::mutex> lock(c.mutex, std::defer_lock);
+            if( m_thread_safe ) lock.lock();
+
+            auto *node = static_cast<node_t *>(p);
+            node->next = c.free;
+            c.free = node;
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+
+    private:
+        static constexpr std::size_t min_block_size = 8;
+        static constexpr std::size_t class_count = 10;      // 8 bytes to 4 KiB
+        static constexpr std::size_t chunk_size = 64 << 10;
+
+        struct node_t { node_t *next; };
+
+        struct alignas(64) size_class_t
+        {
+            std::mutex mutex;
+            node_t *free = nullptr;
+            std::vector<void *> chunks;
+        };
+
+        // blocks of a class are aligned to their size (up to max_align_t), larger alignments go upstream
+        static std::size_t size_class(std::size_t bytes, std::size_t alignment)
+        {
+            if( alignment > alignof(std::max_align_t) ) return class_count;
+
+            std::size_t index = 0;
+            for(std::size_t size = std::max(bytes, alignment); (min_block_size << index) < size && index < class_count; ++index) { }
+
+            return index;
+        }
+
+        void refill(size_class_t &c, std::size_t block_size)
+        {
+            char *chunk = static_cast<char *>(m_upstream->allocate(chunk_size, alignof(std::max_align_t)));
+            c.chunks.push_back(chunk);
+
+            for(std::size_t offset = chunk_size; offset >= block_size; offset -= block_size)
+            {
+                auto *node = reinterpret_cast<node_t *>(chunk + offset - block_size);
+                node->next = c.free;
+                c.free = node;
+            }
+        }
+
+        std::pmr::memory_resource *m_upstream;
+        bool m_thread_safe;
+        std::array<size_class_t, class_count> m_classes;
+    };
+}
+
+#endif
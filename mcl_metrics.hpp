@@ -0,0 +1,426 @@
+#ifndef MCL_METRICS_HPP
+#define MCL_METRICS_HPP
+
+#if __cplusplus < 201703L
+#error "error: 'mcl_metrics.hpp' requires C++17!"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+#include "mcl_basic.hpp"
+#include "mcl_arithmetic.hpp"
+#include "mcl_tabular.hpp"
+
+namespace mc
+{
+    // Metric types
+    // ============
+    
+    enum class metric_type { counter, gauge, timer };
+    
+    inline const char *to_string(metric_type type)
+    {
+        static const char *names[] = { "counter", "gauge", "timer" };
+        return names[static_cast<std::size_t>(type)];
+    }
+    
+    // Counter for many threads: every thread adds to its own cache line (chosen by thread index),
+    // so an update is a single relaxed atomic add. Reading sums up all cells.
+    class metric_counter
+    {
+    public:
+        void add(std::int64_t n = 1) { m_cells[_thread_index() % cell_count].value.fetch_add(n, std::memory_order_relaxed); }
+        
+        metric_counter &operator++() { add(1); return *this; }
+        metric_counter &operator+=(std::int64_t n) { add(n); return *this; }
+        
+        std::int64_t value() const
+        {
+            std::int64_t sum = 0;
+            for(const auto &c : m_cells) sum += c.value.load(std::memory_order_relaxed);
+            return sum;
+        }
+        
+        // additions which happen at the same time may be lost
+        void reset() { for(auto &c : m_cells) c.value.store(0, std::memory_order_relaxed); }
+    
+    private:
+        static constexpr std::size_t cell_count = 16;
+        
+        struct alignas(64) cell
+        {
+            std::atomic<std::int64_t> value{0};
+        };
+        
+        cell m_cells[cell_count];
+    };
+    
+    // Current value of something, e.g. a queue length. The last set() wins.
+    class metric_gauge
+    {
+    public:
+        void set(double value) { m_value.store(value, std::memory_order_relaxed); }
+        
+        void add(double value)
+        {
+            auto old = m_value.load(std::memory_order_relaxed);
+            while( !m_value.compare_exchange_weak(old, old + value, std::memory_order_relaxed) ) { }
+        }
+        
+        double value() const { return m_value.load(std::memory_order_relaxed); }
+    
+    private:
+        alignas(64) std::atomic<double> m_value{0.0};
+    };
+    
+    // Distribution of durations, recorded into a concurrent_histogram (nanoseconds)
+    class metric_timer
+    {
+    public:
+        // records the time from its creation to its destruction
+        class scope
+        {
+        public:
+            explicit scope(metric_timer &timer) : m_timer(timer), m_start(std::chrono::steady_clock::now()) { }
+            ~scope() { m_timer.record(std::chrono::steady_clock::now() - m_start); }
+            
+            scope(const scope &) = delete;
+            scope &operator=(const scope &) = delete;
+        
+        private:
+            metric_timer &m_timer;
+            std::chrono::steady_clock::time_point m_start;
+        };
+        
+        template<class rep_t, class period_t>
+        void record(std::chrono::duration<rep_t, period_t> duration) { m_histogram.record(duration); }
+        
+        scope time() { return scope(*this); }
+        
+        log_histogram snapshot() const { return m_histogram.snapshot(); }
+    
+    private:
+        concurrent_histogram m_histogram;
+    };
+    
+    // Metrics registry
+    // ================
+    
+    struct metric_value
+    {
+        std::string name;
+        metric_type type;
+        double value = 0.0;         // value of counters and gauges, number of recorded timings
+        log_histogram timings;      // timers only, nanoseconds
+    };
+    
+    struct metrics_snapshot
+    {
+        std::chrono::steady_clock::time_point time;
+        std::chrono::system_clock::time_point wall_time;
+        std::vector<metric_value> values;               // in order of registration
+    };
+    
+    // Metrics are created on first use and live as long as the registry. Looking up a name
+    // takes a lock, so keep the returned reference for the hot path:
+    //     static auto &requests = mc::metrics::global().counter("requests");
+    //     ++requests;
+    class metrics
+    {
+    public:
+        metrics() = default;
+        metrics(const metrics &) = delete;
+        metrics &operator=(const metrics &) = delete;
+        
+        static metrics &global()
+        {
+            static metrics registry;
+            return registry;
+        }
+        
+        metric_counter &counter(const std::string &name) { return get(name, metric_type::counter, m_counters); }
+        metric_gauge &gauge(const std::string &name) { return get(name, metric_type::gauge, m_gauges); }
+        metric_timer &timer(const std::string &name) { return get(name, metric_type::timer, m_timers); }
+        
+        // may be taken while other threads update the metrics
+        metrics_snapshot snapshot() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            
+            metrics_snapshot result;
+            result.time = std::chrono::steady_clock::now();
+            result.wall_time = std::chrono::system_clock::now();
+            result.values.reserve(m_entries.size());
+            
+            for(const auto &e : m_entries)
+            {
+                metric_value value;
+                value.name = e.name;
+                value.type = e.type;
+                
+                switch(e.type)
+                {
+                    case metric_type::counter: value.value = static_cast<double>(m_counters[e.index].value()); break;
+                    case metric_type::gauge:   value.value = m_gauges[e.index].value(); break;
+                    case metric_type::timer:
+                        value.timings = m_timers[e.index].snapshot();
+                        value.value = static_cast<double>(value.timings.count());
+                        break;
+                }
+                
+                result.values.push_back(std::move(value));
+            }
+            
+            return result;
+        }
+    
+    private:
+        struct entry
+        {
+            std::string name;
+            metric_type type;
+            std::size_t index;
+        };
+        
+        // a deque never moves its elements, so references stay valid
+        template<class metric_t>
+        metric_t &get(const std::string &name, metric_type type, std::deque<metric_t> &storage)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            
+            auto it = m_index.find(name);
+            if( it != m_index.end() )
+            {
+                const auto &e = m_entries[it->second];
+                
+                if( e.type != type )
+                    throw std::runtime_error("metric '" + name + "' is already registered as " + to_string(e.type));
+                
+                return storage[e.index];
+            }
+            
+            storage.emplace_back();
+            m_index.emplace(name, m_entries.size());
+            m_entries.push_back(entry{ name, type, storage.size() - 1 });
+            
+            return storage.back();
+        }
+        
+        mutable std::mutex m_mutex;
+        std::vector<entry> m_entries;
+        std::unordered_map<std::string, std::size_t> m_index;
+        
+        std::deque<metric_counter> m_counters;
+        std::deque<metric_gauge> m_gauges;
+        std::deque<metric_timer> m_timers;
+    };
+    
+    // Metrics export
+    // ==============
+    
+    // Rates (per second) are computed against 'previous' if given
+    inline table to_table(const metrics_snapshot &snapshot, const metrics_snapshot *previous = nullptr)
+    {
+        table t;
+        auto &creator = t.create();
+        
+        creator("metric", "type", "value", "rate/s", "mean", "p50", "p99", "max")(horizontal_line('-'));
+        
+        double seconds = previous ? std::chrono::duration<double>(snapshot.time - previous->time).count() : 0.0;
+        
+        for(std::size_t i=0; i<snapshot.values.size(); ++i)
+        {
+            const auto &v = snapshot.values[i];
+            
+            // metrics are only ever added, so the same metric has the same position
+            std::string rate = "-";
+            if( seconds > 0.0 && v.type != metric_type::gauge && i < previous->values.size() )
+            {
+                rate.clear();
+                format_to(rate, (v.value - previous->values[i].value) / seconds);
+            }
+            
+            if( v.type == metric_type::timer && v.timings.count() > 0 )
+            {
+                auto format = [](double ns){ return _format_seconds(ns * 1e-9); };
+                
+                creator(v.name, to_string(v.type), v.value, rate, format(v.timings.mean()), format(v.timings.quantile(0.5)),
+                        format(v.timings.quantile(0.99)), format(static_cast<double>(v.timings.max())));
+            }
+            else
+                creator(v.name, to_string(v.type), v.value, rate, "-", "-", "-", "-");
+        }
+        
+        return t;
+    }
+    
+    // One row per metric, the header is only written into an empty file. Times are unix
+    // seconds, durations nanoseconds.
+    inline void export_metrics(tsv_writer &writer, const metrics_snapshot &snapshot)
+    {
+        if( writer.empty() )
+            writer.write_row("time", "metric", "type", "value", "mean", "p50", "p99", "max");
+        
+        double time = std::chrono::duration<double>(snapshot.wall_time.time_since_epoch()).count();
+        
+        for(const auto &v : snapshot.values)
+        {
+            if( v.type == metric_type::timer && v.timings.count() > 0 )
+                writer.write_row(time, v.name, to_string(v.type), v.value, v.timings.mean(), v.timings.quantile(0.5),
+                                 v.timings.quantile(0.99), v.timings.max());
+            else
+                writer.write_row(time, v.name, to_string(v.type), v.value, "", "", "", "");
+        }
+        
+        writer.flush();
+    }
+    
+    inline void export_metrics(const std::string &filename, const metrics_snapshot &snapshot)
+    {
+        tsv_writer writer(filename, '\t', tsv_writer::append);
+        export_metrics(writer, snapshot);
+    }
+    
+    // Background reporter
+    // ===================
+    
+    // Reports the metrics every 'interval' from a background thread. On a terminal the table is
+    // redrawn in place with ANSI cursor movement, otherwise every report is appended.
+    //     mc::metrics_reporter reporter(mc::metrics::global(), std::chrono::milliseconds(250));
+    //     reporter.export_tsv("metrics.tsv").start();
+    class metrics_reporter
+    {
+    public:
+        explicit metrics_reporter(metrics &registry = metrics::global(),
+                                  std::chrono::milliseconds interval = std::chrono::milliseconds(1000),
+                                  std::ostream &stream = std::cout) :
+            m_registry(registry), m_interval(interval), m_stream(stream), m_redraw(_is_terminal(stream)) { }
+        
+        ~metrics_reporter() { stop(); }
+        
+        metrics_reporter(const metrics_reporter &) = delete;
+        metrics_reporter &operator=(const metrics_reporter &) = delete;
+        
+        // every report is also appended to a tsv file
+        metrics_reporter &export_tsv(const std::string &filename)
+        {
+            std::lock_guard<std::mutex> lock(m_report_mutex);
+            m_tsv.reset(new tsv_writer(filename, '\t', tsv_writer::append));
+            return *this;
+        }
+        
+        metrics_reporter &set_redraw(bool redraw)
+        {
+            std::lock_guard<std::mutex> lock(m_report_mutex);
+            m_redraw = redraw;
+            return *this;
+        }
+        
+        void start()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if( m_thread.joinable() ) return;
+            
+            m_stop = false;
+            m_thread = std::thread([this]{ run(); });
+        }
+        
+        // stops the thread and writes a last report
+        void stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if( !m_thread.joinable() ) return;
+                m_stop = true;
+            }
+            
+            m_wake.notify_all();
+            m_thread.join();
+            
+            report();
+        }
+        
+        // writes a report immediately
+        void report()
+        {
+            std::lock_guard<std::mutex> lock(m_report_mutex);
+            
+            auto snapshot = m_registry.snapshot();
+            auto text = to_table(snapshot, m_has_previous ? &m_previous : nullptr).to_string();
+            
+            // move to the start of the last report and clear everything below
+            std::string output;
+            if( m_redraw && m_lines > 0 )
+                output = "\x1b[" + std::to_string(m_lines) + "F\x1b[J";
+            output += text;
+            
+            m_stream.write(output.data(), output.size());
+            m_stream.flush();
+            
+            m_lines = static_cast<std::size_t>(std::count(text.begin(), text.end(), '\n'));
+            
+            if( m_tsv ) export_metrics(*m_tsv, snapshot);
+            
+            m_previous = std::move(snapshot);
+            m_has_previous = true;
+        }
+    
+    private:
+        static bool _is_terminal(const std::ostream &stream)
+        {
+#if defined(__unix__) || defined(__APPLE__)
+            return &stream == &std::cout && ::isatty(STDOUT_FILENO);
+#else
+            (void)stream;
+            return false;
+#endif
+        }
+        
+        void run()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            
+            while( !m_wake.wait_for(lock, m_interval, [this]{ return m_stop; }) )
+            {
+                lock.unlock();
+                report();
+                lock.lock();
+            }
+        }
+        
+        metrics &m_registry;
+        std::chrono::milliseconds m_interval;
+        std::ostream &m_stream;
+        
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::thread m_thread;
+        bool m_stop = false;
+        
+        std::mutex m_report_mutex;
+        bool m_redraw;
+        std::size_t m_lines = 0;
+        std::unique_ptr<tsv_writer> m_tsv;
+        metrics_snapshot m_previous;
+        bool m_has_previous = false;
+    };
+}
+
+#endif
@@ -0,0 +1,855 @@
+#ifndef MCL_PARALLEL_HPP
+#define MCL_PARALLEL_HPP
+
+#if __cplusplus < 201703L
+#error "error: 'mcl_parallel.hpp' requires C++17!"
+#endif
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include <cctype>
+#include <chrono>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "mcl_basic.hpp"
+
+namespace mc
+{
+    // Tasks and work-stealing deques
+    // ==============================
+    
+    struct _task
+    {
+        virtual ~_task() = default;
+        virtual void run() = 0;     // must not throw, results and exceptions go into a future
+    };
+    
+    template<class function_t>
+    struct _function_task : _task
+    {
+        explicit _function_task(function_t &&f) : func(std::move(f)) { }
+        void run() override { func(); }
+        
+        function_t func;
+    };
+    
+    template<class function_t>
+    inline _task *_make_task(function_t &&func)
+    {
+        return new _function_task<std::decay_t<function_t>>(std::forward<function_t>(func));
+    }
+    
+    inline void _cpu_relax()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#else
+        std::this_thread::yield();
+#endif
+    }
+    
+    // Chase-Lev deque (in the C11 formulation of Le et al.): the owner pushes and takes at the
+    // bottom without locking, other threads steal from the top. The buffer grows on demand, old
+    // buffers are kept until destruction because a thief may still read from them.
+    class _work_stealing_deque
+    {
+    public:
+        _work_stealing_deque() { m_buffer.store(grow(nullptr, 0, 0), std::memory_order_relaxed); }
+        
+        ~_work_stealing_deque()
+        {
+            while( auto *task = take() ) delete task;
+        }
+        
+        _work_stealing_deque(const _work_stealing_deque &) = delete;
+        _work_stealing_deque &operator=(const _work_stealing_deque &) = delete;
+        
+        // owner only
+        void push(_task *task)
+        {
+            auto b = m_bottom.load(std::memory_order_relaxed);
+            auto t = m_top.load(std::memory_order_acquire);
+            auto *buffer = m_buffer.load(std::memory_order_relaxed);
+            
+            if( b - t > buffer->mask )
+            {
+                buffer = grow(buffer, t, b);
+                m_buffer.store(buffer, std::memory_order_release);
+            }
+            
+            buffer->at(b).store(task, std::memory_order_relaxed);
+            m_bottom.store(b + 1, std::memory_order_release);
+        }
+        
+        // owner only, newest task first
+        _task *take()
+        {
+            auto b = m_bottom.load(std::memory_order_relaxed) - 1;
+            auto *buffer = m_buffer.load(std::memory_order_relaxed);
+            m_bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            auto t = m_top.load(std::memory_order_relaxed);
+            
+            if( t > b )
+            {
+                m_bottom.store(b + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            
+            _task *task = buffer->at(b).load(std::memory_order_relaxed);
+            
+            // last task, race against the thieves
+            if( t == b )
+            {
+                if( !m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed) )
+                    task = nullptr;
+                
+                m_bottom.store(b + 1, std::memory_order_relaxed);
+            }
+            
+            return task;
+        }
+        
+        // any thread, oldest task first; nullptr if empty or if another thread won the race
+        _task *steal()
+        {
+            auto t = m_top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            auto b = m_bottom.load(std::memory_order_acquire);
+            
+            if( t >= b )
+                return nullptr;
+            
+            _task *task = m_buffer.load(std::memory_order_acquire)->at(t).load(std::memory_order_relaxed);
+            
+            if( !m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed) )
+                return nullptr;
+            
+            return task;
+        }
+        
+        bool empty() const
+        {
+            return m_bottom.load(std::memory_order_relaxed) <= m_top.load(std::memory_order_relaxed);
+        }
+    
+    private:
+        struct buffer_t
+        {
+            explicit buffer_t(std::int64_t capacity) : mask(capacity - 1), tasks(new std::atomic<_task *>[capacity]) { }
+            
+            std::atomic<_task *> &at(std::int64_t i) { return tasks[i & mask]; }
+            
+            std::int64_t mask;
+            std::unique_ptr<std::atomic<_task *>[]> tasks;
+        };
+        
+        buffer_t *grow(buffer_t *old, std::int64_t top, std::int64_t bottom)
+        {
+            auto buffer = std::make_unique<buffer_t>(old ? 2 * (old->mask + 1) : 64);
+            
+            for(auto i = top; i < bottom; ++i)
+                buffer->at(i).store(old->at(i).load(std::memory_order_relaxed), std::memory_order_relaxed);
+            
+            m_buffers.push_back(std::move(buffer));
+            return m_buffers.back().get();
+        }
+        
+        alignas(64) std::atomic<std::int64_t> m_top{0};
+        alignas(64) std::atomic<std::int64_t> m_bottom{0};
+        std::atomic<buffer_t *> m_buffer{nullptr};
+        std::vector<std::unique_ptr<buffer_t>> m_buffers;
+    };
+    
+    // Futures
+    // =======
+    
+    class thread_pool;
+    
+    inline void _schedule(thread_pool *pool, _task *task);
+    inline bool _is_worker(const thread_pool *pool);
+    inline bool _run_pending_task(thread_pool *pool);
+    
+    template<typename T>
+    struct _future_state
+    {
+        using stored_t = std::conditional_t<std::is_void<T>::value, bool, T>;
+        
+        template<class value_t>
+        void set_value(value_t &&v)
+        {
+            value.emplace(std::forward<value_t>(v));
+            finish();
+        }
+        
+        void set_error(std::exception_ptr e)
+        {
+            error = e;
+            finish();
+        }
+        
+        // the task is scheduled on the pool as soon as the state is ready
+        void on_ready(thread_pool *pool, _task *task)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                
+                if( !ready.load(std::memory_order_relaxed) )
+                {
+                    continuations.emplace_back(pool, task);
+                    return;
+                }
+            }
+            
+            _schedule(pool, task);
+        }
+        
+        void finish()
+        {
+            std::vector<std::pair<thread_pool *, _task *>> pending;
+            
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ready.store(true, std::memory_order_release);
+                pending.swap(continuations);
+            }
+            
+            condition.notify_all();
+            
+            for(auto &c : pending)
+                _schedule(c.first, c.second);
+        }
+        
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::atomic<bool> ready{false};
+        std::optional<stored_t> value;
+        std::exception_ptr error;
+        std::vector<std::pair<thread_pool *, _task *>> continuations;
+    };
+    
+    // stores the result of func() or the exception it throws
+    template<typename T, class function_t>
+    inline void _fulfill(_future_state<T> &state, function_t &func)
+    {
+        try
+        {
+            if constexpr( std::is_void<T>::value )
+            {
+                func();
+                state.set_value(true);
+            }
+            else
+                state.set_value(func());
+        }
+        catch(...)
+        {
+            state.set_error(std::current_exception());
+        }
+    }
+    
+    // Result of a task submitted to a thread_pool. Waiting on a worker thread of the pool runs
+    // other tasks in the meantime, so tasks can wait for tasks they submitted without deadlock.
+    template<typename T>
+    class future
+    {
+    public:
+        using value_type = T;
+        
+        future() = default;
+        future(std::shared_ptr<_future_state<T>> state, thread_pool *pool) : m_state(std::move(state)), m_pool(pool) { }
+        
+        bool valid() const { return m_state != nullptr; }
+        bool ready() const { return check_state().ready.load(std::memory_order_acquire); }
+        
+        void wait() const
+        {
+            auto &state = check_state();
+            auto is_ready = [&]{ return state.ready.load(std::memory_order_acquire); };
+            
+            if( _is_worker(m_pool) )
+            {
+                // the task may be queued behind this one, so the worker keeps running tasks
+                while( !is_ready() )
+                {
+                    if( _run_pending_task(m_pool) ) continue;
+                    
+                    std::unique_lock<std::mutex> lock(state.mutex);
+                    state.condition.wait_for(lock, std::chrono::microseconds(100), is_ready);
+                }
+            }
+            else
+            {
+                std::unique_lock<std::mutex> lock(state.mutex);
+                state.condition.wait(lock, is_ready);
+            }
+        }
+        
+        // waits and returns the result (moved out, so call it once) or rethrows the exception of the task
+        T get()
+        {
+            wait();
+            auto state = std::move(m_state);
+            
+            if( state->error )
+                std::rethrow_exception(state->error);
+            
+            if constexpr( !std::is_void<T>::value )
+                return std::move(*state->value);
+        }
+        
+        // Runs func(result) (func() for void) on the pool once the result is available and returns
+        // its future. An exception skips func and is passed on. The future is consumed.
+        template<class function_t>
+        auto then(function_t &&func)
+        {
+            using result_t = decltype(call(func, std::declval<_future_state<T> &>()));
+            
+            check_state();
+            auto state = std::move(m_state);
+            auto next = std::make_shared<_future_state<result_t>>();
+            
+            auto task = _make_task([state, next, func = std::forward<function_t>(func)]() mutable
+            {
+                if( state->error )
+                    next->set_error(state->error);
+                else
+                {
+                    auto bound = [&]() -> result_t { return call(func, *state); };
+                    _fulfill(*next, bound);
+                }
+            });
+            
+            state->on_ready(m_pool, task);
+            return future<result_t>(next, m_pool);
+        }
+    
+    private:
+        template<class function_t>
+        static decltype(auto) call(function_t &func, _future_state<T> &state)
+        {
+            if constexpr( std::is_void<T>::value )
+                return func();
+            else
+                return func(std::move(*state.value));
+        }
+        
+        _future_state<T> &check_state() const
+        {
+            if( !m_state )
+                throw std::runtime_error("future has no state!");
+            
+            return *m_state;
+        }
+        
+        std::shared_ptr<_future_state<T>> m_state;
+        thread_pool *m_pool = nullptr;
+    };
+    
+    template<class ... futures_t>
+    inline void wait_all(const futures_t & ... futures)
+    {
+        using expander = int[];
+        (void)expander{ 0, (futures.wait(), 0)... };
+    }
+    
+    template<typename T>
+    inline void wait_all(const std::vector<future<T>> &futures)
+    {
+        for(const auto &f : futures)
+            f.wait();
+    }
+    
+    // Thread pool
+    // ===========
+    
+    // none: the operating system places the workers; cores: worker i is pinned to the i-th allowed
+    // CPU; numa_nodes: workers are spread round robin over the NUMA nodes and may run on any CPU
+    // of their node. Pinning is only implemented on Linux and ignored elsewhere.
+    enum class thread_affinity { none, cores, numa_nodes };
+    
+    struct thread_pool_options
+    {
+        std::size_t threads = 0;                            // 0 = all cores
+        thread_affinity affinity = thread_affinity::none;
+        std::size_t spin_count = 1 << 12;                   // pause iterations before an idle worker sleeps
+    };
+    
+    // "0-3,8,10-11" -> { 0, 1, 2, 3, 8, 10, 11 }
+    inline std::vector<int> _parse_cpu_list(const std::string &list)
+    {
+        std::vector<int> cpus;
+        
+        std::istringstream stream(list);
+        std::string range;
+        
+        while( std::getline(stream, range, ',') )
+        {
+            if( range.empty() || !std::isdigit(static_cast<unsigned char>(range[0])) ) continue;
+            
+            auto dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            
+            for(int cpu = first; cpu <= last; ++cpu)
+                cpus.push_back(cpu);
+        }
+        
+        return cpus;
+    }
+    
+    // CPUs of every NUMA node which the process may use, one node with all CPUs if unknown
+    inline std::vector<std::vector<int>> _numa_nodes()
+    {
+        std::vector<std::vector<int>> nodes;
+
+#if defined(__linux__)
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        sched_getaffinity(0, sizeof(allowed), &allowed);
+        
+        for(int node = 0; ; ++node)
+        {
+            std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            std::string line;
+            
+            if( !file || !std::getline(file, line) ) break;
+            
+            std::vector<int> cpus;
+            for(int cpu : _parse_cpu_list(line))
+                if( cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed) ) cpus.push_back(cpu);
+            
+            if( !cpus.empty() ) nodes.push_back(std::move(cpus));
+        }
+        
+        if( nodes.empty() )
+        {
+            nodes.emplace_back();
+            for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+                if( CPU_ISSET(cpu, &allowed) ) nodes.back().push_back(cpu);
+        }
+#endif
+        
+        return nodes;
+    }
+    
+    inline void _pin_thread(std::thread &thread, const std::vector<int> &cpus)
+    {
+#if defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for(int cpu : cpus) CPU_SET(cpu, &set);
+        
+        pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+        (void)thread;
+        (void)cpus;
+#endif
+    }
+    
+    // Fixed number of workers, each with its own Chase-Lev deque. Tasks submitted by a worker go
+    // to its own deque (newest first), tasks from other threads to a shared queue. A worker
+    // without work steals the oldest task of a random other worker, spins for a while and then
+    // sleeps until a new task arrives. The destructor runs all remaining tasks.
+    class thread_pool
+    {
+    public:
+        explicit thread_pool(thread_pool_options options = thread_pool_options()) : m_spin_count(options.spin_count)
+        {
+            const std::size_t threads = options.threads == 0 ? _default_thread_count() : options.threads;
+            
+            for(std::size_t i = 0; i < threads; ++i)
+                m_workers.push_back(std::make_unique<worker_t>());
+            
+            auto nodes = options.affinity == thread_affinity::none ? std::vector<std::vector<int>>() : _numa_nodes();
+            std::vector<int> cores;
+            for(const auto &node : nodes) cores.insert(cores.end(), node.begin(), node.end());
+            
+            for(std::size_t i = 0; i < threads; ++i)
+            {
+                m_workers[i]->thread = std::thread([this, i]{ work(i); });
+                
+                if( options.affinity == thread_affinity::cores && !cores.empty() )
+                    _pin_thread(m_workers[i]->thread, { cores[i % cores.size()] });
+                else if( options.affinity == thread_affinity::numa_nodes && !nodes.empty() )
+                    _pin_thread(m_workers[i]->thread, nodes[i % nodes.size()]);
+            }
+        }
+        
+        explicit thread_pool(std::size_t threads) : thread_pool(thread_pool_options{ threads }) { }
+        
+        ~thread_pool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_sleep_mutex);
+                m_stop = true;
+                m_epoch.fetch_add(1);
+            }
+            
+            m_wake.notify_all();
+            
+            for(auto &w : m_workers)
+                w->thread.join();
+            
+            for(auto *task : m_queue) delete task;
+        }
+        
+        thread_pool(const thread_pool &) = delete;
+        thread_pool &operator=(const thread_pool &) = delete;
+        
+        // shared by the whole process, created on first use with one worker per core
+        static thread_pool &global()
+        {
+            static thread_pool pool;
+            return pool;
+        }
+        
+        std::size_t size() const { return m_workers.size(); }
+        
+        // index of the calling worker, or size() if the calling thread is not a worker of this pool
+        std::size_t worker_index() const
+        {
+            const auto &current = _current();
+            return current.first == this ? current.second : size();
+        }
+        
+        // runs func(args...) on a worker and returns its future
+        template<class function_t, class ... args_t>
+        auto submit(function_t &&func, args_t && ... args)
+        {
+            using result_t = std::invoke_result_t<std::decay_t<function_t>, std::decay_t<args_t>...>;
+            
+            auto state = std::make_shared<_future_state<result_t>>();
+            
+            post([state, func = std::forward<function_t>(func), arguments = std::make_tuple(std::forward<args_t>(args)...)]() mutable
+            {
+                auto bound = [&]() -> result_t { return std::apply(func, std::move(arguments)); };
+                _fulfill(*state, bound);
+            });
+            
+            return future<result_t>(state, this);
+        }
+        
+        // runs func() on a worker without a future, func must not throw
+        template<class function_t>
+        void post(function_t &&func)
+        {
+            push(_make_task(std::forward<function_t>(func)));
+        }
+        
+        void push(_task *task)
+        {
+            auto index = worker_index();
+            
+            if( index < size() )
+                m_workers[index]->tasks.push(task);
+            else
+            {
+                std::lock_guard<std::mutex> lock(m_queue_mutex);
+                m_queue.push_back(task);
+                m_queued.fetch_add(1, std::memory_order_relaxed);
+            }
+            
+            // a sleeping worker either sees the new epoch before waiting or is notified
+            m_epoch.fetch_add(1);
+            
+            if( m_sleeping.load() > 0 )
+            {
+                { std::lock_guard<std::mutex> lock(m_sleep_mutex); }
+                m_wake.notify_one();
+            }
+        }
+        
+        // runs one pending task on the calling thread, false if none was found
+        bool run_pending_task()
+        {
+            auto *task = find_task(worker_index());
+            if( !task ) return false;
+            
+            run(task);
+            return true;
+        }
+    
+    private:
+        struct worker_t
+        {
+            _work_stealing_deque tasks;
+            std::thread thread;
+        };
+        
+        static std::pair<const thread_pool *, std::size_t> &_current()
+        {
+            thread_local std::pair<const thread_pool *, std::size_t> current{ nullptr, 0 };
+            return current;
+        }
+        
+        static void run(_task *task)
+        {
+            task->run();
+            delete task;
+        }
+        
+        _task *find_task(std::size_t index)
+        {
+            if( index < size() )
+                if( auto *task = m_workers[index]->tasks.take() ) return task;
+            
+            if( m_queued.load(std::memory_order_relaxed) > 0 )
+            {
+                std::lock_guard<std::mutex> lock(m_queue_mutex);
+                
+                if( !m_queue.empty() )
+                {
+                    auto *task = m_queue.front();
+                    m_queue.pop_front();
+                    m_queued.fetch_sub(1, std::memory_order_relaxed);
+                    return task;
+                }
+            }
+            
+            // steal, starting at a random victim
+            thread_local std::uint32_t seed = static_cast<std::uint32_t>(_thread_index()) * 2654435761u + 1;
+            seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+            
+            const std::size_t n = size();
+            for(std::size_t k = 0, start = seed % n; k < n; ++k)
+            {
+                auto victim = (start + k) % n;
+                if( victim == index ) continue;
+                
+                // a failed steal may be a lost race, retry while the deque is not empty
+                while( !m_workers[victim]->tasks.empty() )
+                    if( auto *task = m_workers[victim]->tasks.steal() ) return task;
+            }
+            
+            return nullptr;
+        }
+        
+        void work(std::size_t index)
+        {
+            _current() = { this, index };
+            
+            while( true )
+            {
+                // read before searching, so a task pushed after the search changes the epoch
+                auto epoch = m_epoch.load();
+                
+                if( auto *task = find_task(index) )
+                {
+                    run(task);
+                    continue;
+                }
+                
+                std::size_t spins = 0;
+                while( spins < m_spin_count && m_epoch.load(std::memory_order_relaxed) == epoch )
+                {
+                    _cpu_relax();
+                    ++spins;
+                }
+                
+                if( spins < m_spin_count ) continue;
+                
+                std::unique_lock<std::mutex> lock(m_sleep_mutex);
+                
+                if( m_stop ) break;
+                
+                m_sleeping.fetch_add(1);
+                m_wake.wait(lock, [&]{ return m_epoch.load() != epoch || m_stop; });
+                m_sleeping.fetch_sub(1);
+            }
+        }
+        
+        std::vector<std::unique_ptr<worker_t>> m_workers;
+        std::size_t m_spin_count;
+        
+        std::mutex m_queue_mutex;
+        std::deque<_task *> m_queue;
+        std::atomic<std::size_t> m_queued{0};
+        
+        alignas(64) std::atomic<std::uint64_t> m_epoch{0};
+        std::atomic<std::size_t> m_sleeping{0};
+        std::mutex m_sleep_mutex;
+        std::condition_variable m_wake;
+        bool m_stop = false;
+    };
+    
+    inline void _schedule(thread_pool *pool, _task *task)
+    {
+        (pool ? *pool : thread_pool::global()).push(task);
+    }
+    
+    inline bool _is_worker(const thread_pool *pool) { return pool && pool->worker_index() < pool->size(); }
+    
+    inline bool _run_pending_task(thread_pool *pool) { return pool->run_pending_task(); }
+    
+    // mc::par algorithms, parallel_for/parallel_reduce and tsv_reader (see _run_tasks) share the 
+    // global pool instead of starting threads on every call
+    inline void _launch_on_global_pool(std::size_t count, const std::function<void()> &helper)
+    {
+        auto &pool = thread_pool::global();
+        for(std::size_t i = 0; i < count; ++i)
+            pool.post(std::function<void()>(helper));
+    }
+    
+    inline const bool _global_pool_launcher = (_launch_helpers() = &_launch_on_global_pool, true);
+    
+    // Task graph
+    // ==========
+    
+    // Tasks with dependencies, e.g. stages of a pipeline. A task starts as soon as all tasks it
+    // depends on have finished, independent tasks run in parallel. If a task throws, the tasks
+    // which have not started yet are skipped and the future of run() rethrows the first exception.
+    // The graph must not be modified or destroyed while it runs, but it can be run again.
+    class task_graph
+    {
+    public:
+        using node = std::size_t;
+        
+        template<class function_t>
+        node add(function_t &&func, std::initializer_list<node> dependencies = {})
+        {
+            m_nodes.emplace_back();
+            m_nodes.back().func = std::forward<function_t>(func);
+            
+            const node id = m_nodes.size() - 1;
+            for(auto d : dependencies) precede(d, id);
+            
+            return id;
+        }
+        
+        // 'after' starts when 'before' has finished
+        void precede(node before, node after)
+        {
+            if( before >= m_nodes.size() || after >= m_nodes.size() )
+                throw std::runtime_error("task graph node does not exist!");
+            
+            m_nodes[before].successors.push_back(after);
+            m_nodes[after].dependencies += 1;
+        }
+        
+        std::size_t size() const { return m_nodes.size(); }
+        
+        future<void> run(thread_pool &pool = thread_pool::global())
+        {
+            check_acyclic();
+            
+            auto state = std::make_shared<run_state>();
+            state->remaining = m_nodes.size();
+            
+            if( m_nodes.empty() )
+                state->done.set_value(true);
+            
+            for(auto &n : m_nodes)
+                n.pending.store(n.dependencies, std::memory_order_relaxed);
+            
+            for(node id = 0; id < m_nodes.size(); ++id)
+                if( m_nodes[id].dependencies == 0 ) schedule(pool, state, id);
+            
+            return future<void>(std::shared_ptr<_future_state<void>>(state, &state->done), &pool);
+        }
+        
+        void run_and_wait(thread_pool &pool = thread_pool::global()) { run(pool).get(); }
+    
+    private:
+        struct node_t
+        {
+            std::function<void()> func;
+            std::vector<node> successors;
+            std::size_t dependencies = 0;
+            std::atomic<std::size_t> pending{0};
+        };
+        
+        struct run_state
+        {
+            _future_state<void> done;
+            std::atomic<std::size_t> remaining{0};
+            std::atomic<bool> failed{false};
+            std::exception_ptr error;
+        };
+        
+        void schedule(thread_pool &pool, const std::shared_ptr<run_state> &state, node id)
+        {
+            pool.post([this, &pool, state, id]
+            {
+                auto &n = m_nodes[id];
+                
+                if( !state->failed.load(std::memory_order_acquire) )
+                {
+                    try
+                    {
+                        n.func();
+                    }
+                    catch(...)
+                    {
+                        if( !state->failed.exchange(true) ) state->error = std::current_exception();
+                    }
+                }
+                
+                for(auto s : n.successors)
+                    if( m_nodes[s].pending.fetch_sub(1, std::memory_order_acq_rel) == 1 ) schedule(pool, state, s);
+                
+                if( state->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1 )
+                {
+                    if( state->failed.load() ) state->done.set_error(state->error);
+                    else state->done.set_value(true);
+                }
+            });
+        }
+        
+        // Kahn's algorithm, a cycle would never finish
+        void check_acyclic() const
+        {
+            std::vector<std::size_t> pending(m_nodes.size());
+            std::vector<node> ready;
+            
+            for(node id = 0; id < m_nodes.size(); ++id)
+            {
+                pending[id] = m_nodes[id].dependencies;
+                if( pending[id] == 0 ) ready.push_back(id);
+            }
+            
+            std::size_t visited = 0;
+            while( !ready.empty() )
+            {
+                auto id = ready.back();
+                ready.pop_back();
+                ++visited;
+                
+                for(auto s : m_nodes[id].successors)
+                    if( --pending[s] == 0 ) ready.push_back(s);
+            }
+            
+            if( visited != m_nodes.size() )
+                throw std::runtime_error("task graph contains a cycle!");
+        }
+        
+        std::deque<node_t> m_nodes;
+    };
+}
+
+#endif
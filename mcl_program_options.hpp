@@ -10,6 +10,12 @@
 #include <map>
 #include <algorithm>
 #include <type_traits>
+#include <unordered_map>
+#include <deque>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
 
 #if __cplusplus >= 201703L
 #include <optional>
@@ -23,51 +29,54 @@ template<typename T> using optional = std::experimental::optional<T>;
 
 namespace mc
 {
+    // Simple queries
+    // ==============
+    
+    // These functions scan argv on every call, for many options or validation use mc::options
+    
     inline bool option_exists(const std::string &option, int argc, char ** argv)
     {
-        std::vector<std::string> args;
-        args.assign(argv+1, argv+argc);
+        for(int i=1; i<argc; ++i)
+            if( option == argv[i] )
+                return true;
         
-        return std::find(args.begin(), args.end(), option) != args.end();
+        return false;
     }
     
     template<typename T>
-    inline optional<std::vector<T>> option_get_values(std::string option, int argc, char ** argv,
-                                                      std::vector<std::string> option_markers = {"-", "--"})
+    inline optional<std::vector<T>> option_get_values(const std::string &option, int argc, char ** argv,
+                                                      const std::vector<std::string> &option_markers = {"-", "--"})
     {        
         // check if an argument starts with one of the option markers
-        auto has_marker = [&](std::string arg)
+        auto has_marker = [&](const char *arg)
         {
-            for(auto marker : option_markers)
+            for(const auto &marker : option_markers)
             {
-                if( arg.substr(0, marker.size()) == marker )
+                if( std::strncmp(arg, marker.c_str(), marker.size()) == 0 )
                     return true;
             }
             return false;
         };
         
-        // fill options
-        std::vector<std::string> args;
-        args.assign(argv+1, argv+argc);
+        int found = 1;
+        while( found < argc && option != argv[found] ) ++found;
         
-        auto found = std::find(args.begin(), args.end(), option);
+        if( found == argc ) return optional<std::vector<T>>();
         
-        if( found == args.end() ) return optional<std::vector<T>>();
-        
-        // fill map
+        // fill values
         std::vector<T> values;
         
-        for(auto it=found+1; it != args.end() && !has_marker(*it); ++it)
+        for(int i=found+1; i<argc && !has_marker(argv[i]); ++i)
         {
-            values.push_back(convert<T>(*it));
+            values.push_back(convert<T>(argv[i]));
         }
         
-        return optional<std::vector<T>>(values);
+        return optional<std::vector<T>>(std::move(values));
     }
     
     template<typename T>
-    inline optional<T> option_get_value(std::string option, int argc, char ** argv,
-                                        std::vector<std::string> option_markers = {"-", "--"})
+    inline optional<T> option_get_value(const std::string &option, int argc, char ** argv,
+                                        const std::vector<std::string> &option_markers = {"-", "--"})
     {
         auto vec = option_get_values<T>(option, argc, argv, option_markers);
         
@@ -76,6 +85,428 @@ namespace mc
         else
             return optional<T>();
     }
+    
+    // Schema based parser
+    // ===================
+    
+    template<typename T>
+    inline void _validate_option(const std::string &value) { (void)convert<T>(value); }
+    
+    template<typename T>
+    inline const char *_option_type_name()
+    {
+        return std::is_same<T, bool>::value ? "bool" : std::is_integral<T>::value ? "int" : 
+               std::is_floating_point<T>::value ? "number" : "string";
+    }
+    
+    // Levenshtein distance, used to suggest an option for a typo
+    inline std::size_t _edit_distance(const std::string &a, const std::string &b)
+    {
+        std::vector<std::size_t> row(b.size() + 1);
+        for(std::size_t j=0; j<=b.size(); ++j) row[j] = j;
+        
+        for(std::size_t i=1; i<=a.size(); ++i)
+        {
+            std::size_t diagonal = row[0];
+            row[0] = i;
+            
+            for(std::size_t j=1; j<=b.size(); ++j)
+            {
+                const std::size_t above = row[j];
+                row[j] = std::min({ row[j] + 1, row[j-1] + 1, diagonal + (a[i-1] == b[j-1] ? 0 : 1) });
+                diagonal = above;
+            }
+        }
+        
+        return row[b.size()];
+    }
+    
+    // Declare all options, then parse argv once into an index:
+    //
+    //   mc::options opts("tool", "Processes some data");
+    //   opts.add<int>("size,s", "number of elements").default_value(10).env("TOOL_SIZE");
+    //   opts.add<std::string>("input,i", "input file").required();
+    //   opts.add<double>("weight,w", "weights").repeated();
+    //   opts.add_flag("verbose,v", "more output");
+    //   opts.parse(argc, argv);
+    //
+    // Accepted forms are '--size 10', '--size=10', '-s 10', '-s10' and bundled short flags 
+    // '-vq'. Repeated options may be given several times and also take all following values 
+    // up to the next option ('--weight 1 2 3'). '--' ends the options, everything which is not 
+    // an option or its value is positional. Unknown options, missing required options and 
+    // values which cannot be converted throw std::runtime_error. The value of an option is 
+    // taken from the command line, else its environment variable, else a config file, else 
+    // its default.
+    class options
+    {
+    public:
+        class option
+        {
+        public:
+            template<typename T>
+            option &default_value(const T &value)
+            {
+                std::string buffer;
+                format_to(buffer, value, _exact_format());
+                
+                m_default = buffer;
+                m_has_default = true;
+                return *this;
+            }
+            
+            option &required(bool enable = true) { m_required = enable; return *this; }
+            option &repeated(bool enable = true) { m_repeated = enable; return *this; }
+            
+            // environment variable, for repeated options the values are separated by ','
+            option &env(const std::string &variable) { m_env = variable; return *this; }
+            
+        private:
+            friend class options;
+            
+            std::string m_name;
+            char m_short = 0;
+            std::string m_help;
+            std::string m_type;
+            std::string m_default;
+            std::string m_env;
+            bool m_has_default = false;
+            bool m_required = false;
+            bool m_repeated = false;
+            bool m_flag = false;
+            void (*m_validate)(const std::string &) = nullptr;
+            
+            std::vector<std::string> m_values;
+            int m_source = -1;      // priority of the source of m_values, -1 = not given
+        };
+        
+        explicit options(const std::string &program = "", const std::string &description = "") : 
+            m_program(program), m_description(description)
+        {
+            add_flag("help,h", "show this help");
+        }
+        
+        // 'name' is the long name with an optional short name: "size" or "size,s"
+        template<typename T>
+        option &add(const std::string &name, const std::string &help = "")
+        {
+            auto &o = add_option(name, help);
+            o.m_type = _option_type_name<T>();
+            o.m_validate = &_validate_option<T>;
+            return o;
+        }
+        
+        option &add_flag(const std::string &name, const std::string &help = "")
+        {
+            auto &o = add<bool>(name, help);
+            o.m_flag = true;
+            return o;
+        }
+        
+        // 'key = value' lines, '#' starts a comment, keys are long names without dashes. 
+        // Must be called before parse(), which checks required options.
+        void parse_config_file(const std::string &filename)
+        {
+            std::ifstream file(filename);
+            
+            if( !file )
+                throw std::runtime_error("could not open file '" + filename + "'");
+            
+            std::string line;
+            for(std::size_t number = 1; std::getline(file, line); ++number)
+            {
+                line = _trim(line.substr(0, line.find('#')));
+                if( line.empty() ) continue;
+                
+                const auto separator = line.find('=');
+                const auto key = _trim(line.substr(0, separator));
+                const auto it = m_index.find("--" + key);
+                
+                if( separator == std::string::npos || it == m_index.end() )
+                    throw std::runtime_error(filename + ":" + std::to_string(number) + ": unknown option '" + key + "'");
+                
+                assign(m_options[it->second], _trim(line.substr(separator + 1)), source_config);
+            }
+        }
+        
+        void parse(int argc, char ** argv)
+        {
+            bool only_positional = false;
+            
+            for(int i=1; i<argc; ++i)
+            {
+                const std::string token = argv[i];
+                
+                if( only_positional || token.size() < 2 || token[0] != '-' || _is_number(token) )
+                {
+                    m_positional.push_back(token);
+                }
+                else if( token == "--" )
+                {
+                    only_positional = true;
+                }
+                else if( token[1] == '-' )
+                {
+                    const auto equals = token.find('=');
+                    auto &o = lookup(token.substr(0, equals));
+                    
+                    if( equals != std::string::npos )
+                        assign(o, token.substr(equals + 1), source_command_line);
+                    else
+                        i = take_values(o, argc, argv, i);
+                }
+                else
+                {
+                    // bundled short options, an option with a value ends the bundle
+                    for(std::size_t c=1; c<token.size(); ++c)
+                    {
+                        auto &o = lookup(std::string("-") + token[c]);
+                        
+                        if( o.m_flag )
+                            assign(o, "true", source_command_line);
+                        else if( c + 1 < token.size() )
+                        {
+                            assign(o, token.substr(c + 1), source_command_line);
+                            break;
+                        }
+                        else
+                            i = take_values(o, argc, argv, i);
+                    }
+                }
+            }
+            
+            for(auto &o : m_options)
+            {
+                if( o.m_env.empty() ) continue;
+                
+                if( const char *value = std::getenv(o.m_env.c_str()) )
+                {
+                    std::string values = value;
+                    std::size_t first = 0;
+                    
+                    for(auto comma = values.find(','); o.m_repeated && comma != std::string::npos; comma = values.find(',', first))
+                    {
+                        assign(o, values.substr(first, comma - first), source_env);
+                        first = comma + 1;
+                    }
+                    
+                    assign(o, values.substr(first), source_env);
+                }
+            }
+            
+            if( help_requested() ) return;
+            
+            for(const auto &o : m_options)
+                if( o.m_required && o.m_values.empty() )
+                    throw std::runtime_error("missing required option '--" + o.m_name + "'");
+        }
+        
+        bool help_requested() const { return has("help"); }
+        
+        // given on the command line, in the environment or in a config file (defaults do not count)
+        bool has(const std::string &name) const { return !find(name).m_values.empty(); }
+        
+        std::size_t count(const std::string &name) const { return find(name).m_values.size(); }
+        
+        // value of the option, or its default (throws if there is neither)
+        template<typename T>
+        T get(const std::string &name) const
+        {
+            const auto &o = find(name);
+            
+            if( !o.m_values.empty() ) return convert<T>(o.m_values.back());
+            if( o.m_has_default ) return convert<T>(o.m_default);
+            if( o.m_flag ) return convert<T>("false");
+            
+            throw std::runtime_error("option '--" + o.m_name + "' has no value");
+        }
+        
+        template<typename T>
+        optional<T> get_optional(const std::string &name) const
+        {
+            const auto &o = find(name);
+            
+            if( o.m_values.empty() && !o.m_has_default ) return optional<T>();
+            return optional<T>(get<T>(name));
+        }
+        
+        // all values of a repeated option (the default if none is given)
+        template<typename T>
+        std::vector<T> get_all(const std::string &name) const
+        {
+            const auto &o = find(name);
+            std::vector<T> result;
+            
+            for(const auto &value : o.m_values) result.push_back(convert<T>(value));
+            if( result.empty() && o.m_has_default ) result.push_back(convert<T>(o.m_default));
+            
+            return result;
+        }
+        
+        const std::vector<std::string> &positional() const { return m_positional; }
+        
+        std::string help() const
+        {
+            std::vector<std::pair<std::string, std::string>> lines;
+            std::size_t width = 0;
+            
+            for(const auto &o : m_options)
+            {
+                std::string left = o.m_short ? std::string("-") + o.m_short + ", " : "    ";
+                left += "--" + o.m_name;
+                if( !o.m_flag ) left += " <" + o.m_type + ">";
+                if( o.m_repeated ) left += "...";
+                
+                std::string right = o.m_help;
+                std::string details;
+                if( o.m_required ) details += "required";
+                if( o.m_has_default ) details += (details.empty() ? "" : ", ") + std::string("default: ") + o.m_default;
+                if( !o.m_env.empty() ) details += (details.empty() ? "" : ", ") + std::string("env: ") + o.m_env;
+                if( !details.empty() ) right += (right.empty() ? "(" : " (") + details + ")";
+                
+                width = std::max(width, left.size());
+                lines.emplace_back(left, right);
+            }
+            
+            std::string result = "usage: " + (m_program.empty() ? std::string("program") : m_program) + " [options]";
+            result += m_positional_help.empty() ? "\n" : " " + m_positional_help + "\n";
+            if( !m_description.empty() ) result += "\n" + m_description + "\n";
+            result += "\noptions:\n";
+            
+            for(const auto &line : lines)
+                result += "  " + line.first + std::string(width - line.first.size() + 2, ' ') + line.second + "\n";
+            
+            return result;
+        }
+        
+        // shown in the usage line of help(), e.g. "<files>..."
+        void positional_help(const std::string &text) { m_positional_help = text; }
+        
+    private:
+        enum { source_config = 0, source_env = 1, source_command_line = 2 };
+        
+        static std::string _trim(const std::string &str)
+        {
+            const auto first = str.find_first_not_of(" \t\r\n");
+            if( first == std::string::npos ) return "";
+            return str.substr(first, str.find_last_not_of(" \t\r\n") - first + 1);
+        }
+        
+        static bool _is_number(const std::string &token)
+        {
+            return token.size() > 1 && token[0] == '-' && (std::isdigit(static_cast<unsigned char>(token[1])) || token[1] == '.');
+        }
+        
+        option &add_option(const std::string &name, const std::string &help)
+        {
+            const auto comma = name.find(',');
+            
+            m_options.emplace_back();
+            auto &o = m_options.back();
+            o.m_name = name.substr(0, comma);
+            o.m_help = help;
+            
+            if( comma != std::string::npos && comma + 2 == name.size() )
+                o.m_short = name[comma + 1];
+            
+            if( !m_index.emplace("--" + o.m_name, m_options.size() - 1).second ||
+                (o.m_short && !m_index.emplace(std::string("-") + o.m_short, m_options.size() - 1).second) )
+                throw std::runtime_error("option '" + name + "' is declared twice");
+            
+            return o;
+        }
+        
+        option &lookup(const std::string &token)
+        {
+            auto it = m_index.find(token);
+            
+            if( it != m_index.end() ) 
+                return m_options[it->second];
+            
+            std::string message = "unknown option '" + token + "'";
+            std::size_t best = 3;
+            
+            for(const auto &o : m_options)
+            {
+                auto distance = _edit_distance(token, "--" + o.m_name);
+                if( distance < best )
+                {
+                    best = distance;
+                    message = "unknown option '" + token + "', did you mean '--" + o.m_name + "'?";
+                }
+            }
+            
+            throw std::runtime_error(message);
+        }
+        
+        const option &find(const std::string &name) const
+        {
+            const auto stripped = name.substr(std::min(name.find_first_not_of('-'), name.size()));
+            auto it = m_index.find(stripped.size() == 1 ? "-" + stripped : "--" + stripped);
+            
+            if( it == m_index.end() )
+                throw std::runtime_error("option '" + name + "' is not declared");
+            
+            return m_options[it->second];
+        }
+        
+        // values of a higher priority source replace the others, repeated options collect all values
+        void assign(option &o, const std::string &value, int source)
+        {
+            if( o.m_validate )
+            {
+                try { o.m_validate(value); }
+                catch(const std::exception &)
+                {
+                    throw std::runtime_error("invalid value '" + value + "' for option '--" + o.m_name + "' (expected " + o.m_type + ")");
+                }
+            }
+            
+            if( source < o.m_source )
+                return;
+            
+            if( source > o.m_source || !o.m_repeated )
+                o.m_values.clear();
+            
+            o.m_values.push_back(value);
+            o.m_source = source;
+        }
+        
+        // a token which parse() would read as a declared option, negative numbers are values
+        bool is_declared_option(const std::string &token) const
+        {
+            if( token.size() < 2 || token[0] != '-' || _is_number(token) )
+                return false;
+            
+            return m_index.count(token[1] == '-' ? token.substr(0, token.find('=')) : token.substr(0, 2)) > 0;
+        }
+        
+        // values following argv[i], returns the index of the last consumed argument
+        int take_values(option &o, int argc, char ** argv, int i)
+        {
+            if( o.m_flag )
+            {
+                assign(o, "true", source_command_line);
+                return i;
+            }
+            
+            if( i + 1 >= argc || is_declared_option(argv[i+1]) )
+                throw std::runtime_error("missing value for option '--" + o.m_name + "'");
+            
+            assign(o, argv[++i], source_command_line);
+            
+            while( o.m_repeated && i + 1 < argc && (argv[i+1][0] != '-' || _is_number(argv[i+1])) )
+                assign(o, argv[++i], source_command_line);
+            
+            return i;
+        }
+        
+        std::string m_program;
+        std::string m_description;
+        std::string m_positional_help;
+        std::deque<option> m_options;       // stable references for the fluent interface
+        std::unordered_map<std::string, std::size_t> m_index;
+        std::vector<std::string> m_positional;
+    };
 }   
 
 #endif // MCL_PROGRAM_OPTIONS_HPP_INCLUDED
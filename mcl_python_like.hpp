@@ -6,131 +6,754 @@
 #endif
 
 #include <tuple>
+#include <iterator>
+#include <utility>
+#include <type_traits>
+#include <algorithm>
+#include <cstddef>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <stdexcept>
+
+#include "mcl_basic.hpp"
 
 namespace mc
 {
-    // Thanks to: http://reedbeta.com/blog/python-like-enumerate-in-cpp17
+    // Zip
+    // ===
+    
+    // Element of a zipped range: a tuple of references into the zipped ranges. Assigning to it 
+    // assigns the referenced elements, swapping it swaps them, so algorithms like std::sort 
+    // reorder all ranges together. Conversion to value_type copies the elements.
+    template<class ... references_t>
+    class zip_reference : public std::tuple<references_t...>
+    {
+    public:
+        using base_type = std::tuple<references_t...>;
+        using value_type = std::tuple<std::decay_t<references_t>...>;
+        
+        using base_type::base_type;
+        zip_reference(const zip_reference &) = default;
+        
+        const zip_reference &operator=(const zip_reference &other) const { assign(other, indices()); return *this; }
+        const zip_reference &operator=(const value_type &other) const { assign(other, indices()); return *this; }
+        const zip_reference &operator=(value_type &&other) const { assign(std::move(other), indices()); return *this; }
+        
+        operator value_type() const { return value_type(base()); }
+        
+        friend void swap(const zip_reference &a, const zip_reference &b) { a.swap_elements(b, indices()); }
+        
+    private:
+        using indices = std::index_sequence_for<references_t...>;
+        
+        // the referenced elements are not part of the (const) proxy
+        base_type &base() const { return const_cast<base_type &>(static_cast<const base_type &>(*this)); }
+        
+        template<class tuple_t, std::size_t ... I>
+        void assign(tuple_t &&other, std::index_sequence<I...>) const
+        {
+            ((std::get<I>(base()) = std::get<I>(std::forward<tuple_t>(other))), ...);
+        }
+        
+        template<std::size_t ... I>
+        void swap_elements(const zip_reference &other, std::index_sequence<I...>) const
+        {
+            using std::swap;
+            (swap(std::get<I>(base()), std::get<I>(other.base())), ...);
+        }
+    };
     
-    template<typename iterable_t,
-             typename iter_t = decltype(std::begin(std::declval<iterable_t>())),
-             typename = decltype(std::end(std::declval<iterable_t>()))>
-    constexpr auto enumerate( iterable_t && iterable)
+    // Iterator over several ranges at once with the weakest category of all of them. With random 
+    // access all iterators move together, so the first one is enough to compare positions.
+    template<class ... iterators_t>
+    class zip_iterator
     {
-        struct iterator
+    public:
+        using iterator_category = std::common_type_t<typename std::iterator_traits<iterators_t>::iterator_category...>;
+        using value_type = std::tuple<typename std::iterator_traits<iterators_t>::value_type...>;
+        using reference = zip_reference<typename std::iterator_traits<iterators_t>::reference...>;
+        using difference_type = std::common_type_t<typename std::iterator_traits<iterators_t>::difference_type...>;
+        using pointer = void;
+        
+        zip_iterator() = default;
+        explicit zip_iterator(iterators_t ... iterators) : m_iterators(iterators...) { }
+        
+        const std::tuple<iterators_t...> &iterators() const { return m_iterators; }
+        
+        reference operator*() const { return std::apply([](const auto & ... it){ return reference(*it...); }, m_iterators); }
+        reference operator[](difference_type n) const { return *(*this + n); }
+        
+        zip_iterator &operator++() { std::apply([](auto & ... it){ (++it, ...); }, m_iterators); return *this; }
+        zip_iterator &operator--() { std::apply([](auto & ... it){ (--it, ...); }, m_iterators); return *this; }
+        zip_iterator operator++(int) { auto old = *this; ++*this; return old; }
+        zip_iterator operator--(int) { auto old = *this; --*this; return old; }
+        
+        zip_iterator &operator+=(difference_type n) { std::apply([n](auto & ... it){ ((it += n), ...); }, m_iterators); return *this; }
+        zip_iterator &operator-=(difference_type n) { return *this += -n; }
+        
+        friend zip_iterator operator+(zip_iterator it, difference_type n) { return it += n; }
+        friend zip_iterator operator+(difference_type n, zip_iterator it) { return it += n; }
+        friend zip_iterator operator-(zip_iterator it, difference_type n) { return it -= n; }
+        
+        friend difference_type operator-(const zip_iterator &a, const zip_iterator &b) 
+        { 
+            return std::get<0>(a.m_iterators) - std::get<0>(b.m_iterators); 
+        }
+        
+        // without random access the end of the shortest range ends the iteration
+        friend bool operator==(const zip_iterator &a, const zip_iterator &b)
         {
-            std::size_t i;
-            iter_t iter;
-            bool operator != (const iterator & other) const { return iter != other.iter; }
-            void operator ++ () { ++i; ++iter; }
-            auto operator *  () const { return std::tie(i, *iter); }
-        };
+            if constexpr( std::is_base_of<std::random_access_iterator_tag, iterator_category>::value )
+                return std::get<0>(a.m_iterators) == std::get<0>(b.m_iterators);
+            else
+                return any_equal(a, b, std::index_sequence_for<iterators_t...>());
+        }
+        
+        friend bool operator!=(const zip_iterator &a, const zip_iterator &b) { return !(a == b); }
+        friend bool operator<(const zip_iterator &a, const zip_iterator &b) { return a - b < 0; }
+        friend bool operator>(const zip_iterator &a, const zip_iterator &b) { return b < a; }
+        friend bool operator<=(const zip_iterator &a, const zip_iterator &b) { return !(b < a); }
+        friend bool operator>=(const zip_iterator &a, const zip_iterator &b) { return !(a < b); }
         
-        struct iterable_wrapper
+    private:
+        template<std::size_t ... I>
+        static bool any_equal(const zip_iterator &a, const zip_iterator &b, std::index_sequence<I...>)
         {
-            iterable_t iterable;
-            auto begin() { return iterator{ 0, std::begin(iterable) }; }
-            auto end() { return iterator{ 0, std::end(iterable) }; }
-        };
+            return ((std::get<I>(a.m_iterators) == std::get<I>(b.m_iterators)) || ...);
+        }
         
-        return iterable_wrapper{ std::forward<iterable_t>(iterable) };
+        std::tuple<iterators_t...> m_iterators;
+    };
+    
+    template<class range_t>
+    auto _range_size(const range_t &range, int) -> decltype(static_cast<std::size_t>(range.size()))
+    {
+        return static_cast<std::size_t>(range.size());
     }
     
-    // TODO const qualifiers on operator* ??
+    template<class range_t>
+    std::size_t _range_size(const range_t &range, long)
+    {
+        return static_cast<std::size_t>(std::distance(std::begin(range), std::end(range)));
+    }
     
-    // zip (inspired by above)
-    template<class ... iterable_types>
-    constexpr auto zip( iterable_types && ... types )
+    // Zipped ranges, lvalues are referenced and rvalues are moved into the view. The view ends 
+    // with the shortest range.
+    template<class ... ranges_t>
+    class zip_view
     {
-        struct zip_iterator
+    public:
+        explicit zip_view(ranges_t && ... ranges) : m_ranges(std::forward<ranges_t>(ranges)...) { }
+        
+        auto begin() { return make_begin(m_ranges); }
+        auto end() { return make_end(m_ranges); }
+        auto begin() const { return make_begin(m_ranges); }
+        auto end() const { return make_end(m_ranges); }
+        
+        std::size_t size() const 
+        { 
+            return std::apply([](const auto & ... r){ return std::min({ _range_size(r, 0)... }); }, m_ranges); 
+        }
+        
+        bool empty() const { return size() == 0; }
+        
+    private:
+        template<class tuple_t>
+        static auto make_begin(tuple_t &ranges)
         {
-            using it_tuple_t = decltype(std::make_tuple(std::begin(types)...));
-            using val_tuple_t = decltype(std::make_tuple((*std::begin(types))...));
-            it_tuple_t iterator_tuple; 
-            
-            bool operator != (const zip_iterator & other) const 
-            { 
-                return iterator_tuple != other.iterator_tuple;
-            }
-            
-            void operator ++ () 
-            { 
-                std::apply([&](auto & ... it){ std::make_tuple(++it...); }, iterator_tuple); 
-            }
-            
-            auto operator *  ()
-            {
-                return std::apply([&](auto ... it){ return  std::make_tuple(*it...); }, iterator_tuple);
-            }
-        };
+            return std::apply([](auto & ... r){ return zip_iterator<decltype(std::begin(r))...>(std::begin(r)...); }, ranges);
+        }
         
-        struct iterable_wrapper
+        template<class tuple_t>
+        static auto make_end(tuple_t &ranges)
         {
-            decltype(std::make_tuple(types...)) iterable_tuple;
-            
-            auto begin() 
-            {                
-                return zip_iterator{ std::apply([](auto & ... args){ return std::make_tuple(std::begin(args)...); }, iterable_tuple) };
-            }
+            using iterator_t = decltype(make_begin(ranges));
             
-            auto end()
+            if constexpr( std::is_base_of<std::random_access_iterator_tag, typename iterator_t::iterator_category>::value )
             {
-                return zip_iterator{ std::apply([](auto & ... args){ return std::make_tuple(std::end(args)...); }, iterable_tuple) };
+                auto n = std::apply([](const auto & ... r){ return std::min({ static_cast<std::ptrdiff_t>(std::end(r) - std::begin(r))... }); }, ranges);
+                return make_begin(ranges) + n;
             }
-        };
+            else
+                return std::apply([](auto & ... r){ return iterator_t(std::end(r)...); }, ranges);
+        }
         
-        return iterable_wrapper{ std::forward_as_tuple(types...) };
+        std::tuple<ranges_t...> m_ranges;
+    };
+    
+    template<class ... iterable_types>
+    constexpr auto zip( iterable_types && ... types )
+    {
+        return zip_view<iterable_types...>(std::forward<iterable_types>(types)...);
+    }
+    
+    // Enumerate
+    // =========
+    
+    // Thanks to: http://reedbeta.com/blog/python-like-enumerate-in-cpp17
+    
+    template<class reference_t>
+    auto _enumerate_element(std::size_t i, reference_t &&element, std::false_type /*zipped*/)
+    {
+        return std::tuple<std::size_t, reference_t>(i, std::forward<reference_t>(element));
+    }
+    
+    // elements of zipped ranges are flattened: (i, a, b, ...)
+    template<class ... references_t>
+    auto _enumerate_element(std::size_t i, const zip_reference<references_t...> &element, std::true_type /*zipped*/)
+    {
+        return std::tuple_cat(std::tuple<std::size_t>(i), static_cast<const std::tuple<references_t...> &>(element));
     }
+    
+    template<class T>
+    struct _is_zip_reference : std::false_type { };
+    
+    template<class ... references_t>
+    struct _is_zip_reference<zip_reference<references_t...>> : std::true_type { };
+    
+    // The index is part of the iterator and moves with it, so a range which is split (e.g. by 
+    // mc::parallel_for) still yields the global index.
+    template<class iterator_t>
+    class enumerate_iterator
+    {
+    public:
+        using iterator_category = typename std::iterator_traits<iterator_t>::iterator_category;
+        using reference = decltype(_enumerate_element(0, *std::declval<const iterator_t &>(), 
+                                                      _is_zip_reference<std::decay_t<decltype(*std::declval<const iterator_t &>())>>()));
+        using value_type = reference;
+        using difference_type = typename std::iterator_traits<iterator_t>::difference_type;
+        using pointer = void;
+        
+        enumerate_iterator() = default;
+        enumerate_iterator(std::size_t index, iterator_t iterator) : m_index(index), m_iterator(iterator) { }
+        
+        std::size_t index() const { return m_index; }
+        const iterator_t &base() const { return m_iterator; }
+        
+        reference operator*() const 
+        { 
+            return _enumerate_element(m_index, *m_iterator, _is_zip_reference<std::decay_t<decltype(*m_iterator)>>()); 
+        }
+        
+        reference operator[](difference_type n) const { return *(*this + n); }
+        
+        enumerate_iterator &operator++() { ++m_index; ++m_iterator; return *this; }
+        enumerate_iterator &operator--() { --m_index; --m_iterator; return *this; }
+        enumerate_iterator operator++(int) { auto old = *this; ++*this; return old; }
+        enumerate_iterator operator--(int) { auto old = *this; --*this; return old; }
+        
+        enumerate_iterator &operator+=(difference_type n) { m_index += n; m_iterator += n; return *this; }
+        enumerate_iterator &operator-=(difference_type n) { return *this += -n; }
+        
+        friend enumerate_iterator operator+(enumerate_iterator it, difference_type n) { return it += n; }
+        friend enumerate_iterator operator+(difference_type n, enumerate_iterator it) { return it += n; }
+        friend enumerate_iterator operator-(enumerate_iterator it, difference_type n) { return it -= n; }
+        friend difference_type operator-(const enumerate_iterator &a, const enumerate_iterator &b) { return a.m_iterator - b.m_iterator; }
+        
+        friend bool operator==(const enumerate_iterator &a, const enumerate_iterator &b) { return a.m_iterator == b.m_iterator; }
+        friend bool operator!=(const enumerate_iterator &a, const enumerate_iterator &b) { return !(a == b); }
+        friend bool operator<(const enumerate_iterator &a, const enumerate_iterator &b) { return a.m_iterator < b.m_iterator; }
+        friend bool operator>(const enumerate_iterator &a, const enumerate_iterator &b) { return b < a; }
+        friend bool operator<=(const enumerate_iterator &a, const enumerate_iterator &b) { return !(b < a); }
+        friend bool operator>=(const enumerate_iterator &a, const enumerate_iterator &b) { return !(a < b); }
+        
+    private:
+        std::size_t m_index = 0;
+        iterator_t m_iterator;
+    };
+    
+    // lvalues are referenced and rvalues are moved into the view, as for mc::zip
+    template<class range_t>
+    class enumerate_view
+    {
+    public:
+        explicit enumerate_view(range_t &&range) : m_range(std::forward<range_t>(range)) { }
+        
+        auto begin() { return make_begin(m_range); }
+        auto end() { return make_end(m_range); }
+        auto begin() const { return make_begin(m_range); }
+        auto end() const { return make_end(m_range); }
+        
+        std::size_t size() const { return _range_size(m_range, 0); }
+        bool empty() const { return size() == 0; }
         
-    // Somehow code copy... not good, but easiest solution
+    private:
+        template<class stored_t>
+        static auto make_begin(stored_t &range)
+        {
+            return enumerate_iterator<decltype(std::begin(range))>(0, std::begin(range));
+        }
+        
+        // the index of end() is only known with random access (and not needed otherwise)
+        template<class stored_t>
+        static auto make_end(stored_t &range)
+        {
+            using iterator_t = decltype(std::begin(range));
+            
+            if constexpr( std::is_base_of<std::random_access_iterator_tag, typename std::iterator_traits<iterator_t>::iterator_category>::value )
+                return enumerate_iterator<iterator_t>(static_cast<std::size_t>(std::end(range) - std::begin(range)), std::end(range));
+            else
+                return enumerate_iterator<iterator_t>(0, std::end(range));
+        }
         
+        range_t m_range;
+    };
+    
+    template<class iterable_t>
+    constexpr auto enumerate( iterable_t && iterable )
+    {
+        return enumerate_view<iterable_t>(std::forward<iterable_t>(iterable));
+    }
+    
     template<class ... iterable_types>
     constexpr auto zip_enumerate( iterable_types && ... types )
     {
-        struct zip_en_iterator
+        return enumerate(zip(std::forward<iterable_types>(types)...));
+    }
+    
+    // Chunks, strides and windows
+    // ===========================
+    
+    // Part of a range, nothing is copied
+    template<class iterator_t>
+    class subrange
+    {
+    public:
+        using iterator = iterator_t;
+        using value_type = typename std::iterator_traits<iterator_t>::value_type;
+        using reference = typename std::iterator_traits<iterator_t>::reference;
+        
+        subrange() = default;
+        subrange(iterator_t begin, iterator_t end) : m_begin(begin), m_end(end) { }
+        
+        iterator_t begin() const { return m_begin; }
+        iterator_t end() const { return m_end; }
+        
+        std::size_t size() const { return static_cast<std::size_t>(std::distance(m_begin, m_end)); }
+        bool empty() const { return m_begin == m_end; }
+        
+        reference operator[](std::size_t i) const { return m_begin[i]; }
+        reference front() const { return *m_begin; }
+        
+    private:
+        iterator_t m_begin;
+        iterator_t m_end;
+    };
+    
+    template<class iterator_t>
+    using _is_random_access = std::is_base_of<std::random_access_iterator_tag, typename std::iterator_traits<iterator_t>::iterator_category>;
+    
+    // advances by up to n steps, but not past 'end'
+    template<class iterator_t, class difference_t>
+    iterator_t _bounded_advance(iterator_t it, const iterator_t end, difference_t n)
+    {
+        if constexpr( _is_random_access<iterator_t>::value )
+            return end - it < n ? end : it + n;
+        else
         {
-            std::size_t i;
-            using it_tuple_t = decltype(std::make_tuple(std::begin(types)...));
-            using val_tuple_t = decltype(std::make_tuple((*std::begin(types))...));
-            it_tuple_t iterator_tuple; 
+            for(; n > 0 && it != end; --n) ++it;
+            return it;
+        }
+    }
+    
+    // Every step-th element (subranges = false) or consecutive subranges of 'step' elements (subranges = true), 
+    // the last subrange may be shorter. Random access if the underlying range is.
+    template<class iterator_t, bool subranges>
+    class stride_iterator
+    {
+    public:
+        using iterator_category = std::conditional_t<_is_random_access<iterator_t>::value, std::random_access_iterator_tag, std::forward_iterator_tag>;
+        using value_type = std::conditional_t<subranges, subrange<iterator_t>, typename std::iterator_traits<iterator_t>::value_type>;
+        using reference = std::conditional_t<subranges, subrange<iterator_t>, typename std::iterator_traits<iterator_t>::reference>;
+        using difference_type = typename std::iterator_traits<iterator_t>::difference_type;
+        using pointer = void;
+        
+        stride_iterator() = default;
+        stride_iterator(iterator_t begin, iterator_t current, iterator_t end, difference_type step) : 
+            m_begin(begin), m_current(current), m_end(end), m_step(step) { }
+        
+        reference operator*() const 
+        { 
+            if constexpr( subranges )
+                return subrange<iterator_t>(m_current, _bounded_advance(m_current, m_end, m_step));
+            else
+                return *m_current;
+        }
+        
+        reference operator[](difference_type n) const { return *(*this + n); }
+        
+        stride_iterator &operator++() { m_current = _bounded_advance(m_current, m_end, m_step); return *this; }
+        stride_iterator operator++(int) { auto old = *this; ++*this; return old; }
+        stride_iterator &operator--() { return *this += -1; }
+        stride_iterator operator--(int) { auto old = *this; --*this; return old; }
+        
+        // the position is the number of steps from the beginning
+        stride_iterator &operator+=(difference_type n) 
+        { 
+            auto position = std::min((index() + n) * m_step, m_end - m_begin);
+            m_current = m_begin + position;
+            return *this; 
+        }
+        
+        stride_iterator &operator-=(difference_type n) { return *this += -n; }
+        
+        friend stride_iterator operator+(stride_iterator it, difference_type n) { return it += n; }
+        friend stride_iterator operator+(difference_type n, stride_iterator it) { return it += n; }
+        friend stride_iterator operator-(stride_iterator it, difference_type n) { return it -= n; }
+        friend difference_type operator-(const stride_iterator &a, const stride_iterator &b) { return a.index() - b.index(); }
+        
+        friend bool operator==(const stride_iterator &a, const stride_iterator &b) { return a.m_current == b.m_current; }
+        friend bool operator!=(const stride_iterator &a, const stride_iterator &b) { return !(a == b); }
+        friend bool operator<(const stride_iterator &a, const stride_iterator &b) { return a.m_current < b.m_current; }
+        friend bool operator>(const stride_iterator &a, const stride_iterator &b) { return b < a; }
+        friend bool operator<=(const stride_iterator &a, const stride_iterator &b) { return !(b < a); }
+        friend bool operator>=(const stride_iterator &a, const stride_iterator &b) { return !(a < b); }
+        
+    private:
+        difference_type index() const { return (m_current - m_begin + m_step - 1) / m_step; }
+        
+        iterator_t m_begin;
+        iterator_t m_current;
+        iterator_t m_end;
+        difference_type m_step = 1;
+    };
+    
+    // All windows of 'size' consecutive elements, the window moves by one element per step
+    template<class iterator_t>
+    class window_iterator
+    {
+    public:
+        using iterator_category = std::conditional_t<_is_random_access<iterator_t>::value, std::random_access_iterator_tag, std::forward_iterator_tag>;
+        using value_type = subrange<iterator_t>;
+        using reference = subrange<iterator_t>;
+        using difference_type = typename std::iterator_traits<iterator_t>::difference_type;
+        using pointer = void;
+        
+        window_iterator() = default;
+        window_iterator(iterator_t first, iterator_t last) : m_first(first), m_last(last) { }
+        
+        reference operator*() const { return subrange<iterator_t>(m_first, std::next(m_last)); }
+        reference operator[](difference_type n) const { return *(*this + n); }
+        
+        window_iterator &operator++() { ++m_first; ++m_last; return *this; }
+        window_iterator operator++(int) { auto old = *this; ++*this; return old; }
+        window_iterator &operator--() { --m_first; --m_last; return *this; }
+        window_iterator operator--(int) { auto old = *this; --*this; return old; }
+        window_iterator &operator+=(difference_type n) { m_first += n; m_last += n; return *this; }
+        window_iterator &operator-=(difference_type n) { return *this += -n; }
+        
+        friend window_iterator operator+(window_iterator it, difference_type n) { return it += n; }
+        friend window_iterator operator+(difference_type n, window_iterator it) { return it += n; }
+        friend window_iterator operator-(window_iterator it, difference_type n) { return it -= n; }
+        friend difference_type operator-(const window_iterator &a, const window_iterator &b) { return a.m_first - b.m_first; }
+        
+        friend bool operator==(const window_iterator &a, const window_iterator &b) { return a.m_first == b.m_first; }
+        friend bool operator!=(const window_iterator &a, const window_iterator &b) { return !(a == b); }
+        friend bool operator<(const window_iterator &a, const window_iterator &b) { return a.m_first < b.m_first; }
+        friend bool operator>(const window_iterator &a, const window_iterator &b) { return b < a; }
+        friend bool operator<=(const window_iterator &a, const window_iterator &b) { return !(b < a); }
+        friend bool operator>=(const window_iterator &a, const window_iterator &b) { return !(a < b); }
+        
+    private:
+        iterator_t m_first;
+        iterator_t m_last;
+    };
+    
+    struct _chunks_tag { };
+    struct _stride_tag { };
+    struct _windows_tag { };
+    
+    // lvalues are referenced and rvalues are moved into the view, as for mc::zip
+    template<class range_t, class kind_t>
+    class step_view
+    {
+    public:
+        step_view(range_t &&range, std::size_t step) : m_range(std::forward<range_t>(range)), m_step(step)
+        {
+            if( step == 0 )
+                throw std::runtime_error("chunk, stride and window sizes must be positive");
+        }
+        
+        auto begin() { return make(m_range, m_step, false); }
+        auto end() { return make(m_range, m_step, true); }
+        auto begin() const { return make(m_range, m_step, false); }
+        auto end() const { return make(m_range, m_step, true); }
+        
+        std::size_t size() const 
+        { 
+            const std::size_t n = _range_size(m_range, 0);
             
-            bool operator != (const zip_en_iterator & other) const 
-            { 
-                return iterator_tuple != other.iterator_tuple;
-            }
+            if constexpr( std::is_same<kind_t, _windows_tag>::value )
+                return n >= m_step ? n - m_step + 1 : 0;
+            else
+                return (n + m_step - 1) / m_step;
+        }
+        
+        bool empty() const { return size() == 0; }
+        
+    private:
+        template<class stored_t>
+        static auto make(stored_t &range, std::size_t step, bool at_end)
+        {
+            using iterator_t = decltype(std::begin(range));
+            using difference_t = typename std::iterator_traits<iterator_t>::difference_type;
             
-            void operator ++ () 
-            { 
-                ++i;
-                std::apply([&](auto & ... it){ std::make_tuple(++it...); }, iterator_tuple); 
+            if constexpr( std::is_same<kind_t, _windows_tag>::value )
+            {
+                const auto n = std::distance(std::begin(range), std::end(range));
+                const auto count = n >= static_cast<difference_t>(step) ? n - static_cast<difference_t>(step) + 1 : 0;
+                
+                // 'last' is the last element of the window, so the end iterator stays within the range
+                auto first = std::next(std::begin(range), at_end ? count : 0);
+                auto last = count > 0 ? std::next(first, static_cast<difference_t>(step) - 1) : std::end(range);
+                
+                return window_iterator<iterator_t>(first, last);
             }
-            
-            auto operator *  ()
+            else
             {
-                auto val_tup = std::apply([&](auto ... it){ return  std::make_tuple(*it...); }, iterator_tuple);
-                auto i_tup = std::make_tuple(i);
-                return std::tuple_cat(i_tup, val_tup);
+                auto first = at_end ? std::end(range) : std::begin(range);
+                return stride_iterator<iterator_t, std::is_same<kind_t, _chunks_tag>::value>(std::begin(range), first, std::end(range), static_cast<difference_t>(step));
             }
-        };
+        }
         
-        struct iterable_wrapper
+        range_t m_range;
+        std::size_t m_step;
+    };
+    
+    // consecutive subranges of 'size' elements, the last one may be shorter
+    template<class iterable_t>
+    auto chunks( iterable_t && iterable, std::size_t size )
+    {
+        return step_view<iterable_t, _chunks_tag>(std::forward<iterable_t>(iterable), size);
+    }
+    
+    // every step-th element, starting with the first
+    template<class iterable_t>
+    auto stride( iterable_t && iterable, std::size_t step )
+    {
+        return step_view<iterable_t, _stride_tag>(std::forward<iterable_t>(iterable), step);
+    }
+    
+    // all overlapping subranges of 'size' consecutive elements
+    template<class iterable_t>
+    auto windows( iterable_t && iterable, std::size_t size )
+    {
+        return step_view<iterable_t, _windows_tag>(std::forward<iterable_t>(iterable), size);
+    }
+    
+    // Parallel loops
+    // ==============
+    
+    // Elements which are tuples (enumerate, zip) are passed unpacked, unless the function takes the tuple
+    template<class function_t, class element_t>
+    inline void _invoke_element(function_t &func, element_t &&element)
+    {
+        if constexpr( std::is_invocable<function_t &, element_t>::value )
+            func(std::forward<element_t>(element));
+        else
+            std::apply(func, std::forward<element_t>(element));
+    }
+    
+    template<class function_t, class accumulator_t, class element_t>
+    inline void _invoke_element(function_t &func, accumulator_t &accumulator, element_t &&element)
+    {
+        if constexpr( std::is_invocable<function_t &, accumulator_t &, element_t>::value )
+            func(accumulator, std::forward<element_t>(element));
+        else
+            std::apply([&](auto && ... values){ func(accumulator, std::forward<decltype(values)>(values)...); }, std::forward<element_t>(element));
+    }
+    
+    struct _parallel_plan
+    {
+        std::size_t threads;
+        std::size_t grain;
+    };
+    
+    // grain 0: about 16 chunks per thread
+    inline _parallel_plan _plan_parallel(std::size_t n, std::size_t threads, std::size_t grain)
+    {
+        if( threads == 0 ) threads = _default_thread_count();
+        if( grain == 0 ) grain = std::max<std::size_t>(n / (threads * 16), 1);
+        
+        threads = std::max<std::size_t>(std::min(threads, (n + grain - 1) / grain), 1);
+        return _parallel_plan{ threads, grain };
+    }
+    
+    struct alignas(64) _work_range
+    {
+        std::mutex mutex;
+        std::size_t begin = 0;
+        std::size_t end = 0;
+    };
+    
+    // Calls func(begin, end, worker) for chunks of 'grain' indices of [0, n). Every worker starts 
+    // with an equal share and takes chunks from its front, a worker without work steals half of 
+    // the remaining indices of another worker from the back.
+    template<class function_t>
+    inline void _parallel_chunks(std::size_t n, const _parallel_plan &plan, function_t func)
+    {
+        if( n == 0 ) return;
+        
+        if( plan.threads == 1 )
         {
-            decltype(std::make_tuple(types...)) iterable_tuple;
-            
-            auto begin() 
-            {                
-                return zip_en_iterator{ 0, std::apply([](auto & ... args){ return std::make_tuple(std::begin(args)...); }, iterable_tuple) };
-            }
+            for(std::size_t begin = 0; begin < n; begin += plan.grain)
+                func(begin, std::min(begin + plan.grain, n), std::size_t(0));
+            return;
+        }
+        
+        std::unique_ptr<_work_range[]> ranges(new _work_range[plan.threads]);
+        for(std::size_t t=0; t<plan.threads; ++t)
+        {
+            ranges[t].begin = n * t / plan.threads;
+            ranges[t].end = n * (t + 1) / plan.threads;
+        }
+        
+        std::atomic<bool> failed{false};
+        
+        _run_tasks(plan.threads, plan.threads, [&](std::size_t worker)
+        {
+            auto &own = ranges[worker];
             
-            auto end()
+            while( !failed.load(std::memory_order_relaxed) )
             {
-                return zip_en_iterator{ 0, std::apply([](auto & ... args){ return std::make_tuple(std::end(args)...); }, iterable_tuple) };
+                std::size_t begin, end;
+                {
+                    std::lock_guard<std::mutex> lock(own.mutex);
+                    begin = own.begin;
+                    end = std::min(begin + plan.grain, own.end);
+                    own.begin = end;
+                }
+                
+                if( begin < end )
+                {
+                    try 
+                    { 
+                        func(begin, end, worker); 
+                    }
+                    catch(...) 
+                    { 
+                        failed = true; 
+                        throw; 
+                    }
+                    continue;
+                }
+                
+                // steal from the others, starting with the next worker
+                bool stolen = false;
+                for(std::size_t k=1; k<plan.threads && !stolen; ++k)
+                {
+                    auto &victim = ranges[(worker + k) % plan.threads];
+                    std::lock_guard<std::mutex> lock(victim.mutex);
+                    
+                    std::size_t remaining = victim.end - victim.begin;
+                    if( remaining == 0 ) continue;
+                    
+                    std::size_t take = remaining <= plan.grain ? remaining : remaining / 2;
+                    begin = victim.end - take;
+                    end = victim.end;
+                    victim.end = begin;
+                    stolen = true;
+                }
+                
+                if( !stolen ) break;
+                
+                std::lock_guard<std::mutex> lock(own.mutex);
+                own.begin = begin;
+                own.end = end;
             }
-        };
+        });
+    }
+    
+    template<class range_t>
+    inline auto _random_access_begin(range_t &range)
+    {
+        auto begin = std::begin(range);
         
-        return iterable_wrapper{ std::forward_as_tuple(types...) };
+        static_assert(std::is_base_of<std::random_access_iterator_tag, typename std::iterator_traits<decltype(begin)>::iterator_category>::value,
+                      "parallel loops require random access ranges");
+        
+        return begin;
+    }
+    
+    // Calls func for every element of a random access range, e.g. mc::enumerate(v) or mc::zip(a, b),
+    // in parallel. Tuples are unpacked: func(i, x) or func(a, b), unless func takes the tuple. 
+    // Chunks of 'grain' elements (0 = automatic) are balanced by work stealing.
+    template<class range_t, class function_t>
+    inline void parallel_for(const parallel_policy &policy, range_t &&range, function_t func)
+    {
+        auto begin = _random_access_begin(range);
+        const std::size_t n = static_cast<std::size_t>(std::end(range) - begin);
+        
+        auto plan = _plan_parallel(n, n < policy.threshold ? 1 : policy.threads, policy.block_size);
+        
+        _parallel_chunks(n, plan, [&](std::size_t first, std::size_t last, std::size_t)
+        {
+            auto it = begin + first;
+            for(std::size_t i = first; i < last; ++i, ++it)
+                _invoke_element(func, *it);
+        });
+    }
+    
+    template<class range_t, class function_t>
+    inline void parallel_for(range_t &&range, function_t func, std::size_t grain = 0)
+    {
+        parallel_policy policy;
+        policy.threshold = 0;
+        policy.block_size = grain;
+        
+        parallel_for(policy, std::forward<range_t>(range), func);
+    }
+    
+    // Every worker accumulates into its own copy of 'identity' with func(accumulator, element...), 
+    // the copies are combined with combine(a, b) in worker order. Which elements a worker 
+    // processes depends on the scheduling, so floating point results may differ in the last bits.
+    template<class range_t, class value_t, class function_t, class combine_t>
+    inline value_t parallel_reduce(const parallel_policy &policy, range_t &&range, value_t identity, function_t func, combine_t combine)
+    {
+        auto begin = _random_access_begin(range);
+        const std::size_t n = static_cast<std::size_t>(std::end(range) - begin);
+        
+        auto plan = _plan_parallel(n, n < policy.threshold ? 1 : policy.threads, policy.block_size);
+        
+        struct alignas(64) slot { value_t value; };
+        std::vector<slot> partial(plan.threads, slot{ identity });
+        
+        _parallel_chunks(n, plan, [&](std::size_t first, std::size_t last, std::size_t worker)
+        {
+            auto &accumulator = partial[worker].value;
+            auto it = begin + first;
+            
+            for(std::size_t i = first; i < last; ++i, ++it)
+                _invoke_element(func, accumulator, *it);
+        });
+        
+        value_t result = std::move(partial[0].value);
+        for(std::size_t t=1; t<partial.size(); ++t)
+            result = combine(std::move(result), std::move(partial[t].value));
+        
+        return result;
+    }
+    
+    template<class range_t, class value_t, class function_t, class combine_t>
+    inline value_t parallel_reduce(range_t &&range, value_t identity, function_t func, combine_t combine, std::size_t grain = 0)
+    {
+        parallel_policy policy;
+        policy.threshold = 0;
+        policy.block_size = grain;
+        
+        return parallel_reduce(policy, std::forward<range_t>(range), std::move(identity), func, combine);
     }
 }
 
-
+namespace std
+{
+    template<class ... references_t>
+    struct tuple_size<mc::zip_reference<references_t...>> : std::integral_constant<std::size_t, sizeof...(references_t)> { };
+    
+    template<std::size_t I, class ... references_t>
+    struct tuple_element<I, mc::zip_reference<references_t...>> { using type = std::tuple_element_t<I, std::tuple<references_t...>>; };
+}
 
 #endif
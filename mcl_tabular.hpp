@@ -12,11 +12,53 @@
 #include <numeric>
 #include <vector>
 #include <list>
+#include <deque>
+#include <cstdio>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+#if __cplusplus >= 201703L
+#include <charconv>
+#endif
+
+// polymorphic allocators for mc::table(resource), as in mcl_basic.hpp
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define MCL_HAS_PMR
+#endif
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+#include "mcl_basic.hpp"
 
 namespace mc
 {    
     typedef std::vector<std::string> row_t;
     
+#if defined(MCL_HAS_PMR)
+    namespace pmr
+    {
+        // rows whose cells are allocated from a memory resource, e.g. an mc::arena
+        using row_t = std::pmr::vector<std::pmr::string>;
+    }
+    
+    // rows of mc::table, allocated from the resource passed to the table
+    using _table_row_t = pmr::row_t;
+    using _table_rows_t = std::pmr::deque<pmr::row_t>;
+#else
+    using _table_row_t = row_t;
+    using _table_rows_t = std::deque<row_t>;
+#endif
+    
     struct horizontal_line
     {
         horizontal_line(char c = '-') : m_char(c) { }
@@ -24,45 +66,186 @@ namespace mc
         std::size_t position;
     };
     
+    // Table rendering
+    // ===============
+    
+    struct _table_style
+    {
+        std::string vertical_delimiter{"|"};
+        std::string padding{" "};
+        bool left_border = false;
+        bool right_border = false;
+        
+        std::size_t row_length(const std::vector<std::size_t> &widths) const
+        {
+            if( widths.empty() ) return 0;
+            
+            std::size_t length = std::accumulate(widths.begin(), widths.end(), std::size_t(0));
+            length += 2 * widths.size() * padding.size();
+            length += (widths.size() - 1) * vertical_delimiter.size();
+            
+            if( left_border )  length += vertical_delimiter.size();
+            if( right_border ) length += vertical_delimiter.size();
+            
+            return length;
+        }
+        
+        // cells which are wider than their column are not cut, missing cells are empty
+        template<class row_type>
+        void render_row(std::string &out, const row_type &row, const std::vector<std::size_t> &widths) const
+        {
+            static const std::string empty;
+            
+            begin_row(out);
+            
+            for(std::size_t i=0; i<widths.size(); ++i)
+            {
+                if( i < row.size() ) render_cell(out, row[i], widths[i], false, i + 1 == widths.size());
+                else render_cell(out, empty, widths[i], false, i + 1 == widths.size());
+            }
+            
+            end_row(out);
+        }
+        
+        void begin_row(std::string &out) const { if( left_border ) out += vertical_delimiter; }
+        
+        template<class string_t>
+        void render_cell(std::string &out, const string_t &cell, std::size_t width, bool align_right, bool last) const
+        {
+            std::size_t fill = cell.size() < width ? width - cell.size() : 0;
+            
+            out += padding;
+            if( align_right ) out.append(fill, ' ');
+            out += cell;
+            if( !align_right ) out.append(fill, ' ');
+            out += padding;
+            
+            if( !last ) out += vertical_delimiter;
+        }
+        
+        void end_row(std::string &out) const
+        {
+            if( right_border ) out += vertical_delimiter;
+            out += '\n';
+        }
+        
+        void render_line(std::string &out, char c, const std::vector<std::size_t> &widths) const
+        {
+            out.append(row_length(widths), c);
+            out += '\n';
+        }
+    };
+    
+    // Collects output and writes it to a stream or file descriptor in large chunks
+    class _output_buffer
+    {
+    public:
+        explicit _output_buffer(std::ostream &stream, std::size_t capacity = 1 << 16) : m_stream(&stream), m_capacity(capacity) 
+        { 
+            m_buffer.reserve(capacity + 1024); 
+        }
+        
+#if defined(__unix__) || defined(__APPLE__)
+        explicit _output_buffer(int fd, std::size_t capacity = 1 << 16) : m_fd(fd), m_capacity(capacity) 
+        { 
+            m_buffer.reserve(capacity + 1024); 
+        }
+#endif
+        
+        _output_buffer(const _output_buffer &) = delete;
+        _output_buffer &operator=(const _output_buffer &) = delete;
+        
+        ~_output_buffer() { flush(); }
+        
+        std::string &buffer() { return m_buffer; }
+        
+        void write_if_full() { if( m_buffer.size() >= m_capacity ) flush(); }
+        
+        void flush()
+        {
+            if( m_buffer.empty() ) return;
+            
+            if( m_stream )
+            {
+                m_stream->write(m_buffer.data(), m_buffer.size());
+                m_stream->flush();
+            }
+#if defined(__unix__) || defined(__APPLE__)
+            else
+            {
+                std::size_t written = 0;
+                while( written < m_buffer.size() )
+                {
+                    auto result = ::write(m_fd, m_buffer.data() + written, m_buffer.size() - written);
+                    
+                    if( result < 0 && errno == EINTR ) continue;
+                    if( result <= 0 ) break;
+                    
+                    written += static_cast<std::size_t>(result);
+                }
+            }
+#endif
+            m_buffer.clear();
+        }
+        
+    private:
+        std::ostream *m_stream = nullptr;
+        int m_fd = -1;
+        std::size_t m_capacity;
+        std::string m_buffer;
+    };
+    
     struct _table_creator
     {
-        _table_creator(std::list<row_t> &rows, std::vector<horizontal_line> &hor_lines) : m_rows(rows), m_hor_lines(hor_lines) { }
+        _table_creator(_table_rows_t &rows, std::vector<horizontal_line> &hor_lines) : 
+            m_current_row(rows.get_allocator()), m_rows(rows), m_hor_lines(hor_lines) { }
         
         template<class type_t>
         _table_creator &operator()(const type_t &value)
         {
-            std::stringstream ss;
-            ss << value;
-            m_current_row.push_back(ss.str());
+            add_cell(value);
             
-            m_rows.push_back(m_current_row);
+            m_rows.push_back(std::move(m_current_row));
             m_current_row.clear();
             
             return *this;
         }
         
         template<class type_t, class ... types_t>
-        _table_creator operator()(const type_t &value, const types_t& ... remaining)
+        _table_creator &operator()(const type_t &value, const types_t& ... remaining)
         {
-            std::stringstream ss;
-            ss << value;
-            m_current_row.push_back(ss.str());
+            add_cell(value);
             
             this->operator()(remaining ...);
             return *this;
         }
         
-        _table_creator operator()(horizontal_line hor_line)
+        _table_creator &operator()(horizontal_line hor_line)
         {
             hor_line.position = m_rows.size();
             m_hor_lines.push_back(hor_line);
             
             return *this;
         }
+        
+        template<class type_t>
+        void add_cell(const type_t &value)
+        {
+#if defined(MCL_HAS_PMR)
+            // formatted into a reused buffer, the cell itself is allocated from the resource of the table
+            m_buffer.clear();
+            format_to(m_buffer, value);
+            m_current_row.emplace_back(m_buffer.data(), m_buffer.size());
+#else
+            m_current_row.emplace_back();
+            format_to(m_current_row.back(), value);
+#endif
+        }
     
-        std::vector<std::string> m_current_row;
-        std::list<row_t> &m_rows;
+        _table_row_t m_current_row;
+        _table_rows_t &m_rows;
         std::vector<horizontal_line> &m_hor_lines;
+        std::string m_buffer;
     };
     
     class table
@@ -71,119 +254,741 @@ namespace mc
         
         table() : m_creator(m_rows, m_hor_lines) { }
         
+#if defined(MCL_HAS_PMR)
+        // all rows and cells are allocated from 'resource', which must outlive the table
+        explicit table(std::pmr::memory_resource *resource) : m_rows(resource), m_creator(m_rows, m_hor_lines) { }
+#endif
+        
+        // the creator refers to the rows of its own table, so it must not be copied
+        table(const table &other) : m_creator(m_rows, m_hor_lines) { *this = other; }
+        
+        table &operator=(const table &other)
+        {
+            m_rows = other.m_rows;
+            m_hor_lines = other.m_hor_lines;
+            m_style = other.m_style;
+            m_has_gobal_cell_width = other.m_has_gobal_cell_width;
+            
+            return *this;
+        }
+        
         _table_creator &create()
         {
             m_rows.clear();
             return m_creator;
         }
         
-        void print()
+        void print() { print(std::cout); }
+        
+        // the whole table is rendered into a buffer which is written in large chunks
+        void print(std::ostream &stream) const
+        {
+            _output_buffer out(stream);
+            render(out);
+        }
+        
+#if defined(__unix__) || defined(__APPLE__)
+        void print(int fd) const
         {
-            prepare_table();
+            _output_buffer out(fd);
+            render(out);
+        }
+#endif
+        
+        std::string to_string() const
+        {
+            std::ostringstream stream;
+            print(stream);
+            return stream.str();
+        }
+        
+        void set_vertical_delimiter(std::string delim) { m_style.vertical_delimiter = delim; }
+        void set_padding(int size) { m_style.padding = std::string(static_cast<std::size_t>(std::max(size, 0)), ' '); }
+        void add_left_border() { m_style.left_border = true; }
+        void add_right_border() { m_style.right_border = true; }
+        void global_cell_width() { m_has_gobal_cell_width = true; }
+        
+    private:
+        std::vector<std::size_t> column_widths() const
+        {
+            std::vector<std::size_t> widths;
             
-            std::size_t i=0;
-            for( auto row = m_rows.begin(); row != m_rows.end(); ++row, ++i )
+            for( const auto &row : m_rows )
             {
-                // Does horizontal line exist?
-                auto hor_line_it = std::find_if(m_hor_lines.begin(), m_hor_lines.end(),
-                                                [&](const horizontal_line &l){ return i == l.position; });
+                if( row.size() > widths.size() ) widths.resize(row.size(), 0);
                 
-                if( hor_line_it != m_hor_lines.end() )
-                    std::cout << std::string(m_row_length, hor_line_it->m_char) << std::endl;
+                for(std::size_t i=0; i<row.size(); ++i)
+                    widths[i] = std::max(widths[i], row[i].size());
+            }
+            
+            if( m_has_gobal_cell_width && !widths.empty() )
+                std::fill(widths.begin(), widths.end(), *std::max_element(widths.begin(), widths.end()));
+            
+            return widths;
+        }
+        
+        void render(_output_buffer &out) const
+        {
+            const auto widths = column_widths();
+            
+            // horizontal line before each row, indexed by position (the first one at a position is used)
+            std::vector<char> lines(m_rows.size() + 1, 0);
+            for( const auto &line : m_hor_lines )
+                if( line.position < lines.size() && !lines[line.position] )
+                    lines[line.position] = line.m_char;
+            
+            std::size_t i = 0;
+            for( const auto &row : m_rows )
+            {
+                if( lines[i++] ) m_style.render_line(out.buffer(), lines[i-1], widths);
                 
-                // Print line
-                if( m_has_left_delim ) std::cout << m_vert_delim;
+                m_style.render_row(out.buffer(), row, widths);
+                out.write_if_full();
+            }
+            
+            if( lines[i] ) m_style.render_line(out.buffer(), lines[i], widths);
+            
+            out.flush();
+        }
+        
+        _table_rows_t m_rows;
+        std::vector<horizontal_line> m_hor_lines;
+        _table_creator m_creator;
+        _table_style m_style;
+        
+        // options
+        bool m_has_gobal_cell_width = false;
+    };
+    
+    // Streaming table for very large outputs: nothing is stored, every row is formatted into a 
+    // reused buffer which is written in large chunks. The column widths are given up front or 
+    // taken from the first 'sample_rows' rows, later cells which are wider shift their row.
+    class table_stream
+    {
+    public:
+        table_stream(std::ostream &stream, std::vector<std::size_t> widths) : m_out(stream), m_widths(std::move(widths)) { }
+        
+        explicit table_stream(std::ostream &stream = std::cout, std::size_t sample_rows = 1000) : 
+            m_out(stream), m_sample_rows(std::max<std::size_t>(sample_rows, 1)), m_sampling(true) { }
+        
+#if defined(__unix__) || defined(__APPLE__)
+        table_stream(int fd, std::vector<std::size_t> widths) : m_out(fd), m_widths(std::move(widths)) { }
+        
+        table_stream(int fd, std::size_t sample_rows) : m_out(fd), m_sample_rows(std::max<std::size_t>(sample_rows, 1)), m_sampling(true) { }
+#endif
+        
+        ~table_stream() { flush(); }
+        
+        table_stream(const table_stream &) = delete;
+        table_stream &operator=(const table_stream &) = delete;
+        
+        // one row
+        template<class ... types_t>
+        table_stream &operator()(const types_t &... values)
+        {
+            m_row.resize(sizeof...(values));
+            for(auto &cell : m_row) cell.clear();
+            
+            std::size_t i = 0;
+            using expander = int[];
+            (void)expander{ 0, (format_to(m_row[i++], values), 0)... };
+            
+            if( m_sampling )
+            {
+                m_sample.push_back(m_row);
+                if( m_sample.size() >= m_sample_rows ) end_sampling();
+            }
+            else
+            {
+                m_style.render_row(m_out.buffer(), m_row, m_widths);
+                m_out.write_if_full();
+            }
+            
+            return *this;
+        }
+        
+        table_stream &operator()(horizontal_line line)
+        {
+            if( m_sampling )
+            {
+                line.position = m_sample.size();
+                m_sample_lines.push_back(line);
+            }
+            else
+                m_style.render_line(m_out.buffer(), line.m_char, m_widths);
+            
+            return *this;
+        }
+        
+        // ends sampling (if still active) and writes everything
+        void flush()
+        {
+            if( m_sampling ) end_sampling();
+            m_out.flush();
+        }
+        
+        const std::vector<std::size_t> &widths() const { return m_widths; }
+        
+        // the style must be set before the first row
+        void set_vertical_delimiter(std::string delim) { m_style.vertical_delimiter = delim; }
+        void set_padding(int size) { m_style.padding = std::string(static_cast<std::size_t>(std::max(size, 0)), ' '); }
+        void add_left_border() { m_style.left_border = true; }
+        void add_right_border() { m_style.right_border = true; }
+        
+    private:
+        void end_sampling()
+        {
+            m_sampling = false;
+            
+            for( const auto &row : m_sample )
+            {
+                if( row.size() > m_widths.size() ) m_widths.resize(row.size(), 0);
                 
-                for( auto cell_it = row->begin(); cell_it != row->end(); ++cell_it )
-                {
-                    std::cout << m_cell_padding << *cell_it << m_cell_padding;
-                    
-                    if( cell_it != row->end()-1 )
-                        std::cout << m_vert_delim;
-                }
+                for(std::size_t i=0; i<row.size(); ++i)
+                    m_widths[i] = std::max(m_widths[i], row[i].size());
+            }
+            
+            auto line = m_sample_lines.begin();
+            for(std::size_t i=0; i<=m_sample.size(); ++i)
+            {
+                for(; line != m_sample_lines.end() && line->position == i; ++line)
+                    m_style.render_line(m_out.buffer(), line->m_char, m_widths);
                 
-                if( m_has_right_delim ) std::cout << m_vert_delim;
+                if( i < m_sample.size() ) m_style.render_row(m_out.buffer(), m_sample[i], m_widths);
+            }
+            
+            m_sample.clear();
+            m_sample_lines.clear();
+        }
+        
+        _output_buffer m_out;
+        _table_style m_style;
+        std::vector<std::size_t> m_widths;
+        std::size_t m_sample_rows = 0;
+        bool m_sampling = false;
+        
+        row_t m_row;
+        std::vector<row_t> m_sample;
+        std::vector<horizontal_line> m_sample_lines;
+    };
+    
+    // Column oriented tables
+    // ======================
+    
+    enum class align { left, right };
+    enum class table_format { ascii, csv, tsv, markdown, json_lines };
+    enum class column_kind { unknown, integer, number, text };
+    
+    // integers (and bool) and floating point values are stored as numbers, everything else as text
+    template<class type_t>
+    struct _column_kind : std::integral_constant<column_kind, 
+        std::is_floating_point<type_t>::value ? column_kind::number :
+        std::is_integral<type_t>::value && !std::is_same<type_t, char>::value && 
+        !std::is_same<type_t, signed char>::value && !std::is_same<type_t, unsigned char>::value ? column_kind::integer : 
+        column_kind::text> { };
+    
+    inline void _append_json_string(std::string &out, const std::string &value)
+    {
+        out += '"';
+        for(char c : value)
+        {
+            switch(c)
+            {
+                case '"':  out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    if( static_cast<unsigned char>(c) < 0x20 )
+                    {
+                        char chars[8];
+                        std::snprintf(chars, sizeof(chars), "\\u%04x", static_cast<unsigned>(c));
+                        out += chars;
+                    }
+                    else
+                        out += c;
+            }
+        }
+        out += '"';
+    }
+    
+    // Table which stores typed columns: integers and numbers in contiguous arrays, which are 
+    // only formatted (with std::to_chars if available) when the table is written.
+    class column_table
+    {
+    public:
+        class column
+        {
+        public:
+            explicit column(std::string name, column_kind kind = column_kind::unknown) : m_name(std::move(name)), m_kind(kind) { }
+            
+            // digits after the decimal point of number columns, negative for the shortest exact representation
+            column &precision(int digits) { m_format.set_precision(digits).set_fixed(digits >= 0); return *this; }
+            column &alignment(mc::align a) { m_align = a; return *this; }
+            
+            const std::string &name() const { return m_name; }
+            column_kind kind() const { return m_kind; }
+            mc::align alignment() const { return m_align; }
+            
+            const std::vector<std::int64_t> &integers() const { check(column_kind::integer, "integers"); return m_integers; }
+            const std::vector<double> &numbers() const { check(column_kind::number, "numbers"); return m_numbers; }
+            const std::vector<std::string> &strings() const { check(column_kind::text, "text"); return m_strings; }
+            
+            // the cell as text, numbers are formatted into 'scratch'
+            const std::string &cell(std::size_t row, std::string &scratch) const
+            {
+                if( stores_text() ) return m_strings[row];
+                
+                scratch.clear();
+                if( m_kind == column_kind::integer ) 
+                    format_to(scratch, m_integers[row]);
+                else
+                    format_to(scratch, m_numbers[row], m_format);
+                
+                return scratch;
+            }
+            
+            bool is_finite(std::size_t row) const 
+            { 
+                return m_kind != column_kind::number || (m_numbers[row] == m_numbers[row] && std::abs(m_numbers[row]) <= std::numeric_limits<double>::max());
+            }
+            
+        private:
+            friend class column_table;
+            
+            template<class type_t>
+            void push(const type_t &value)
+            {
+                push(value, _column_kind<type_t>());
+            }
+            
+            template<class type_t>
+            void push(const type_t &value, std::integral_constant<column_kind, column_kind::integer>)
+            {
+                resolve(column_kind::integer);
+                
+                if( m_kind == column_kind::integer ) 
+                    m_integers.push_back(static_cast<std::int64_t>(value));
+                else if( m_kind == column_kind::number )
+                    m_numbers.push_back(static_cast<double>(value));
+                else
+                    push_text(value);
+            }
+            
+            template<class type_t>
+            void push(const type_t &value, std::integral_constant<column_kind, column_kind::number>)
+            {
+                resolve(column_kind::number);
+                
+                if( m_kind == column_kind::integer ) 
+                    throw std::runtime_error("column '" + m_name + "' holds integers, got a floating point value");
+                else if( m_kind == column_kind::number )
+                    m_numbers.push_back(static_cast<double>(value));
+                else
+                    push_text(value);
+            }
+            
+            template<class type_t>
+            void push(const type_t &value, std::integral_constant<column_kind, column_kind::text>)
+            {
+                resolve(column_kind::text);
+                
+                if( m_kind != column_kind::text )
+                    throw std::runtime_error("column '" + m_name + "' holds numbers, got text");
                 
-                std::cout << std::endl;
+                push_text(value);
             }
             
-            // Does bottom line exist?
-            auto hor_line_it = std::find_if(m_hor_lines.begin(), m_hor_lines.end(), 
-                                            [&](const horizontal_line &l){ return i == l.position; });
+            template<class type_t>
+            void push_text(const type_t &value)
+            {
+                m_strings.emplace_back();
+                format_to(m_strings.back(), value);
+            }
+            
+            // a column added without a type after rows exist holds empty strings until its first 
+            // value, the typed array takes over these rows (as default values)
+            void resolve(column_kind kind)
+            {
+                if( m_kind != column_kind::unknown ) return;
+                
+                const std::size_t rows = m_strings.size();
+                m_kind = kind;
                 
-            if( hor_line_it != m_hor_lines.end() )
-                std::cout << std::string(m_row_length, hor_line_it->m_char) << std::endl;
+                if( kind != column_kind::text )
+                {
+                    m_strings.clear();
+                    resize(rows);
+                }
+            }
+            
+            // columns without a value yet hold empty strings
+            bool stores_text() const { return m_kind == column_kind::text || m_kind == column_kind::unknown; }
+            
+            std::size_t size() const 
+            { 
+                return m_kind == column_kind::integer ? m_integers.size() : m_kind == column_kind::number ? m_numbers.size() : m_strings.size();
+            }
+            
+            void resize(std::size_t rows)
+            {
+                if( m_kind == column_kind::integer ) m_integers.resize(rows);
+                else if( m_kind == column_kind::number ) m_numbers.resize(rows);
+                else m_strings.resize(rows);
+            }
+            
+            void check(column_kind kind, const char *what) const
+            {
+                if( m_kind != kind )
+                    throw std::runtime_error("column '" + m_name + "' does not hold " + what);
+            }
+            
+            std::string m_name;
+            column_kind m_kind;
+            format_options m_format = _exact_format();
+            mc::align m_align = mc::align::left;
+            
+            std::vector<std::int64_t> m_integers;
+            std::vector<double> m_numbers;
+            std::vector<std::string> m_strings;
+        };
+        
+        column_table() = default;
+        
+        // the type of each column is taken from its first value
+        explicit column_table(const std::vector<std::string> &names)
+        {
+            for(const auto &name : names) add_column(name);
         }
         
-        void set_vertical_delimiter(std::string delim) { m_vert_delim = delim; }
-        void set_padding(int size) { m_cell_padding = size; }
-        void add_left_border() { m_has_left_delim = true; }
-        void add_right_border() { m_has_right_delim = true; }
-        void global_cell_width() { m_has_gobal_cell_width = true; }
+        column &add_column(const std::string &name)
+        {
+            m_columns.emplace_back(name);
+            m_columns.back().resize(m_rows);
+            return m_columns.back();
+        }
         
-    private:
-        void prepare_table()
+        template<class type_t>
+        column &add_column(const std::string &name)
         {
-            // Calculate different collum widths
-            auto collums = 
-                std::max_element(m_rows.begin(), m_rows.end(), [](row_t &a, row_t &b){ return a.size() < b.size(); })->size();
+            m_columns.emplace_back(name, _column_kind<type_t>::value);
+            m_columns.back().resize(m_rows);
+            return m_columns.back();
+        }
+        
+        // one row, a row which does not fit is not added
+        template<class ... types_t>
+        column_table &operator()(const types_t &... values)
+        {
+            if( sizeof...(values) != m_columns.size() )
+                throw std::runtime_error("number of values must match number of columns");
             
-            std::vector<std::size_t> collumn_widths(collums, 0);
+            try
+            {
+                std::size_t i = 0;
+                using expander = int[];
+                (void)expander{ 0, (m_columns[i++].push(values), 0)... };
+            }
+            catch(...)
+            {
+                for(auto &c : m_columns) c.resize(m_rows);
+                throw;
+            }
             
-            for( auto &row : m_rows )
+            ++m_rows;
+            return *this;
+        }
+        
+        std::size_t rows() const { return m_rows; }
+        std::size_t columns() const { return m_columns.size(); }
+        
+        column &operator[](std::size_t index) { return m_columns.at(index); }
+        const column &operator[](std::size_t index) const { return m_columns.at(index); }
+        
+        column &operator[](const std::string &name) { return m_columns[find(name)]; }
+        const column &operator[](const std::string &name) const { return m_columns[find(name)]; }
+        
+        // removes all rows, the columns are kept
+        void clear()
+        {
+            for(auto &c : m_columns) c.resize(0);
+            m_rows = 0;
+        }
+        
+        void print(std::ostream &stream = std::cout, table_format format = table_format::ascii) const
+        {
+            _output_buffer out(stream);
+            render(out, format);
+        }
+        
+#if defined(__unix__) || defined(__APPLE__)
+        void print(int fd, table_format format = table_format::ascii) const
+        {
+            _output_buffer out(fd);
+            render(out, format);
+        }
+#endif
+        
+        std::string to_string(table_format format = table_format::ascii) const
+        {
+            std::ostringstream stream;
+            print(stream, format);
+            return stream.str();
+        }
+        
+        // the format is taken from the extension (.csv, .tsv, .md, .jsonl), otherwise ascii
+        void save(const std::string &filename) const
+        {
+            auto ends_with = [&](const std::string &ext) 
+            { 
+                return filename.size() >= ext.size() && filename.compare(filename.size() - ext.size(), ext.size(), ext) == 0; 
+            };
+            
+            save(filename, ends_with(".csv") ? table_format::csv : ends_with(".tsv") ? table_format::tsv : 
+                           ends_with(".md") ? table_format::markdown : ends_with(".jsonl") ? table_format::json_lines : table_format::ascii);
+        }
+        
+        void save(const std::string &filename, table_format format) const
+        {
+            std::ofstream file(filename, std::ios::out | std::ios::trunc | std::ios::binary);
+            
+            if( !file )
+                throw std::runtime_error("could not open file '" + filename + "'");
+            
+            print(file, format);
+        }
+        
+        void set_vertical_delimiter(std::string delim) { m_style.vertical_delimiter = delim; }
+        void set_padding(int size) { m_style.padding = std::string(static_cast<std::size_t>(std::max(size, 0)), ' '); }
+        void add_left_border() { m_style.left_border = true; }
+        void add_right_border() { m_style.right_border = true; }
+        void set_header_line(char c) { m_header_line = c; }
+        
+    private:
+        std::size_t find(const std::string &name) const
+        {
+            for(std::size_t i=0; i<m_columns.size(); ++i)
+                if( m_columns[i].name() == name ) return i;
+            
+            throw std::runtime_error("column '" + name + "' does not exist");
+        }
+        
+        void render(_output_buffer &out, table_format format) const
+        {
+            switch(format)
             {
-                // adjust row lenghts
-                row.resize(collums);
+                case table_format::ascii:      render_ascii(out); break;
+                case table_format::csv:        render_separated(out, ','); break;
+                case table_format::tsv:        render_separated(out, '\t'); break;
+                case table_format::markdown:   render_markdown(out); break;
+                case table_format::json_lines: render_json_lines(out); break;
+            }
             
-                // search max collumn widht
-                for(std::size_t i=0; i<collums; ++i)
+            out.flush();
+        }
+        
+        void render_ascii(_output_buffer &out) const
+        {
+            // numbers are formatted once into one buffer per column, then measured and written
+            std::vector<std::string> formatted(m_columns.size());
+            std::vector<std::vector<std::size_t>> ends(m_columns.size());
+            std::vector<std::size_t> widths(m_columns.size());
+            
+            for(std::size_t c=0; c<m_columns.size(); ++c)
+            {
+                const auto &column = m_columns[c];
+                widths[c] = column.name().size();
+                
+                if( column.stores_text() )
                 {
-                    collumn_widths[i] = std::max(collumn_widths[i], row[i].size());
+                    for(const auto &cell : column.m_strings)
+                        widths[c] = std::max(widths[c], cell.size());
+                    continue;
+                }
+                
+                ends[c].reserve(m_rows);
+                for(std::size_t r=0; r<m_rows; ++r)
+                {
+                    auto begin = formatted[c].size();
+                    
+                    if( column.kind() == column_kind::integer ) 
+                        format_to(formatted[c], column.m_integers[r]);
+                    else
+                        format_to(formatted[c], column.m_numbers[r], column.m_format);
+                    
+                    ends[c].push_back(formatted[c].size());
+                    widths[c] = std::max(widths[c], formatted[c].size() - begin);
                 }
             }
             
-            auto global_cell_width_max = *std::max_element(collumn_widths.begin(), collumn_widths.end());
+            auto &buffer = out.buffer();
+            std::string cell;
             
-            for( auto &row : m_rows )
+            m_style.begin_row(buffer);
+            for(std::size_t c=0; c<m_columns.size(); ++c)
+                m_style.render_cell(buffer, m_columns[c].name(), widths[c], m_columns[c].alignment() == align::right, c + 1 == m_columns.size());
+            m_style.end_row(buffer);
+            
+            if( m_header_line ) m_style.render_line(buffer, m_header_line, widths);
+            
+            for(std::size_t r=0; r<m_rows; ++r)
             {
-                for(std::size_t i=0; i<collums; ++i)
+                m_style.begin_row(buffer);
+                for(std::size_t c=0; c<m_columns.size(); ++c)
                 {
-                    if( m_has_gobal_cell_width == true )
-                        row[i].resize( global_cell_width_max, ' ');
+                    bool right = m_columns[c].alignment() == align::right, last = c + 1 == m_columns.size();
+                    
+                    if( m_columns[c].stores_text() )
+                        m_style.render_cell(buffer, m_columns[c].m_strings[r], widths[c], right, last);
                     else
-                        row[i].resize( collumn_widths[i], ' ');
+                    {
+                        auto begin = r ? ends[c][r-1] : 0;
+                        cell.assign(formatted[c], begin, ends[c][r] - begin);
+                        m_style.render_cell(buffer, cell, widths[c], right, last);
+                    }
                 }
+                m_style.end_row(buffer);
+                
+                out.write_if_full();
+            }
+        }
+        
+        // csv fields are quoted if needed, tsv fields escape tabs, newlines and backslashes
+        static void append_field(std::string &out, const std::string &value, char delimiter)
+        {
+            if( delimiter == '\t' )
+            {
+                for(char c : value)
+                {
+                    switch(c)
+                    {
+                        case '\t': out += "\\t"; break;
+                        case '\n': out += "\\n"; break;
+                        case '\r': out += "\\r"; break;
+                        case '\\': out += "\\\\"; break;
+                        default: out += c;
+                    }
+                }
+            }
+            else if( value.find_first_of(std::string{delimiter, '"', '\n', '\r'}) != std::string::npos )
+            {
+                out += '"';
+                for(char c : value)
+                {
+                    if( c == '"' ) out += '"';
+                    out += c;
+                }
+                out += '"';
             }
-            
-            // Calculate global rowlength
-            if( m_has_gobal_cell_width == false )
-                m_row_length = std::accumulate(collumn_widths.begin(), collumn_widths.end(), 0ul);
             else
-                m_row_length = collums * global_cell_width_max;
+                out += value;
+        }
+        
+        void render_separated(_output_buffer &out, char delimiter) const
+        {
+            std::string scratch;
+            auto &buffer = out.buffer();
             
-            // add padding
-            m_row_length += 2 * collums * m_cell_padding.size();
+            for(std::size_t c=0; c<m_columns.size(); ++c)
+            {
+                if( c ) buffer += delimiter;
+                append_field(buffer, m_columns[c].name(), delimiter);
+            }
+            buffer += '\n';
             
-            // add central delimiter
-            m_row_length += (collums - 1) * m_vert_delim.size();
+            for(std::size_t r=0; r<m_rows; ++r)
+            {
+                for(std::size_t c=0; c<m_columns.size(); ++c)
+                {
+                    if( c ) buffer += delimiter;
+                    
+                    if( m_columns[c].stores_text() )
+                        append_field(buffer, m_columns[c].cell(r, scratch), delimiter);
+                    else
+                        buffer += m_columns[c].cell(r, scratch);
+                }
+                buffer += '\n';
+                
+                out.write_if_full();
+            }
+        }
+        
+        static void append_markdown(std::string &out, const std::string &value)
+        {
+            for(char c : value)
+            {
+                if( c == '|' ) out += "\\|";
+                else if( c == '\n' || c == '\r' ) out += ' ';
+                else out += c;
+            }
+        }
+        
+        void render_markdown(_output_buffer &out) const
+        {
+            std::string scratch;
+            auto &buffer = out.buffer();
             
-            // add optional left and right delimiters
-            if( m_has_left_delim )  m_row_length += m_vert_delim.size();
-            if( m_has_right_delim ) m_row_length += m_vert_delim.size();
+            buffer += '|';
+            for(const auto &c : m_columns)
+            {
+                buffer += ' ';
+                append_markdown(buffer, c.name());
+                buffer += " |";
+            }
+            buffer += "\n|";
+            for(const auto &c : m_columns)
+                buffer += c.alignment() == align::right ? " ---: |" : " --- |";
+            buffer += '\n';
+            
+            for(std::size_t r=0; r<m_rows; ++r)
+            {
+                buffer += '|';
+                for(const auto &c : m_columns)
+                {
+                    buffer += ' ';
+                    append_markdown(buffer, c.cell(r, scratch));
+                    buffer += " |";
+                }
+                buffer += '\n';
+                
+                out.write_if_full();
+            }
         }
         
-        std::list<row_t> m_rows;
-        std::vector<horizontal_line> m_hor_lines;
-        _table_creator m_creator;
+        // one object per row, numbers which are not finite are written as null
+        void render_json_lines(_output_buffer &out) const
+        {
+            std::string scratch;
+            auto &buffer = out.buffer();
+            
+            for(std::size_t r=0; r<m_rows; ++r)
+            {
+                buffer += '{';
+                for(std::size_t c=0; c<m_columns.size(); ++c)
+                {
+                    if( c ) buffer += ',';
+                    _append_json_string(buffer, m_columns[c].name());
+                    buffer += ':';
+                    
+                    if( m_columns[c].stores_text() )
+                        _append_json_string(buffer, m_columns[c].cell(r, scratch));
+                    else if( !m_columns[c].is_finite(r) )
+                        buffer += "null";
+                    else
+                        buffer += m_columns[c].cell(r, scratch);
+                }
+                buffer += "}\n";
+                
+                out.write_if_full();
+            }
+        }
         
-        std::size_t m_row_length;
-        std::string m_vert_delim{"|"};
-        std::string m_cell_padding{" "};
+        std::vector<column> m_columns;
+        std::size_t m_rows = 0;
         
-        // options
-        bool m_has_gobal_cell_width = false;
-        bool m_has_left_delim = false;
-        bool m_has_right_delim = false;
+        _table_style m_style;
+        char m_header_line = '-';
     };
 }
 
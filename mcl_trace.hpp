@@ -0,0 +1,346 @@
+#ifndef MCL_TRACE_HPP
+#define MCL_TRACE_HPP
+
+#if __cplusplus < 201703L
+#error "error: 'mcl_trace.hpp' requires C++17!"
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <map>
+#include <ostream>
+#include <fstream>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "mcl_basic.hpp"
+#include "mcl_tabular.hpp"
+
+// Usage: MC_TRACE_SCOPE("name") records the enclosing scope. The name must be a string
+// literal (only the pointer is stored). Define MCL_NO_TRACE to remove all zones at compile time.
+#define MC_TRACE_CONCAT_IMPL(a, b) a##b
+#define MC_TRACE_CONCAT(a, b) MC_TRACE_CONCAT_IMPL(a, b)
+
+#if defined(MCL_NO_TRACE)
+#define MC_TRACE_SCOPE(name) do { } while(false)
+#else
+#define MC_TRACE_SCOPE(name) mc::trace_zone MC_TRACE_CONCAT(_mc_trace_zone_, __LINE__)(name)
+#endif
+
+namespace mc
+{
+    // Trace buffers
+    // =============
+    
+    struct trace_event
+    {
+        const char *name;
+        std::uint64_t begin;    // raw timestamps, see _trace_registry::now()
+        std::uint64_t end;
+    };
+    
+    // Ring buffer of one thread. Only the owning thread writes, readers take everything
+    // up to the published head. If the buffer is full the oldest events are overwritten.
+    // Readers may copy while the owner records (like a seqlock): the slots are written with
+    // relaxed atomics and the head is read again after the copy, events which the owner may
+    // have overwritten meanwhile are dropped. Clearing only moves 'tail', which the owner 
+    // never reads, so clearing does not race with recording either.
+    struct _trace_buffer
+    {
+        explicit _trace_buffer(std::size_t capacity, std::uint32_t thread) : 
+            slots(new slot[capacity]), capacity(capacity), thread_id(thread) { }
+        
+        void push(const trace_event &event)
+        {
+            auto h = head.load(std::memory_order_relaxed);
+            auto &s = slots[h % capacity];
+            
+            // readers which see one of the new values also see that index h is being written
+            std::atomic_thread_fence(std::memory_order_release);
+            s.name.store(event.name, std::memory_order_relaxed);
+            s.begin.store(event.begin, std::memory_order_relaxed);
+            s.end.store(event.end, std::memory_order_relaxed);
+            
+            head.store(h + 1, std::memory_order_release);
+        }
+        
+        std::vector<trace_event> snapshot() const
+        {
+            auto h = head.load(std::memory_order_acquire);
+            auto first = std::max<std::uint64_t>(h > capacity ? h - capacity : 0, tail.load(std::memory_order_acquire));
+            
+            std::vector<trace_event> result;
+            result.reserve(h > first ? h - first : 0);
+            
+            for(auto i = first; i < h; ++i)
+            {
+                const auto &s = slots[i % capacity];
+                result.push_back(trace_event{ s.name.load(std::memory_order_relaxed), s.begin.load(std::memory_order_relaxed), 
+                                              s.end.load(std::memory_order_relaxed) });
+            }
+            
+            // index 'now' may be in progress, so the events up to now - capacity may be torn
+            std::atomic_thread_fence(std::memory_order_acquire);
+            auto now = head.load(std::memory_order_relaxed);
+            auto valid = now >= capacity ? now - capacity + 1 : 0;
+            
+            if( valid > first )
+                result.erase(result.begin(), result.begin() + std::min<std::uint64_t>(valid - first, result.size()));
+            
+            return result;
+        }
+        
+        // events recorded so far are not returned by snapshot() anymore
+        void clear() { tail.store(head.load(std::memory_order_acquire), std::memory_order_release); }
+        
+        struct slot
+        {
+            std::atomic<const char *> name{nullptr};
+            std::atomic<std::uint64_t> begin{0};
+            std::atomic<std::uint64_t> end{0};
+        };
+        
+        std::unique_ptr<slot[]> slots;
+        std::size_t capacity;
+        std::atomic<std::uint64_t> head{0};
+        std::atomic<std::uint64_t> tail{0};
+        std::uint32_t thread_id;
+    };
+    
+    class _trace_registry
+    {
+    public:
+        static _trace_registry &instance()
+        {
+            static _trace_registry registry;
+            return registry;
+        }
+        
+        _trace_buffer &local_buffer()
+        {
+            // constant initialized, so no thread_local guard is needed on the hot path; 
+            // the registry keeps the buffer alive
+            thread_local _trace_buffer *buffer = nullptr;
+            
+            if( !buffer ) buffer = create_buffer().get();
+            return *buffer;
+        }
+        
+        // raw timestamp: time stamp counter on x86, otherwise nanoseconds of the steady clock
+        static std::uint64_t now()
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            return __rdtsc();
+#else
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+        }
+        
+        // nanoseconds per raw timestamp unit, calibrated against the steady clock since the start
+        double nanoseconds_per_tick() const
+        {
+            auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start_time).count();
+            auto elapsed_ticks = now() - m_start_ticks;
+            
+            return elapsed_ticks > 0 ? static_cast<double>(elapsed_ns) / elapsed_ticks : 1.0;
+        }
+        
+        // only affects threads which record their first event afterwards
+        void set_buffer_size(std::size_t events) { m_buffer_size = std::max<std::size_t>(events, 1); }
+        
+        std::vector<std::shared_ptr<_trace_buffer>> buffers()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_buffers;
+        }
+        
+        // events of one buffer with timestamps in nanoseconds since the start
+        std::vector<trace_event> events(const _trace_buffer &buffer) const
+        {
+            auto events = buffer.snapshot();
+            auto scale = nanoseconds_per_tick();
+            
+            auto convert = [&](std::uint64_t t)
+            {
+                return t > m_start_ticks ? static_cast<std::uint64_t>((t - m_start_ticks) * scale) : 0;
+            };
+            
+            for(auto &e : events)
+            {
+                e.begin = convert(e.begin);
+                e.end = convert(e.end);
+            }
+            
+            return events;
+        }
+        
+        void clear()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for(auto &b : m_buffers) b->clear();
+        }
+    
+    private:
+        std::shared_ptr<_trace_buffer> create_buffer()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            
+            auto buffer = std::make_shared<_trace_buffer>(m_buffer_size, static_cast<std::uint32_t>(m_buffers.size()));
+            m_buffers.push_back(buffer);
+            
+            return buffer;
+        }
+        
+        std::chrono::steady_clock::time_point m_start_time = std::chrono::steady_clock::now();
+        std::uint64_t m_start_ticks = now();
+        std::atomic<std::size_t> m_buffer_size{1 << 16};
+        std::mutex m_mutex;
+        std::vector<std::shared_ptr<_trace_buffer>> m_buffers;
+    };
+    
+    // Records begin and end of its lifetime, use MC_TRACE_SCOPE instead of creating it directly
+    class trace_zone
+    {
+    public:
+        explicit trace_zone(const char *name) :
+            m_buffer(_trace_registry::instance().local_buffer()), m_name(name), m_begin(_trace_registry::now()) { }
+        
+        ~trace_zone() { m_buffer.push(trace_event{ m_name, m_begin, _trace_registry::now() }); }
+        
+        trace_zone(const trace_zone &) = delete;
+        trace_zone &operator=(const trace_zone &) = delete;
+    
+    private:
+        _trace_buffer &m_buffer;
+        const char *m_name;
+        std::uint64_t m_begin;
+    };
+    
+    // Trace export
+    // ============
+    
+    // Threads may keep recording while the events are exported or cleared (e.g. periodic 
+    // flushes of long running jobs), events which are overwritten meanwhile are left out.
+    
+    inline void trace_set_buffer_size(std::size_t events) { _trace_registry::instance().set_buffer_size(events); }
+    
+    inline void trace_clear() { _trace_registry::instance().clear(); }
+    
+    // Chrome trace event format, can be loaded in chrome://tracing or ui.perfetto.dev
+    inline void trace_export_chrome(std::ostream &stream)
+    {
+        std::string buffer = "{\"traceEvents\":[\n";
+        const format_options exact = _exact_format();
+        bool first = true;
+        
+        for(const auto &b : _trace_registry::instance().buffers())
+        {
+            for(const auto &e : _trace_registry::instance().events(*b))
+            {
+                buffer += first ? "" : ",\n";
+                buffer += "{\"name\":\"";
+                for(const char *c = e.name; *c; ++c)
+                {
+                    if( *c == '"' || *c == '\\' ) buffer += '\\';
+                    buffer += *c;
+                }
+                buffer += "\",\"ph\":\"X\",\"pid\":1,\"tid\":";
+                format_to(buffer, b->thread_id, exact);
+                buffer += ",\"ts\":";
+                format_to(buffer, e.begin / 1000.0, exact);
+                buffer += ",\"dur\":";
+                format_to(buffer, (e.end - e.begin) / 1000.0, exact);
+                buffer += "}";
+                
+                first = false;
+            }
+        }
+        
+        buffer += "\n]}\n";
+        stream << buffer;
+    }
+    
+    inline void trace_export_chrome(const std::string &filename)
+    {
+        std::ofstream file(filename, std::ios::out | std::ios::trunc);
+        
+        if( !file )
+            throw std::runtime_error("could not open file '" + filename + "'");
+        
+        trace_export_chrome(file);
+    }
+    
+    struct trace_statistics
+    {
+        std::string name;
+        std::uint64_t calls = 0;
+        std::uint64_t total = 0;    // nanoseconds
+        std::uint64_t self = 0;     // nanoseconds, total without nested zones
+    };
+    
+    // Aggregates all recorded zones by name, sorted by total time
+    inline std::vector<trace_statistics> trace_summary()
+    {
+        std::map<std::string, trace_statistics> stats;
+        
+        for(const auto &b : _trace_registry::instance().buffers())
+        {
+            auto events = _trace_registry::instance().events(*b);
+            
+            // parents first: earlier begin, for equal begins the longer zone
+            std::sort(events.begin(), events.end(), [](const trace_event &a, const trace_event &b)
+            {
+                return a.begin < b.begin || (a.begin == b.begin && a.end > b.end);
+            });
+            
+            std::vector<std::pair<trace_statistics *, const trace_event *>> stack;
+            
+            for(const auto &e : events)
+            {
+                while( !stack.empty() && stack.back().second->end <= e.begin )
+                    stack.pop_back();
+                
+                auto &s = stats[e.name];
+                s.name = e.name;
+                s.calls += 1;
+                s.total += e.end - e.begin;
+                s.self += e.end - e.begin;
+                
+                if( !stack.empty() )
+                    stack.back().first->self -= e.end - e.begin;
+                
+                stack.emplace_back(&s, &e);
+            }
+        }
+        
+        std::vector<trace_statistics> result;
+        for(auto &s : stats) result.push_back(s.second);
+        
+        std::sort(result.begin(), result.end(), [](const trace_statistics &a, const trace_statistics &b){ return a.total > b.total; });
+        
+        return result;
+    }
+    
+    inline table trace_summary_table()
+    {
+        table t;
+        auto &creator = t.create();
+        
+        creator("zone", "calls", "total [ms]", "self [ms]", "mean [us]")(horizontal_line('-'));
+        
+        for(const auto &s : trace_summary())
+            creator(s.name, s.calls, s.total / 1e6, s.self / 1e6, s.total / 1e3 / s.calls);
+        
+        return t;
+    }
+}
+
+#endif
@@ -9,12 +9,19 @@
 
 #if __cplusplus >= 201703L
     #include "mcl_python_like.hpp"
+    #include "mcl_io.hpp"
+    #include "mcl_benchmark.hpp"
+    #include "mcl_trace.hpp"
+    #include "mcl_metrics.hpp"
+    #include "mcl_parallel.hpp"
+    #include "mcl_memory.hpp"
 #endif
 
 
 #include <vector>
 #include <array>
 #include <list>
+#include <map>
 #include <iostream>
 #include <utility>
 #include <thread>
@@ -33,6 +40,125 @@ void test_mathematical()
     std::cout << "squared vector =     " << mc::stringify_container(mc::square_container(vector)) << std::endl;
     std::cout << "abs vector =         " << mc::stringify_container(mc::abs_container(vector)) << std::endl;
     
+    // vectorized kernels must give the same results as the scalar fallback
+    std::vector<double> large(1000);
+    for(std::size_t i=0; i<large.size(); ++i) large[i] = std::sin(i * 0.1);
+    
+    auto simd_stddev = mc::standard_deviation(large);
+    mc::set_simd_limit(mc::simd_level::scalar);
+    auto scalar_stddev = mc::standard_deviation(large);
+    mc::set_simd_limit(mc::simd_level::avx512);
+    
+    std::cout << "simd level =         " << static_cast<int>(mc::simd_support()) 
+              << " (stddev difference to scalar: " << std::abs(simd_stddev - scalar_stddev) << ")" << std::endl;
+    
+    // parallel overloads give the same result for every thread count
+    auto policy = mc::par;
+    policy.threshold = 0;
+    policy.block_size = 100;
+    
+    std::cout << "parallel average =   " << mc::average(policy(2), large) << " (2 threads), " 
+              << mc::average(policy(4), large) << " (4 threads)" << std::endl;
+    
+    // integer blocks are summed exactly, block_size = 0 uses the default blocks
+    std::vector<long> integers(200000, 0);
+    integers[5] = 1000000;
+    auto automatic = mc::par;
+    automatic.block_size = 0;
+    
+    std::cout << "integer average =    " << mc::average(integers) << " (sequential), " << mc::average(mc::par, integers)
+              << " (parallel), " << mc::average(automatic(2), integers) << " (automatic blocks)" << std::endl;
+    
+    // lazy expressions are fused into one loop, no temporary containers
+    std::vector<double> buffer;
+    std::cout << "average of square(|x| - 1) = " << mc::average(mc::square(mc::abs(vector) - 1.0)) 
+              << ", parallel stddev of 2*x + x = " << mc::standard_deviation(policy(2), mc::lazy(large) * 2.0 + large) << std::endl;
+    std::cout << "eval(x * x / 2) =    " << mc::stringify_container(mc::eval(buffer, mc::lazy(vector) * vector / 2)) << std::endl;
+    
+    mc::abs_container(vector.begin(), vector.end(), buffer.begin());
+    std::cout << "abs into buffer =    " << mc::stringify_container(buffer) << ", squared in place = " 
+              << mc::stringify_container(mc::square_inplace(buffer)) << std::endl;
+    
+    // two partial accumulators, merged
+    mc::running_stats<> first_half, second_half;
+    first_half.push(vector.begin(), vector.begin() + 4);
+    second_half.push(vector.begin() + 4, vector.end());
+    first_half.merge(second_half);
+    
+    std::cout << "running_stats:       count = " << first_half.count() << ", mean = " << first_half.mean() 
+              << ", stddev = " << first_half.stddev() << ", min = " << first_half.min() << ", max = " << first_half.max()
+              << ", skewness = " << first_half.skewness() << ", kurtosis = " << first_half.kurtosis() << std::endl;
+    
+    // moments without min and max keep the extremes of the accumulator they are merged into
+    mc::running_stats<> extremes;
+    extremes.push(5);
+    extremes.push(7);
+    extremes.merge(mc::running_stats<>::from_moments(2, 10, 1));
+    std::cout << "merged moments:      mean = " << extremes.mean() << ", min = " << extremes.min() << ", max = " << extremes.max() << std::endl;
+    
+    // mean and stddev of the last 3 values, updated in O(1) per value
+    std::cout << "moving_average(3) =  " << mc::stringify_container(mc::moving_average(vector, 3)) 
+              << ", moving_stddev(3) = " << mc::stringify_container(mc::moving_stddev(vector, 3)) << std::endl;
+    
+    // a NaN spoils the window only while it is part of it
+    mc::moving_stats<> window(3);
+    for(double x : { 1.0, std::nan(""), 2.0, 4.0, 6.0 }) window.push(x);
+    std::cout << "moving mean after NaN = " << window.mean() << ", variance = " << window.variance() << std::endl;
+    
+    // exact order statistics by selection, the parallel path collects a band around the rank
+    std::vector<double> ps = { 0, 25, 50, 90, 100 };
+    std::cout << "median =             " << mc::median(vector) << ", percentiles " << mc::stringify_container(ps) << " = " 
+              << mc::stringify_container(mc::percentiles(vector, ps)) << std::endl;
+    std::cout << "trimmed_mean(25%) =  " << mc::trimmed_mean(vector, 0.25) << ", mad = " << mc::mad(vector) 
+              << ", parallel median = " << mc::median(policy(2), large) << " (sequential: " << mc::median(large) 
+              << "), parallel mad = " << mc::mad(policy(2), large) << " (sequential: " << mc::mad(large) << ")" << std::endl;
+    
+    // deviations of integer data are not truncated, a NaN percentile is rejected
+    std::vector<int> small_integers = { 1, 2, 3, 4 };
+    std::cout << "integer mad =        " << mc::mad(small_integers) << " (in place: " << mc::mad_inplace(small_integers) << ")";
+    
+    try { mc::percentile(vector, std::nan("")); }
+    catch( const std::runtime_error &e ) { std::cout << ", " << e.what(); }
+    std::cout << std::endl;
+    
+    // all pairwise covariances in one pass over the rows, histograms of several columns
+    std::vector<double> doubled(vector.size()), negated(vector.size());
+    mc::eval(doubled, mc::lazy(vector) * 2.0);
+    mc::eval(negated, 1.0 - mc::lazy(large));
+    
+    std::cout << "correlation_matrix = " << mc::stringify_container(mc::correlation_matrix(vector, doubled, mc::abs(vector))[2]) 
+              << " (row 3), parallel cov(x, 1 - x) = " << mc::covariance_matrix(policy(2), large, negated)[0][1]
+              << " (sequential: " << mc::covariance_matrix(large, negated)[0][1] << ")" << std::endl;
+    
+    auto column_histograms = mc::histograms(4, vector, large);
+    column_histograms[0].to_table(20).print();
+    std::cout << "quantile bins of sin(0.1 i): " << mc::stringify_container(mc::quantile_histograms(4, large)[0].edges()) << std::endl;
+    
+    // fixed memory quantiles of 1..100000: histogram (integers), t-digest (real values)
+    mc::log_histogram histogram;
+    mc::concurrent_histogram shared_histogram;
+    mc::tdigest<> digest, second_digest;
+    
+    for(std::uint64_t i=1; i<=100000; ++i)
+    {
+        histogram.record(i);
+        shared_histogram.record(i);
+        (i % 2 ? digest : second_digest).push(static_cast<double>(i));
+    }
+    
+    // every thread pushes into its own shard of the concurrent t-digest
+    mc::concurrent_tdigest<> shared_digest;
+    std::vector<std::thread> pushers;
+    for(int t=0; t<4; ++t)
+        pushers.emplace_back([&shared_digest, t]{ for(int i=t+1; i<=100000; i+=4) shared_digest.push(i); });
+    for(auto &pusher : pushers) pusher.join();
+    
+    digest.merge(second_digest);
+    std::cout << "histogram p99 =      " << histogram.quantile(0.99) << " (concurrent: " << shared_histogram.snapshot().quantile(0.99) 
+              << "), t-digest p99 = " << digest.quantile(0.99) << " with " << digest.centroid_count() << " centroids (concurrent: " 
+              << shared_digest.snapshot().quantile(0.99) << ")" << std::endl;
+    mc::to_table(histogram, "").print();
+    
     std::cout << std::endl;
 }  
 
@@ -46,8 +172,113 @@ void test_export()
 
     mc::clear_file("three_vec.txt");
     mc::export_containers("three_vec.txt", { "A", "B", "C" }, vectorA, listB, vectorC);
+    mc::export_containers("three_vec.txt", {});     // no columns, leaves the file as it is
+    
+    // second export appends rows, the header is only written once
+    for(int i=0; i<2; ++i)
+    {
+        mc::tsv_writer writer("three_vec.csv", ',', i == 0 ? mc::tsv_writer::truncate : mc::tsv_writer::append);
+        mc::export_containers(writer, { "A", "B", "C" }, vectorA, listB, vectorC);
+    }
+    
+    std::cout << "(check files three_vec.txt and three_vec.csv)" << std::endl;
+    
+    // nested containers, maps and pairs; large containers are truncated
+    std::vector<int> numbers(1000);
+    for(std::size_t i=0; i<numbers.size(); ++i) numbers[i] = static_cast<int>(i) + 1;
+    
+    std::map<std::string, std::vector<double>> groups = { { "a", { 1.0 / 3, 2 } }, { "b", { } } };
+    mc::print_container(groups, "groups");
+    mc::print_container(std::make_pair(std::make_tuple(1, 'x'), vectorC), "pair", mc::format_options().set_max_items(2));
+    mc::print_container(numbers, "numbers", mc::format_options().set_max_items(5));
+    
+    // appends to a reused buffer
+    std::string buffer = "exact: ";
+    mc::format_to(buffer, std::vector<double>{ 0.1, 1.0 / 3 }, mc::format_options().set_precision(-1));
+    std::cout << buffer << std::endl;
+    std::cout << std::endl;
+}
+
+void test_io()
+{
+    std::cout << "TEST IO:" << std::endl;
+#if __cplusplus >= 201703L
+    std::vector<double> vectorA = { 1.5, 2.5, 3.5 };
+    std::list<int> listB = { 4, 5, 6 };
+    std::vector<std::string> vectorC = { "a", "bb", "ccc" };
+    
+    mc::export_binary("three_vec.bin", { "A", "B", "C" }, vectorA, listB, vectorC);
+    
+    mc::binary_file file("three_vec.bin");
+    std::cout << "rows = " << file.rows() << ", columns = " << mc::stringify_container(file.column_names()) << std::endl;
+    
+    for( auto [a, b, c] : mc::zip(file.column<double>("A"), file.column<int>("B"), file.strings("C")) )
+        std::cout << a << ", " << b << ", " << c << std::endl;
+    
+    // a corrupt header is rejected instead of reading outside of the file
+    auto open_corrupt = [](std::size_t position, std::uint64_t value)
+    {
+        std::ifstream in("three_vec.bin", std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        std::memcpy(&bytes[position], &value, sizeof(value));
+        std::ofstream("three_vec_corrupt.bin", std::ios::binary) << bytes;
+        
+        try { mc::binary_file corrupt("three_vec_corrupt.bin"); }
+        catch( const std::runtime_error &e ) { std::cout << "rejected: " << e.what() << std::endl; }
+    };
     
-    std::cout << "(check file three_vec.txt)" << std::endl;
+    open_corrupt(offsetof(mc::_binary_header, rows), 1000);
+    open_corrupt(file.info("C").offset + sizeof(std::uint64_t), 5);
+    std::remove("three_vec_corrupt.bin");
+    
+    // no containers, a file without columns
+    mc::export_binary("three_vec_empty.bin", {});
+    std::cout << "without columns: rows = " << mc::binary_file("three_vec_empty.bin").rows() << std::endl;
+    std::remove("three_vec_empty.bin");
+
+    // read back the file written by test_export()
+    std::vector<double> importedA;
+    std::list<int> importedB;
+    std::vector<std::string> importedC;
+    
+    mc::import_containers("three_vec.txt", { "A", "B", "C" }, importedA, importedB, importedC);
+    std::cout << "imported A = " << mc::stringify_container(importedA) << std::endl;
+    std::cout << "imported B = " << mc::stringify_container(importedB) << std::endl;
+    std::cout << "imported C = " << mc::stringify_container(importedC) << std::endl;
+    
+    // streaming in batches of four rows
+    mc::tsv_reader reader("three_vec.csv", ',');
+    std::vector<double> batchA;
+    std::vector<std::string> batchC;
+    
+    while( std::size_t rows = reader.read_batch(4, { "A", "C" }, batchA, batchC) )
+        std::cout << "batch with " << rows << " rows: " << mc::stringify_container(batchC) << std::endl;
+    
+    try { reader.read_batch(4, {}); }
+    catch(const std::runtime_error &error) { std::cout << "batch without columns: " << error.what() << std::endl; }
+#else
+    std::cout << "io is not supported (requires C++17)" << std::endl;
+#endif
+    std::cout << std::endl;
+}
+
+void test_conversion()
+{
+    std::cout << "TEST CONVERSION:" << std::endl;
+#if __cplusplus >= 201703L
+    std::cout << "convert<int>(\" +42 \") = " << mc::convert<int>(" +42 ") << std::endl;
+    std::cout << "convert<std::uint64_t>(\"18446744073709551615\") = " << mc::convert<std::uint64_t>("18446744073709551615") << std::endl;
+    std::cout << "convert<milliseconds>(\"1.5s\") = " << mc::convert<std::chrono::milliseconds>("1.5s").count() << "ms" << std::endl;
+    
+    auto checked = mc::convert_checked<double>("3.14abc");
+    std::cout << "convert_checked<double>(\"3.14abc\") fails at position " << checked.position << std::endl;
+    
+    std::vector<double> values;
+    mc::convert_many("1.5 2.5  3.5", ' ', values);
+    std::cout << "convert_many<double>(\"1.5 2.5  3.5\") = " << mc::stringify_container(values) << std::endl;
+#else
+    std::cout << "string_view conversion is not supported (requires C++17)" << std::endl;
+#endif
     std::cout << std::endl;
 }
 
@@ -69,6 +300,38 @@ void test_table()
     new_table.add_right_border();
     new_table.print();
     
+    // rows are written while they are added
+    {
+        mc::table_stream stream(std::cout, {4, 7});
+        stream.add_left_border();
+        stream("n", "n^2")(mc::horizontal_line('-'));
+        
+        for(int i=1; i<=1000; i*=10)
+            stream(i, i * i);
+    }
+    
+    // typed columns, formatted when the table is written
+    mc::column_table columns({"name", "value", "count"});
+    columns("alpha", 0.1 + 0.2, 3)("beta, \"quoted\"", 2.5, -1)("gamma", 1.0 / 0.0, 100);
+    columns["value"].precision(3).alignment(mc::align::right);
+    columns["count"].alignment(mc::align::right);
+    
+    columns.add_left_border();
+    columns.add_right_border();
+    columns.print();
+    columns.print(std::cout, mc::table_format::csv);
+    columns.print(std::cout, mc::table_format::markdown);
+    columns["value"].precision(-1);
+    columns.print(std::cout, mc::table_format::json_lines);
+    
+    // a column added after the first rows is empty until its first value, then gets default values
+    mc::column_table late({"a"});
+    late(1)(2);
+    late.add_column("b");
+    std::cout << late.to_string(mc::table_format::json_lines) << late.to_string();
+    late(3, 4.5);
+    std::cout << late.to_string(mc::table_format::csv) << "rows = " << late.rows() << ", b = " << mc::stringify_container(late["b"].numbers()) << std::endl;
+    
     std::cout << std::endl;
 }
 
@@ -87,6 +350,62 @@ void test_program_options(int argc, char ** argv)
     auto single_double = mc::option_get_value<double>("--singled", argc, argv);
     if( single_double ) std::cout << "found single double " << *single_double << std::endl;
     
+    // declared schema, argv is tokenized once
+    mc::options opts("test.out", "Test program of mcl");
+    opts.add<int>("vectori", "some integers").repeated();
+    opts.add<double>("singled,d", "a single number").default_value(1.0);
+    opts.add<std::string>("name,n", "a name").default_value("mcl").env("MCL_TEST_NAME");
+    opts.add_flag("verbose,v", "more output");
+    opts.parse(argc, argv);
+    
+    if( opts.help_requested() ) std::cout << opts.help();
+    std::cout << "options: vectori = " << mc::stringify_container(opts.get_all<int>("vectori")) << ", singled = " 
+              << opts.get<double>("singled") << ", name = " << opts.get<std::string>("name") 
+              << ", verbose = " << opts.get<bool>("verbose") << std::endl;
+    
+    // bundled short flags, --key=value and typo detection
+    std::vector<std::string> arguments = { "test.out", "-vd2.5", "--vectori=7", "file.txt", "--singel", "3" };
+    std::vector<char *> pointers;
+    for(auto &argument : arguments) pointers.push_back(&argument[0]);
+    
+    mc::options checked;
+    checked.add<double>("singled,d").required();
+    checked.add<int>("vectori").repeated();
+    checked.add_flag("verbose,v");
+    
+    try
+    {
+        checked.parse(static_cast<int>(pointers.size()), pointers.data());
+    }
+    catch(const std::runtime_error &error)
+    {
+        std::cout << "error: " << error.what() << " (parsed so far: singled = " << checked.get<double>("d") 
+                  << ", verbose = " << checked.get<bool>("verbose") << ", positional = " 
+                  << mc::stringify_container(checked.positional()) << ")" << std::endl;
+    }
+    
+    // an option is not taken as the value of the option before it, a negative number is
+    for(const auto &values : { std::vector<std::string>{ "test.out", "--singled", "--verbose" }, std::vector<std::string>{ "test.out", "-d", "-2" } })
+    {
+        std::vector<std::string> tokens = values;
+        std::vector<char *> token_pointers;
+        for(auto &token : tokens) token_pointers.push_back(&token[0]);
+        
+        mc::options missing;
+        missing.add<double>("singled,d");
+        missing.add_flag("verbose,v");
+        
+        try
+        {
+            missing.parse(static_cast<int>(token_pointers.size()), token_pointers.data());
+            std::cout << "singled = " << missing.get<double>("singled") << std::endl;
+        }
+        catch(const std::runtime_error &error)
+        {
+            std::cout << "error: " << error.what() << std::endl;
+        }
+    }
+    
     std::cout << std::endl;
 }
 
@@ -100,6 +419,240 @@ void test_time_measure()
     std::cout << std::endl;
 }
 
+void test_benchmark()
+{
+    std::cout << "TEST BENCHMARK:" << std::endl;
+#if __cplusplus >= 201703L
+    mc::benchmark bench;
+    bench.warmup(5ms).samples(10);
+    
+    bench.run("sleep 1ms", [](){ std::this_thread::sleep_for(1ms); });
+    bench.run("vector<int>(n)", { 10, 1000, 100000 }, [](std::size_t n)
+    { 
+        std::vector<int> v(n); 
+        mc::do_not_optimize(v.data()); 
+    });
+    
+    bench.to_table().print();
+    
+    // distribution of single iterations
+    bench.clear();
+    bench.record_latencies().run("vector<int>(1000)", []()
+    { 
+        std::vector<int> v(1000); 
+        mc::do_not_optimize(v.data()); 
+    });
+    bench.latency_table().print();
+    
+    // a benchmark without parameter is exported with "-" as in the tables
+    bench.export_tsv("bench_export.tsv");
+    std::ifstream exported("bench_export.tsv");
+    std::string header_line, result_line;
+    std::getline(exported, header_line);
+    std::getline(exported, result_line);
+    std::cout << "exported parameter = " << result_line.substr(result_line.find('\t') + 1, 1) << std::endl;
+    exported.close();
+    std::remove("bench_export.tsv");
+
+    // hardware counters, falls back cleanly if the kernel forbids them
+    mc::perf_counters counters;
+    std::vector<double> data(100000, 1.0);
+    
+    mc::measure_time([&](){ mc::do_not_optimize(std::accumulate(data.begin(), data.end(), 0.0)); }, 10, counters);
+    
+    if( !counters.available() ) 
+        std::cout << "performance counters not available (" << counters.error() << ")" << std::endl;
+    
+    mc::to_table(counters.read(), 10).print();
+    
+    // a sleeping thread gives up the cpu, so the context switch counter must count it
+    mc::perf_counters sleep_counters;
+    
+    {
+        mc::scoped_counters scope(sleep_counters);
+        std::this_thread::sleep_for(1ms);
+    }
+    
+    if( sleep_counters.read().has(mc::perf_event::context_switches) )
+        std::cout << "context switches while sleeping > 0: " << (sleep_counters.read()[mc::perf_event::context_switches] > 0 ? "yes" : "no") << std::endl;
+#else
+    std::cout << "benchmark is not supported (requires C++17)" << std::endl;
+#endif
+    std::cout << std::endl;
+}
+
+void test_trace()
+{
+    std::cout << "TEST TRACE:" << std::endl;
+#if __cplusplus >= 201703L
+    auto work = []()
+    {
+        MC_TRACE_SCOPE("work");
+        
+        for(int i=0; i<2; ++i)
+        {
+            MC_TRACE_SCOPE("sleep 1ms");
+            std::this_thread::sleep_for(1ms);
+        }
+    };
+    
+    std::thread thread(work);
+    work();
+    thread.join();
+    
+    mc::trace_summary_table().print();
+    mc::trace_export_chrome("trace.json");
+    std::cout << "(check file trace.json)" << std::endl;
+    
+    // flushing and clearing while another thread records (and wraps around its buffer)
+    std::atomic<bool> recording{true};
+    std::thread recorder([&](){ while( recording ) { MC_TRACE_SCOPE("tick"); } });
+    
+    std::size_t torn = 0;
+    for(int i=0; i<20; ++i)
+    {
+        for(const auto &b : mc::_trace_registry::instance().buffers())
+            for(const auto &e : b->snapshot())
+                torn += e.name == nullptr || e.end < e.begin;
+        
+        if( i % 5 == 0 ) mc::trace_clear();
+    }
+    
+    recording = false;
+    recorder.join();
+    mc::trace_clear();
+    
+    std::size_t remaining = 0;
+    for(const auto &b : mc::_trace_registry::instance().buffers()) remaining += b->snapshot().size();
+    std::cout << "torn events while recording = " << torn << ", events after clear = " << remaining << std::endl;
+#else
+    std::cout << "trace is not supported (requires C++17)" << std::endl;
+#endif
+    std::cout << std::endl;
+}
+
+void test_metrics()
+{
+    std::cout << "TEST METRICS:" << std::endl;
+#if __cplusplus >= 201703L
+    mc::metrics registry;
+    auto &items = registry.counter("items");
+    auto &queue = registry.gauge("queue length");
+    auto &latency = registry.timer("latency");
+    
+    auto work = [&]()
+    {
+        for(int i=0; i<1000; ++i)
+        {
+            auto scope = latency.time();
+            ++items;
+        }
+        queue.add(1);
+    };
+    
+    std::thread thread(work);
+    work();
+    thread.join();
+    
+    // reports every 10ms, on a terminal the table is redrawn in place
+    std::ostringstream reports;
+    {
+        mc::metrics_reporter reporter(registry, std::chrono::milliseconds(10), reports);
+        reporter.start();
+        std::this_thread::sleep_for(25ms);
+    }
+    
+    std::cout << "items = " << items.value() << ", queue length = " << queue.value() << ", latency samples = " << latency.snapshot().count() << std::endl;
+    std::cout << "reports written: " << (reports.str().find("metric") != std::string::npos ? "yes" : "no") << std::endl;
+    
+    auto snapshot = registry.snapshot();
+    mc::to_table(snapshot).print();
+    mc::export_metrics("metrics.tsv", snapshot);
+    std::cout << "(check file metrics.tsv)" << std::endl;
+#else
+    std::cout << "metrics are not supported (requires C++17)" << std::endl;
+#endif
+    std::cout << std::endl;
+}
+
+void test_parallel()
+{
+    std::cout << "TEST PARALLEL:" << std::endl;
+#if __cplusplus >= 201703L
+    mc::thread_pool pool(4);
+    
+    // tasks may wait for tasks they submitted, the waiting worker runs other tasks meanwhile
+    std::function<long(int)> fibonacci = [&](int n) -> long
+    {
+        if( n < 12 ) return n < 2 ? n : fibonacci(n - 1) + fibonacci(n - 2);
+        
+        auto first = pool.submit(fibonacci, n - 1);
+        return fibonacci(n - 2) + first.get();
+    };
+    
+    auto fib = pool.submit(fibonacci, 25);
+    auto text = pool.submit([](int a, int b){ return a * b; }, 6, 7).then([](int x){ return "answer " + std::to_string(x); });
+    auto failed = pool.submit([]() -> int { throw std::runtime_error("task failed"); }).then([](int x){ return x + 1; });
+    
+    mc::wait_all(fib, text, failed);
+    std::cout << "fibonacci(25) = " << fib.get() << ", then: " << text.get() << ", exception: ";
+    
+    try { failed.get(); }
+    catch(const std::exception &e) { std::cout << e.what() << std::endl; }
+    
+    // diamond: load, then both statistics in parallel, then the report
+    std::vector<double> data;
+    double mean = 0, deviation = 0;
+    
+    mc::task_graph graph;
+    auto load = graph.add([&]{ data = { 1, 2, 3, 4, 5, 6 }; });
+    auto average = graph.add([&]{ mean = mc::average(data); }, { load });
+    auto stddev = graph.add([&]{ deviation = mc::standard_deviation(data); }, { load });
+    graph.add([&]{ std::cout << "task graph: mean = " << mean << ", stddev = " << deviation << std::endl; }, { average, stddev });
+    graph.run_and_wait(pool);
+    
+    std::cout << "pool size = " << pool.size() << ", task graph size = " << graph.size() << std::endl;
+    
+    // mc::par algorithms run on the global pool, also from inside one of its tasks
+    std::vector<double> ones(1 << 18, 1.0);
+    auto nested = mc::thread_pool::global().submit([&]{ return mc::average(mc::par, ones); });
+    std::cout << "parallel average inside a pool task = " << nested.get() << std::endl;
+#else
+    std::cout << "parallel is not supported (requires C++17)" << std::endl;
+#endif
+    std::cout << std::endl;
+}
+
+void test_memory()
+{
+    std::cout << "TEST MEMORY:" << std::endl;
+#if __cplusplus >= 201703L
+    // the table and all its cells live in the arena and are freed at once
+    mc::arena arena;
+    {
+        mc::table t(&arena);
+        t.create()("name", "value")(mc::horizontal_line('-'))("a long cell which does not fit into a small string", 1)("pi", 3.14159);
+        t.print();
+    }
+    std::cout << "stringify in the arena: " << mc::stringify_container(std::vector<int>{ 1, 2, 3 }, &arena) 
+              << ", reserved " << arena.bytes_reserved() << " bytes" << std::endl;
+    arena.release();
+    
+    // nodes are recycled through the free lists of the pool
+    mc::pool_resource pool;
+    std::pmr::map<std::pmr::string, int> counts(&pool);
+    for( const char *word : { "apple", "pear", "apple", "plum", "apple" } )
+        counts[std::pmr::string(word, &pool)] += 1;
+    
+    std::cout << "word counts from the pool: ";
+    for( const auto &c : counts ) std::cout << c.first << " = " << c.second << " ";
+    std::cout << std::endl;
+#else
+    std::cout << "memory is not supported (requires C++17)" << std::endl;
+#endif
+    std::cout << std::endl;
+}
+
 void test_python_like()
 {
     std::cout << "TEST PYTHON LIKE:" << std::endl;
@@ -121,12 +674,72 @@ void test_python_like()
     std::cout << std::endl;
     
     
+    // sorts both vectors by the keys, the zipped range stops at the shorter vector
+    std::vector<int> keys = { 3, 1, 4, 2 };
+    std::vector<std::string> values = { "c", "a", "d", "b", "unused" };
+    auto zipped = mc::zip(keys, values);
+    std::sort(zipped.begin(), zipped.end());
+    std::cout << "sorted by key: " << mc::stringify_container(keys) << ", " << mc::stringify_container(values) << " (zipped size " << zipped.size() << ")" << std::endl;
+    std::cout << std::endl;
+    
+    
+    std::vector<double> x = { 1, 2, 3, 4 }, y = { 2, 4, 5, 9 };
+    auto blocks_of_two = mc::par;
+    blocks_of_two.threshold = 0;
+    blocks_of_two.block_size = 2;
+    
+    std::cout << "covariance of zip(x, y): " << mc::stringify_container(mc::covariance_matrix(mc::zip(x, y))[1]) 
+              << " (parallel: " << mc::stringify_container(mc::covariance_matrix(blocks_of_two(2), mc::zip(x, y))[1]) << ")" << std::endl;
+    std::cout << std::endl;
+    
+    
     std::cout << "zip_enumerate:" << std::endl;
     
     for( auto [i, str1, str2] : mc::zip_enumerate(a,b) )
         std::cout << i << ": " << str1 << ", " << str2 << std::endl;
     std::cout << std::endl;
     
+    
+    // parallel loops over random access ranges see the global index
+    std::vector<double> squares(1000), weights(1000, 0.5);
+    mc::parallel_for(mc::enumerate(squares), [](std::size_t i, double &s){ s = double(i) * i; }, 64);
+    
+    auto weighted = mc::parallel_reduce(mc::zip(squares, weights), 0.0, [](double &sum, double s, double w){ sum += s * w; }, std::plus<double>());
+    std::cout << "parallel_for: squares[999] = " << squares[999] << ", parallel_reduce: weighted sum = " << weighted << std::endl;
+    std::cout << std::endl;
+    
+    
+    // subranges of the vector, nothing is copied
+    std::vector<int> numbers = { 1, 2, 3, 4, 5, 6, 7 };
+    std::cout << "chunks(3):";
+    for( auto chunk : mc::chunks(numbers, 3) )
+        std::cout << " " << mc::stringify_container(chunk);
+    std::cout << ", stride(3): " << mc::stringify_container(mc::stride(numbers, 3)) << ", windows(3) of a list:";
+    for( auto window : mc::windows(b, 3) )
+        std::cout << " " << mc::stringify_container(window);
+    std::cout << std::endl;
+    
+    for( auto chunk : mc::chunks(numbers, 2) )
+        std::reverse(chunk.begin(), chunk.end());
+    std::cout << "pairs reversed in place: " << mc::stringify_container(numbers) << ", chunks(3).size() = " << mc::chunks(numbers, 3).size() 
+              << ", windows(8).size() = " << mc::windows(numbers, 8).size() << std::endl;
+    std::cout << std::endl;
+    
+    
+    // lazy sequences, computed from the index on access
+    static_assert(mc::linspace(0, 1, 11)[10] == 1.0 && mc::iota(0, 10, 3).size() == 4, "constexpr sequences");
+    static_assert(mc::linspace(0, 1, 1)[0] == 0.0 && mc::linspace(0, 1, 1).size() == 1, "a single value is the start, as in numpy");
+    constexpr auto table = mc::to_array<5>(mc::linspace(0.0, 2.0, 5), [](double x){ return x * x; });
+    
+    std::cout << "linspace(0, 1, 5) = " << mc::stringify_container(mc::linspace(0, 1, 5)) << ", logspace(0, 3, 4) = " << mc::stringify_container(mc::logspace(0, 3, 4))
+              << ", logspace(2, 3, 1) = " << mc::stringify_container(mc::logspace(2, 3, 1))
+              << ", constexpr table = " << mc::stringify_container(table) << std::endl;
+    
+    auto grid_sum = mc::parallel_reduce(mc::zip(mc::iota(std::uint64_t(1) << 20), mc::linspace(0, 1, std::uint64_t(1) << 20)), 0.0, 
+                                        [](double &sum, std::uint64_t i, double x){ sum += i % 2 ? x : -x; }, std::plus<double>());
+    std::cout << "alternating sum over 2^20 grid points: " << grid_sum << std::endl;
+    std::cout << std::endl;
+    
 #else
     std::cout << "python_like is not supported (requires C++17)" << std::endl;
     std::cout << std::endl;
@@ -139,9 +752,16 @@ int main(int argc, char ** argv)
     std::cout << "================" << std::endl << std::endl;
     test_mathematical();
     test_export();
+    test_io();
+    test_conversion();
     test_table();
     test_program_options(argc, argv);
     test_time_measure();
+    test_benchmark();
+    test_trace();
+    test_metrics();
+    test_parallel();
+    test_memory();
     test_python_like();
 }
 